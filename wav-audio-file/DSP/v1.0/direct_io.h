@@ -0,0 +1,491 @@
+/*
+ * Audio Delay File Generation
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+/*
+ * Page cache bypassing file reader/writer, used by main.cpp ("--direct" option).
+ * This is a header only module: the whole program is built from main.cpp alone.
+ *
+ * Files are read and written in large aligned chunks (DIRECT_IO_CHUNK_SIZE bytes) with O_DIRECT, so they don't go through the page cache at all.
+ * If the file system doesn't support O_DIRECT, regular reads/writes are used, and every chunk is dropped from the page cache
+ * right after it's done (posix_fadvise(POSIX_FADV_DONTNEED), written chunks are flushed first).
+ * Either way, a batch job doesn't evict the working set of everything else running on the machine.
+ *
+ * Double buffering: a helper thread reads the next chunk (or writes the previous one) while the caller works on the current one.
+ *
+ * Reader:
+ * direct_read_open(): opens the file for reading from pos on. The caller takes the data block_size bytes at a time, pos doesn't need to be aligned.
+ * direct_read_next(): copies the next block into p_dst, returns the number of bytes read (less than block_size only at the end of the file), or -1 on error.
+ * Like std::fstream::read(), bytes past the end of the file are left untouched in p_dst.
+ * direct_read_close(): stops the helper thread, closes the file.
+ *
+ * Writer:
+ * direct_write_open(): creates the file (overwritten if it already exists).
+ * direct_write(): appends n_bytes to the file. direct_write_at() overwrites bytes that are still in the current chunk or already written (header patching).
+ * direct_write_close(): writes what's left (the last chunk doesn't need to be aligned), closes the file. Returns false if any write failed.
+ *
+ * direct_read_is_direct()/direct_write_is_direct() tell if O_DIRECT is in use (false: page cache + fadvise).
+ */
+
+#ifndef DIRECT_IO_H
+#define DIRECT_IO_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define DIRECT_IO_ALIGN 4096UL
+#define DIRECT_IO_CHUNK_SIZE 4194304UL
+
+//Reader state. Chunk buffer n_buf holds the file data from direct_read_buf_pos[n_buf] on, direct_read_buf_size[n_buf] bytes.
+
+static int direct_read_fd = -1;
+static bool direct_read_direct = false;
+
+static unsigned char *direct_read_buffer = NULL;
+static unsigned long direct_read_block_size = 0ul;
+
+static unsigned long direct_read_buf_pos[2];
+static long direct_read_buf_size[2];
+static bool direct_read_buf_full[2];
+
+static unsigned long direct_read_file_pos = 0ul; //Next chunk read by the helper thread (aligned)
+static unsigned int direct_read_nbuf_curr = 0u; //Buffer being taken by the caller
+static unsigned long direct_read_offset = 0ul; //Caller position within it
+static bool direct_read_eof = false;
+static bool direct_read_quit = false;
+
+static std::mutex direct_read_mutex;
+static std::condition_variable direct_read_cond;
+static std::thread direct_read_thread;
+
+//Writer state. The caller fills buffer direct_write_nbuf_curr, the helper thread writes the other one.
+
+static int direct_write_fd = -1;
+static bool direct_write_direct = false;
+static bool direct_write_error = false;
+
+static unsigned char *direct_write_buffer = NULL;
+static unsigned int direct_write_nbuf_curr = 0u;
+static unsigned long direct_write_fill = 0ul; //Bytes in the current buffer
+static unsigned long direct_write_chunk_pos = 0ul; //File offset of the current buffer
+
+static bool direct_write_pending = false; //The other buffer is waiting to be written
+static unsigned long direct_write_pending_pos = 0ul;
+static bool direct_write_quit = false;
+
+static std::mutex direct_write_mutex;
+static std::condition_variable direct_write_cond;
+static std::thread direct_write_thread;
+
+void direct_read_close(void);
+bool direct_write_close(void);
+
+static long direct_pread_full(int fd, unsigned char *p_dst, unsigned long n_bytes, unsigned long pos)
+{
+	unsigned long n_done = 0ul;
+	long n_ret = 0l;
+
+	while(n_done < n_bytes)
+	{
+		n_ret = (long) pread(fd, &p_dst[n_done], n_bytes - n_done, (off_t) (pos + n_done));
+
+		if(n_ret < 0l)
+		{
+			if(errno == EINTR) continue;
+			return -1l;
+		}
+
+		if(!n_ret) break; //End of file
+
+		n_done += (unsigned long) n_ret;
+
+		//O_DIRECT: a short read that is not aligned can only be the end of the file
+		if(direct_read_direct && (n_done%DIRECT_IO_ALIGN)) break;
+	}
+
+	return (long) n_done;
+}
+
+static bool direct_pwrite_full(int fd, const unsigned char *p_src, unsigned long n_bytes, unsigned long pos)
+{
+	unsigned long n_done = 0ul;
+	long n_ret = 0l;
+
+	while(n_done < n_bytes)
+	{
+		n_ret = (long) pwrite(fd, &p_src[n_done], n_bytes - n_done, (off_t) (pos + n_done));
+
+		if(n_ret < 0l)
+		{
+			if(errno == EINTR) continue;
+			return false;
+		}
+
+		n_done += (unsigned long) n_ret;
+	}
+
+	return true;
+}
+
+static void direct_read_thread_proc(void)
+{
+	unsigned int n_buf = 0u;
+	long n_ret = 0l;
+	std::unique_lock<std::mutex> lock(direct_read_mutex);
+
+	while(true)
+	{
+		//Wait for a free buffer
+
+		direct_read_cond.wait(lock, [n_buf]{return direct_read_quit || !direct_read_buf_full[n_buf];});
+		if(direct_read_quit || direct_read_eof) break;
+
+		lock.unlock();
+
+		n_ret = direct_pread_full(direct_read_fd, &direct_read_buffer[n_buf*DIRECT_IO_CHUNK_SIZE], DIRECT_IO_CHUNK_SIZE, direct_read_file_pos);
+
+		//Page cache path: the data has been copied, the cached pages are not needed anymore
+		if(!direct_read_direct && (n_ret > 0l)) posix_fadvise(direct_read_fd, (off_t) direct_read_file_pos, (off_t) n_ret, POSIX_FADV_DONTNEED);
+
+		lock.lock();
+
+		direct_read_buf_pos[n_buf] = direct_read_file_pos;
+		direct_read_buf_size[n_buf] = n_ret;
+		direct_read_buf_full[n_buf] = true;
+
+		if(n_ret < ((long) DIRECT_IO_CHUNK_SIZE)) direct_read_eof = true; //End of file (or error)
+		direct_read_file_pos += DIRECT_IO_CHUNK_SIZE;
+
+		direct_read_cond.notify_all();
+		n_buf ^= 1u;
+	}
+
+	return;
+}
+
+bool direct_read_open(const char *file_dir, unsigned long pos, unsigned long block_size)
+{
+	direct_read_close();
+
+	direct_read_fd = open(file_dir, O_RDONLY | O_DIRECT);
+	direct_read_direct = (direct_read_fd >= 0);
+
+	if(!direct_read_direct)
+	{
+		direct_read_fd = open(file_dir, O_RDONLY);
+		if(direct_read_fd < 0) return false;
+
+		posix_fadvise(direct_read_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	direct_read_buffer = (unsigned char*) aligned_alloc(DIRECT_IO_ALIGN, 2ul*DIRECT_IO_CHUNK_SIZE);
+	if(direct_read_buffer == NULL)
+	{
+		direct_read_close();
+		return false;
+	}
+
+	//Reads start at the aligned offset below pos. The bytes before pos are skipped.
+
+	direct_read_block_size = block_size;
+	direct_read_file_pos = pos - (pos%DIRECT_IO_ALIGN);
+	direct_read_offset = pos%DIRECT_IO_ALIGN;
+	direct_read_nbuf_curr = 0u;
+
+	direct_read_buf_full[0] = false;
+	direct_read_buf_full[1] = false;
+	direct_read_eof = false;
+	direct_read_quit = false;
+
+	direct_read_thread = std::thread(direct_read_thread_proc);
+	return true;
+}
+
+long direct_read_next(void *p_dst)
+{
+	unsigned char *p_bytes = (unsigned char*) p_dst;
+	unsigned int n_buf = 0u;
+	unsigned long n_done = 0ul;
+	unsigned long n_copy = 0ul;
+	long buf_size = 0l;
+
+	if(direct_read_fd < 0) return -1l;
+
+	std::unique_lock<std::mutex> lock(direct_read_mutex);
+
+	while(n_done < direct_read_block_size)
+	{
+		n_buf = direct_read_nbuf_curr;
+
+		direct_read_cond.wait(lock, [n_buf]{return direct_read_buf_full[n_buf] || direct_read_eof;});
+		if(!direct_read_buf_full[n_buf]) break; //Nothing left
+
+		buf_size = direct_read_buf_size[n_buf];
+		if(buf_size < 0l) return -1l;
+
+		if(direct_read_offset < ((unsigned long) buf_size))
+		{
+			n_copy = ((unsigned long) buf_size) - direct_read_offset;
+			if(n_copy > (direct_read_block_size - n_done)) n_copy = direct_read_block_size - n_done;
+
+			memcpy(&p_bytes[n_done], &direct_read_buffer[n_buf*DIRECT_IO_CHUNK_SIZE + direct_read_offset], n_copy);
+
+			n_done += n_copy;
+			direct_read_offset += n_copy;
+		}
+
+		if(direct_read_offset < ((unsigned long) buf_size)) continue; //Block done, buffer is not
+
+		if(buf_size < ((long) DIRECT_IO_CHUNK_SIZE)) break; //Last chunk of the file
+
+		//Buffer done: hand it back to the helper thread
+
+		direct_read_buf_full[n_buf] = false;
+		direct_read_nbuf_curr ^= 1u;
+		direct_read_offset = 0ul;
+		direct_read_cond.notify_all();
+	}
+
+	return (long) n_done;
+}
+
+void direct_read_close(void)
+{
+	if(direct_read_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(direct_read_mutex);
+			direct_read_quit = true;
+		}
+
+		direct_read_cond.notify_all();
+		direct_read_thread.join();
+	}
+
+	if(direct_read_fd >= 0) close(direct_read_fd);
+	direct_read_fd = -1;
+
+	if(direct_read_buffer != NULL) free(direct_read_buffer);
+	direct_read_buffer = NULL;
+
+	return;
+}
+
+bool direct_read_is_direct(void)
+{
+	return direct_read_direct;
+}
+
+static void direct_write_thread_proc(void)
+{
+	unsigned int n_buf = 0u;
+	unsigned long pos = 0ul;
+	bool result = false;
+	std::unique_lock<std::mutex> lock(direct_write_mutex);
+
+	while(true)
+	{
+		direct_write_cond.wait(lock, []{return direct_write_quit || direct_write_pending;});
+		if(!direct_write_pending) break; //Quit, nothing left to write
+
+		n_buf = direct_write_nbuf_curr ^ 1u;
+		pos = direct_write_pending_pos;
+
+		lock.unlock();
+
+		result = direct_pwrite_full(direct_write_fd, &direct_write_buffer[n_buf*DIRECT_IO_CHUNK_SIZE], DIRECT_IO_CHUNK_SIZE, pos);
+
+		//Page cache path: dirty pages can't be dropped, flush them first
+
+		if(result && !direct_write_direct)
+		{
+			sync_file_range(direct_write_fd, (off64_t) pos, (off64_t) DIRECT_IO_CHUNK_SIZE, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise(direct_write_fd, (off_t) pos, (off_t) DIRECT_IO_CHUNK_SIZE, POSIX_FADV_DONTNEED);
+		}
+
+		lock.lock();
+
+		if(!result) direct_write_error = true;
+		direct_write_pending = false;
+		direct_write_cond.notify_all();
+	}
+
+	return;
+}
+
+bool direct_write_open(const char *file_dir)
+{
+	direct_write_close();
+
+	direct_write_fd = open(file_dir, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	direct_write_direct = (direct_write_fd >= 0);
+
+	if(!direct_write_direct)
+	{
+		direct_write_fd = open(file_dir, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(direct_write_fd < 0) return false;
+	}
+
+	direct_write_buffer = (unsigned char*) aligned_alloc(DIRECT_IO_ALIGN, 2ul*DIRECT_IO_CHUNK_SIZE);
+	if(direct_write_buffer == NULL)
+	{
+		direct_write_close();
+		return false;
+	}
+
+	direct_write_nbuf_curr = 0u;
+	direct_write_fill = 0ul;
+	direct_write_chunk_pos = 0ul;
+	direct_write_pending = false;
+	direct_write_quit = false;
+	direct_write_error = false;
+
+	direct_write_thread = std::thread(direct_write_thread_proc);
+	return true;
+}
+
+bool direct_write(const void *p_src, unsigned long n_bytes)
+{
+	const unsigned char *p_bytes = (const unsigned char*) p_src;
+	unsigned long n_done = 0ul;
+	unsigned long n_copy = 0ul;
+
+	if(direct_write_fd < 0) return false;
+
+	while(n_done < n_bytes)
+	{
+		n_copy = DIRECT_IO_CHUNK_SIZE - direct_write_fill;
+		if(n_copy > (n_bytes - n_done)) n_copy = n_bytes - n_done;
+
+		memcpy(&direct_write_buffer[direct_write_nbuf_curr*DIRECT_IO_CHUNK_SIZE + direct_write_fill], &p_bytes[n_done], n_copy);
+
+		n_done += n_copy;
+		direct_write_fill += n_copy;
+
+		if(direct_write_fill < DIRECT_IO_CHUNK_SIZE) break;
+
+		//Chunk is full: wait until the other buffer is written, then swap
+
+		std::unique_lock<std::mutex> lock(direct_write_mutex);
+		direct_write_cond.wait(lock, []{return !direct_write_pending;});
+
+		if(direct_write_error) return false;
+
+		direct_write_pending = true;
+		direct_write_pending_pos = direct_write_chunk_pos;
+		direct_write_nbuf_curr ^= 1u;
+		direct_write_cond.notify_all();
+
+		direct_write_fill = 0ul;
+		direct_write_chunk_pos += DIRECT_IO_CHUNK_SIZE;
+	}
+
+	return true;
+}
+
+bool direct_write_at(unsigned long pos, const void *p_src, unsigned long n_bytes)
+{
+	unsigned long offset = 0ul;
+	int flags = 0;
+
+	if(direct_write_fd < 0) return false;
+
+	//Still in the current chunk: patch the buffer
+
+	if((pos >= direct_write_chunk_pos) && ((pos + n_bytes) <= (direct_write_chunk_pos + direct_write_fill)))
+	{
+		offset = pos - direct_write_chunk_pos;
+		memcpy(&direct_write_buffer[direct_write_nbuf_curr*DIRECT_IO_CHUNK_SIZE + offset], p_src, n_bytes);
+		return true;
+	}
+
+	//Already written (or being written): wait for the helper thread, then write it without O_DIRECT (any size, any offset)
+
+	{
+		std::unique_lock<std::mutex> lock(direct_write_mutex);
+		direct_write_cond.wait(lock, []{return !direct_write_pending;});
+	}
+
+	if((pos + n_bytes) > direct_write_chunk_pos) return false; //Spans the current chunk
+
+	flags = fcntl(direct_write_fd, F_GETFL);
+	if(direct_write_direct) fcntl(direct_write_fd, F_SETFL, flags & ~O_DIRECT);
+
+	if(!direct_pwrite_full(direct_write_fd, (const unsigned char*) p_src, n_bytes, pos)) direct_write_error = true;
+
+	if(direct_write_direct) fcntl(direct_write_fd, F_SETFL, flags);
+
+	return !direct_write_error;
+}
+
+bool direct_write_close(void)
+{
+	int flags = 0;
+	bool result = false;
+
+	if(direct_write_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(direct_write_mutex);
+			direct_write_quit = true;
+		}
+
+		direct_write_cond.notify_all();
+		direct_write_thread.join();
+	}
+
+	if(direct_write_fd < 0)
+	{
+		if(direct_write_buffer != NULL) free(direct_write_buffer);
+		direct_write_buffer = NULL;
+		return false;
+	}
+
+	//Last chunk: any size. O_DIRECT needs aligned sizes, so it's turned off for this one.
+
+	if(direct_write_fill && !direct_write_error)
+	{
+		flags = fcntl(direct_write_fd, F_GETFL);
+		if(direct_write_direct) fcntl(direct_write_fd, F_SETFL, flags & ~O_DIRECT);
+
+		if(!direct_pwrite_full(direct_write_fd, &direct_write_buffer[direct_write_nbuf_curr*DIRECT_IO_CHUNK_SIZE], direct_write_fill, direct_write_chunk_pos)) direct_write_error = true;
+
+		if(!direct_write_direct && !direct_write_error)
+		{
+			fdatasync(direct_write_fd);
+			posix_fadvise(direct_write_fd, (off_t) direct_write_chunk_pos, (off_t) direct_write_fill, POSIX_FADV_DONTNEED);
+		}
+	}
+
+	result = !direct_write_error;
+
+	close(direct_write_fd);
+	direct_write_fd = -1;
+	direct_write_fill = 0ul;
+
+	if(direct_write_buffer != NULL) free(direct_write_buffer);
+	direct_write_buffer = NULL;
+
+	return result;
+}
+
+bool direct_write_is_direct(void)
+{
+	return direct_write_direct;
+}
+
+#endif //DIRECT_IO_H
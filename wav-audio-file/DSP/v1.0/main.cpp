@@ -5,18 +5,23 @@
  * Email: rafaelmsabe@gmail.com
  */
 
+#include <cstdio>
+#include <cstring>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
 
+#include "uring_read.h"
+#include "direct_io.h"
+#include "render.h"
+
 #define BYTEBUF_SIZE 2048U
 
-#define DSP_16BIT1CH 1
-#define DSP_16BIT2CH 2
-#define DSP_24BIT1CH 3
-#define DSP_24BIT2CH 4
+#define HEADER_SIZE 44U
 
 std::fstream filein;
+std::fstream fileout;
 
 char *filein_dir = NULL;
 char *fileout_dir = NULL;
@@ -28,31 +33,80 @@ unsigned int sample_rate = 0u;
 unsigned short bit_depth = 0u;
 unsigned short n_channels = 0u;
 
+unsigned int frame_size = 0u; //Bytes per frame
+unsigned long block_size = 0ul; //Bytes per chunk (render_chunk_frames frames)
+
+unsigned long filein_pos = 0ul;
+unsigned long fileout_data_size = 0ul; //Audio data written so far
+unsigned long fileout_header_size = 0ul; //Audio data size in the header
+
 int n_delay = 0;
 int n_feedback = 0;
 int feedback_pol_alt = 0;
 int cycle_div_inc_one = 0;
 
+bool use_uring = false;
+bool use_direct = false;
+bool use_stdout = false; //Output file "-": the WAV file is written to stdout
+
+unsigned int n_threads = 0u; //0: one per CPU
+
+bool fileout_error = false;
+
+double io_wait_time = 0.0;
+
+//Status messages go to stderr when the WAV file goes to stdout
+
+std::ostream *p_msg = &std::cout;
+
 bool filein_dir_check(void);
 bool filein_open(void);
+bool filein_data_open(void);
+bool fileout_create(void);
+void file_close(void);
 
 int file_get_params(void);
 bool compare_signature(const char *auth, const char *bytebuf, unsigned int offset);
 
+void header_build(char *header_info, unsigned long data_size);
+void fileout_write(const void *p_src, unsigned long n_bytes);
+bool fileout_finish(void);
+
+bool runtime_loop(void);
+long read_proc(unsigned char *p_dst);
+bool write_proc(void);
+
+double time_seconds(void);
+
 int main(int argc, char **argv)
 {
+	char header_info[HEADER_SIZE];
+	char str_buf[128];
+	double run_time = 0.0;
+
 	if(argc < 7)
 	{
 		std::cout << "Error: missing arguments\n";
 		std::cout << "This executable requires 6 arguments: ";
 		std::cout << "<input audio file directory> <output audio file directory> <delay time> <feedback loops> <feedback pol alt> <cycle div inc one>\n";
 		std::cout << "They must be in this order\nWARNING: output file will be overwritten if it already exists\n";
+		std::cout << "Output file directory \"-\" writes the output WAV file to stdout\n";
+		std::cout << "Optional arguments may follow:\n";
+		std::cout << "--uring : read the input file with io_uring (falls back to regular reads if not available)\n";
+		std::cout << "--direct : bypass the page cache, large O_DIRECT reads/writes (falls back to regular I/O with page cache drop)\n";
+		std::cout << "--threads=<n> : number of DSP threads (default: one per CPU, 1 renders on the main thread)\n";
 		return 0;
 	}
 
 	filein_dir = argv[1];
 	fileout_dir = argv[2];
 
+	if(std::string(fileout_dir) == "-")
+	{
+		use_stdout = true;
+		p_msg = &std::cerr;
+	}
+
 	try
 	{
 		n_delay = std::stoi(argv[3]);
@@ -62,89 +116,112 @@ int main(int argc, char **argv)
 	}
 	catch(...)
 	{
-		std::cout << "Error: one or more parameters have invalid values\n";
+		*p_msg << "Error: one or more parameters have invalid values\n";
 		return 0;
 	}
 
+	for(int n_arg = 7; n_arg < argc; n_arg++)
+	{
+		if(std::string(argv[n_arg]) == "--uring") use_uring = true;
+		else if(std::string(argv[n_arg]) == "--direct") use_direct = true;
+		else if(std::string(argv[n_arg]).compare(0, 10, "--threads=") == 0)
+		{
+			try
+			{
+				n_threads = (unsigned int) std::stoi(std::string(argv[n_arg]).substr(10));
+			}
+			catch(...)
+			{
+				*p_msg << "Error: invalid number of threads\n";
+				return 0;
+			}
+		}
+		else
+		{
+			*p_msg << "Error: unknown option \"" << argv[n_arg] << "\"\n";
+			return 0;
+		}
+	}
+
 	if(n_delay < 0 || n_feedback < 0 || feedback_pol_alt < 0 || cycle_div_inc_one < 0)
 	{
-		std::cout << "Error: negative values are invalid\n";
+		*p_msg << "Error: negative values are invalid\n";
 		return 0;
 	}
 
 	if(feedback_pol_alt > 1 || cycle_div_inc_one > 1)
 	{
-		std::cout << "Error: \"feedback pol alt\" and \"cycle div inc one\" may only accept two values: 1 or 0\n";
+		*p_msg << "Error: \"feedback pol alt\" and \"cycle div inc one\" may only accept two values: 1 or 0\n";
 		return 0;
 	}
 
 	if(!filein_dir_check())
 	{
-		std::cout << "Error: file format is not supported\n";
+		*p_msg << "Error: file format is not supported\n";
 		return 0;
 	}
 
 	if(!filein_open())
 	{
-		std::cout << "Error: could not open file\n";
+		*p_msg << "Error: could not open file\n";
 		return 0;
 	}
 
-	int n_ret = file_get_params();
-	if(n_ret < 0)
+	if(file_get_params() < 0)
 	{
-		std::cout << "Error: audio format is not supported\n";
+		*p_msg << "Error: audio format is not supported\n";
 		return 0;
 	}
 
-	std::string cmd = "";
+	frame_size = ((unsigned int) n_channels)*((unsigned int) bit_depth)/8u;
+	//Output has as many frames as the input data chunk
+
+	fileout_header_size = ((data_end - data_begin)/frame_size)*frame_size;
 
-	switch(n_ret)
+	if(!render_init(n_delay, n_feedback, (feedback_pol_alt == 1), (cycle_div_inc_one == 1), bit_depth, n_channels, n_threads))
 	{
-		case DSP_16BIT1CH:
-			cmd = "./dsp_16bit1ch.elf ";
-			break;
+		*p_msg << "Error: could not allocate DSP buffers\n";
+		return 0;
+	}
 
-		case DSP_16BIT2CH:
-			cmd = "./dsp_16bit2ch.elf ";
-			break;
+	block_size = render_chunk_frames*frame_size;
 
-		case DSP_24BIT1CH:
-			cmd = "./dsp_24bit1ch.elf ";
-			break;
+	if(!filein_data_open())
+	{
+		file_close();
+		render_deinit();
+		*p_msg << "Error: could not open input file\n";
+		return 0;
+	}
 
-		case DSP_24BIT2CH:
-			cmd = "./dsp_24bit2ch.elf ";
-			break;
+	if(!fileout_create())
+	{
+		file_close();
+		render_deinit();
+		*p_msg << "Error: could not create output WAV file\n";
+		return 0;
 	}
 
-	cmd += filein_dir;
-	cmd += ' ';
-	cmd += std::to_string(data_begin);
-	cmd += ' ';
-	cmd += std::to_string(data_end);
-	cmd += ' ';
-	cmd += std::to_string(n_delay);
-	cmd += ' ';
-	cmd += std::to_string(n_feedback);
-	cmd += ' ';
-	cmd += std::to_string(feedback_pol_alt);
-	cmd += ' ';
-	cmd += std::to_string(cycle_div_inc_one);
-
-	system(cmd.c_str());
-
-	cmd = "./conv.elf ";
-
-	cmd += fileout_dir;
-	cmd += ' ';
-	cmd += std::to_string(n_channels);
-	cmd += ' ';
-	cmd += std::to_string(bit_depth);
-	cmd += ' ';
-	cmd += std::to_string(sample_rate);
-
-	system(cmd.c_str());
+	if(use_direct && (!direct_read_is_direct() || (!use_stdout && !direct_write_is_direct()))) *p_msg << "Warning: O_DIRECT is not supported by the file system, using regular I/O with page cache drop\n";
+
+	header_build(header_info, fileout_header_size);
+	fileout_write(header_info, HEADER_SIZE);
+
+	*p_msg << "Running DSP...\n";
+
+	run_time = time_seconds();
+	while(runtime_loop());
+
+	if(!fileout_finish()) *p_msg << "Error: could not write output WAV file\n";
+
+	run_time = time_seconds() - run_time;
+	*p_msg << "Done\n";
+
+	snprintf(str_buf, sizeof(str_buf), "%.1f MB in %.2f s (%.1f MB/s), waiting on I/O: %.2f s\n", ((double) fileout_data_size)/1.0e6, run_time, ((double) fileout_data_size)/1.0e6/run_time, io_wait_time);
+	*p_msg << str_buf;
+
+	file_close();
+	render_deinit();
 
 	return 0;
 }
@@ -168,6 +245,53 @@ bool filein_open(void)
 	return filein.is_open();
 }
 
+bool filein_data_open(void)
+{
+	filein_pos = data_begin;
+
+	if(use_direct)
+	{
+		//Direct reads take over from io_uring
+
+		use_uring = false;
+		return direct_read_open(filein_dir, data_begin, block_size);
+	}
+
+	if(use_uring)
+	{
+		use_uring = uring_read_open(filein_dir, data_begin, block_size);
+		if(use_uring) return true;
+
+		*p_msg << "Warning: io_uring is not available, using regular reads\n";
+	}
+
+	filein.open(filein_dir, std::ios_base::in);
+	if(!filein.is_open()) return false;
+
+	filein.seekg(data_begin);
+	return true;
+}
+
+bool fileout_create(void)
+{
+	if(use_stdout) return true;
+	if(use_direct) return direct_write_open(fileout_dir);
+
+	fileout.open(fileout_dir, (std::ios_base::out | std::ios_base::trunc | std::ios_base::binary));
+	return fileout.is_open();
+}
+
+void file_close(void)
+{
+	if(filein.is_open()) filein.close();
+	uring_read_close();
+	direct_read_close();
+	direct_write_close();
+	if(fileout.is_open()) fileout.close();
+
+	return;
+}
+
 int file_get_params(void)
 {
 	char *header_info = (char*) malloc(BYTEBUF_SIZE);
@@ -255,12 +379,12 @@ int file_get_params(void)
 	filein.close();
 	free(header_info);
 
-	if((bit_depth == 16u) && (n_channels == 1u)) return DSP_16BIT1CH;
-	if((bit_depth == 16u) && (n_channels == 2u)) return DSP_16BIT2CH;
-	if((bit_depth == 24u) && (n_channels == 1u)) return DSP_24BIT1CH;
-	if((bit_depth == 24u) && (n_channels == 2u)) return DSP_24BIT2CH;
+	//Any number of channels, 16bit or 24bit
+
+	if(!n_channels) return -1;
+	if((bit_depth != 16u) && (bit_depth != 24u)) return -1;
 
-	return -1;
+	return 0;
 }
 
 bool compare_signature(const char *auth, const char *bytebuf, unsigned int offset)
@@ -273,3 +397,203 @@ bool compare_signature(const char *auth, const char *bytebuf, unsigned int offse
 	return true;
 }
 
+
+void header_build(char *header_info, unsigned long data_size)
+{
+	unsigned short *pu16 = NULL;
+	unsigned int *pu32 = NULL;
+
+	header_info[0] = 'R';
+	header_info[1] = 'I';
+	header_info[2] = 'F';
+	header_info[3] = 'F';
+
+	//Odd sized data chunks are followed by a pad byte
+
+	pu32 = (unsigned int*) &header_info[4];
+	*pu32 = 36u + ((unsigned int) (data_size + (data_size & 0x1)));
+
+	header_info[8] = 'W';
+	header_info[9] = 'A';
+	header_info[10] = 'V';
+	header_info[11] = 'E';
+
+	header_info[12] = 'f';
+	header_info[13] = 'm';
+	header_info[14] = 't';
+	header_info[15] = ' ';
+
+	pu32 = (unsigned int*) &header_info[16];
+	*pu32 = 16u;
+
+	pu16 = (unsigned short*) &header_info[20];
+	pu16[0] = 1u;
+	pu16[1] = n_channels;
+
+	pu32 = (unsigned int*) &header_info[24];
+	pu32[0] = sample_rate;
+	pu32[1] = sample_rate*frame_size;
+
+	pu16 = (unsigned short*) &header_info[32];
+	pu16[0] = frame_size;
+	pu16[1] = bit_depth;
+
+	header_info[36] = 'd';
+	header_info[37] = 'a';
+	header_info[38] = 't';
+	header_info[39] = 'a';
+
+	pu32 = (unsigned int*) &header_info[40];
+	*pu32 = (unsigned int) data_size;
+
+	return;
+}
+
+void fileout_write(const void *p_src, unsigned long n_bytes)
+{
+	if(use_stdout)
+	{
+		if(fwrite(p_src, 1, n_bytes, stdout) != n_bytes) fileout_error = true;
+	}
+	else if(use_direct)
+	{
+		if(!direct_write(p_src, n_bytes)) fileout_error = true;
+	}
+	else
+	{
+		fileout.write((const char*) p_src, n_bytes);
+		if(fileout.fail()) fileout_error = true;
+	}
+
+	return;
+}
+
+bool fileout_finish(void)
+{
+	char header_info[HEADER_SIZE];
+	char pad = 0;
+
+	if(fileout_data_size & 0x1) fileout_write(&pad, 1ul);
+
+	//Input ended early (truncated file): the header gets the actual data size. Not possible on stdout, it's already gone.
+
+	if(fileout_data_size != fileout_header_size)
+	{
+		if(use_stdout) *p_msg << "Warning: input file is truncated, output WAV header has the wrong data size\n";
+		else
+		{
+			header_build(header_info, fileout_data_size);
+
+			if(use_direct)
+			{
+				if(!direct_write_at(0ul, header_info, HEADER_SIZE)) fileout_error = true;
+			}
+			else
+			{
+				fileout.seekp(0);
+				fileout.write(header_info, HEADER_SIZE);
+				if(fileout.fail()) fileout_error = true;
+			}
+		}
+	}
+
+	if(use_stdout)
+	{
+		if(fflush(stdout)) fileout_error = true;
+	}
+	else if(use_direct)
+	{
+		if(!direct_write_close()) fileout_error = true;
+	}
+	else
+	{
+		fileout.close();
+		if(fileout.fail()) fileout_error = true;
+	}
+
+	return !fileout_error;
+}
+
+bool runtime_loop(void)
+{
+	double io_begin = 0.0;
+	long n_bytes = 0l;
+	unsigned long n_frames = 0ul;
+
+	//Every slot in use: the oldest chunk goes out first
+
+	if(render_full() && !write_proc()) return false;
+
+	io_begin = time_seconds();
+	n_bytes = read_proc(render_input_chunk());
+	io_wait_time += time_seconds() - io_begin;
+
+	if(n_bytes > 0l) n_frames = ((unsigned long) n_bytes)/frame_size;
+
+	if(!n_frames)
+	{
+		//End of data: write what's still in flight
+
+		while(write_proc());
+		return false;
+	}
+
+	render_submit(n_frames);
+	return true;
+}
+
+long read_proc(unsigned char *p_dst)
+{
+	unsigned long n_bytes = 0ul;
+	long n_read = 0l;
+
+	//Reads stop at the end of the data chunk, whatever chunks may follow it
+
+	if(filein_pos >= (data_begin + fileout_header_size)) return 0l;
+
+	n_bytes = data_begin + fileout_header_size - filein_pos;
+	if(n_bytes > block_size) n_bytes = block_size;
+
+	if(use_direct) n_read = direct_read_next(p_dst);
+	else if(use_uring) n_read = uring_read_next(p_dst);
+	else
+	{
+		filein.read((char*) p_dst, n_bytes);
+		n_read = (long) filein.gcount();
+	}
+
+	if(n_read < 0l)
+	{
+		*p_msg << "Error: could not read input file\n";
+		return -1l;
+	}
+
+	if(((unsigned long) n_read) > n_bytes) n_read = (long) n_bytes;
+
+	filein_pos += (unsigned long) n_read;
+	return n_read;
+}
+
+bool write_proc(void)
+{
+	const unsigned char *p_src = NULL;
+	unsigned long n_bytes = 0ul;
+	double io_begin = 0.0;
+
+	p_src = render_output_chunk(&n_bytes);
+	if(p_src == NULL) return false;
+
+	io_begin = time_seconds();
+	fileout_write(p_src, n_bytes);
+	io_wait_time += time_seconds() - io_begin;
+
+	fileout_data_size += n_bytes;
+	render_release();
+
+	return !fileout_error;
+}
+
+double time_seconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,610 @@
+/*
+ * Audio Delay File Generation
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+/*
+ * Delay DSP engine, used by main.cpp. Header only, like the I/O modules.
+ *
+ * Same math as the per format dsp_*.elf executables it replaces, for any number of channels:
+ * delay tap n (1 to n_feedback + 1) adds pol*sample/cycle_div (integer division, truncated) of the sample n*n_delay frames back,
+ * the taps are summed and clamped to the sample range (wet signal), and the output is (dry + wet)/2.
+ * pol is -1 on odd taps if feedback polarity alternates, else 1. cycle_div is n + 1 (cycle div inc one) or 2^n.
+ *
+ * The tap table is built once. Taps that can only give 0 (cycle_div bigger than any sample magnitude) are left out.
+ * Divisions are done with a multiply and a shift (exact for |sample| < 2^RENDER_MAGIC_BITS, Granlund & Montgomery),
+ * so the tap loop has SSSE3 and AVX2 versions (picked at runtime, like pcm24.h).
+ *
+ * Parallel rendering: an output frame only depends on the render_history_frames input frames before it (the longest tap delay).
+ * The data is split into chunks of render_chunk_frames frames. Each chunk is stored in a slot together with a halo:
+ * the render_history_frames input frames before it (zeros before the start of the data), copied from the previous slot on submit.
+ * A chunk can then be rendered on its own, on any thread, and the output is exactly the same as rendering the whole file in one go.
+ *
+ * Thread pool: every worker has its own job queue, chunks are handed out round robin. A worker whose queue is empty steals from the others.
+ * Workers and thieves both take the oldest chunk first, since the output is written in order.
+ * Slots are used as a ring: the caller reads chunks into it, and writes the rendered chunks out in the same order.
+ * With a single thread there is no pool, chunks are rendered by the caller as they're submitted.
+ *
+ * render_init(): builds the tap table, allocates the slots and starts the pool (n_threads, 0 = one per CPU).
+ * render_full(): true if every slot is in use: the oldest chunk has to be written out before the next one is read.
+ * render_input_chunk(): where the caller reads the next chunk of raw samples (up to render_chunk_frames frames).
+ * render_submit(): queues that chunk, n_frames frames of it.
+ * render_output_chunk(): waits for the oldest chunk to be rendered, returns its raw samples (NULL if there's nothing left).
+ * render_release(): the oldest chunk is written, its slot may be used again.
+ * render_deinit(): stops the pool, frees everything.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "pcm24.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RENDER_X86
+#include <immintrin.h>
+#endif
+
+#define RENDER_MAGIC_BITS 24U
+
+#define RENDER_CHUNK_FRAMES 65536UL
+#define RENDER_MAX_THREADS 256U
+
+struct _render_tap {
+	unsigned long delay_frames;
+	int pol;
+	uint32_t magic;
+	unsigned int shift;
+};
+
+struct _render_slot {
+	unsigned char *p_in; //Halo + chunk, raw samples
+	unsigned char *p_out; //Chunk, raw samples
+	unsigned long n_frames;
+	bool done;
+};
+
+struct _render_worker {
+	std::thread thread;
+	std::mutex mutex; //Guards jobs
+	std::deque<unsigned int> jobs; //Slot indices
+	int *p_buffer; //Halo + chunk, as int
+	int *p_acc;
+};
+
+typedef struct _render_tap render_tap_t;
+typedef struct _render_slot render_slot_t;
+typedef struct _render_worker render_worker_t;
+
+static render_tap_t *render_taps = NULL;
+static unsigned int render_n_taps = 0u;
+
+static unsigned long render_history_frames = 0ul;
+static unsigned long render_chunk_frames = 0ul;
+static unsigned int render_n_channels = 0u;
+static unsigned int render_sample_size = 0u; //Bytes per sample
+static unsigned int render_bit_depth = 0u;
+
+static int render_sample_max = 0;
+static int render_sample_min = 0;
+
+static render_slot_t *render_slots = NULL;
+static unsigned int render_n_slots = 0u;
+static unsigned int render_slot_next = 0u; //Next slot to be filled
+static unsigned int render_slot_oldest = 0u; //Next slot to be written
+static unsigned int render_n_pending = 0u; //Submitted, not released yet
+static unsigned long render_n_submitted = 0ul;
+
+static render_worker_t *render_workers = NULL;
+static unsigned int render_n_workers = 0u;
+static bool render_pool = false;
+
+//Pool state: guarded by render_mutex
+
+static std::mutex render_mutex;
+static std::condition_variable render_job_cond;
+static std::condition_variable render_done_cond;
+static unsigned int render_n_queued = 0u;
+static bool render_quit = false;
+
+static const pcm24_t *render_pcm24 = NULL;
+
+static void (*render_tap)(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap) = NULL;
+
+void render_deinit(void);
+
+static void render_tap_scalar(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap);
+
+#ifdef RENDER_X86
+static void render_tap_ssse3(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap);
+static void render_tap_avx2(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap);
+#endif
+
+static void render_worker_proc(unsigned int n_worker);
+
+bool render_init(int n_delay, int n_feedback, bool feedback_pol_alt, bool cycle_div_inc_one, unsigned int bit_depth, unsigned int n_channels, unsigned int n_threads)
+{
+	render_tap_t *p_tap = NULL;
+	unsigned long halo_size = 0ul;
+	unsigned long chunk_size = 0ul;
+	uint64_t cycle_div = 0u;
+	unsigned int cycle_div_log2 = 0u;
+	unsigned int n_slot = 0u;
+	unsigned int n_worker = 0u;
+	int n_cycles = 0;
+	int n_cycle = 0;
+
+	render_deinit();
+
+	if((n_delay < 0) || (n_feedback < 0) || !n_channels) return false;
+	if((bit_depth != 16u) && (bit_depth != 24u)) return false;
+
+	render_sample_max = (1 << (bit_depth - 1u)) - 1;
+	render_sample_min = -(1 << (bit_depth - 1u));
+
+	n_cycles = n_feedback + 1;
+
+	render_taps = (render_tap_t*) malloc(((size_t) n_cycles)*sizeof(render_tap_t));
+	if(render_taps == NULL) return false;
+
+	for(n_cycle = 1; n_cycle <= n_cycles; n_cycle++)
+	{
+		if(cycle_div_inc_one) cycle_div = (uint64_t) (n_cycle + 1);
+		else if(n_cycle < 63) cycle_div = ((uint64_t) 1u) << n_cycle;
+		else break;
+
+		//Tap weights only decrease from here on. |sample| <= 2^(bit_depth - 1): past that divider, every tap gives 0.
+
+		if(cycle_div > (((uint64_t) 1u) << (bit_depth - 1u))) break;
+
+		cycle_div_log2 = 0u;
+		while((((uint64_t) 1u) << cycle_div_log2) < cycle_div) cycle_div_log2++; //Rounded up
+
+		p_tap = &render_taps[render_n_taps];
+
+		p_tap->delay_frames = ((unsigned long) n_cycle)*((unsigned long) n_delay);
+		p_tap->pol = (feedback_pol_alt && (n_cycle & 0x1)) ? -1 : 1;
+		p_tap->shift = RENDER_MAGIC_BITS + cycle_div_log2;
+		p_tap->magic = (uint32_t) (((((uint64_t) 1u) << p_tap->shift)/cycle_div) + 1u); //Fits in RENDER_MAGIC_BITS + 1 bits
+
+		if(p_tap->delay_frames > render_history_frames) render_history_frames = p_tap->delay_frames;
+
+		render_n_taps++;
+	}
+
+	//Tap kernel: best level supported by this CPU (same selection as pcm24.h)
+
+	render_tap = render_tap_scalar;
+
+#ifdef RENDER_X86
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) render_tap = render_tap_avx2;
+	else if(__builtin_cpu_supports("ssse3")) render_tap = render_tap_ssse3;
+#endif
+
+	render_pcm24 = pcm24_select(PCM24_AUTO);
+
+	render_n_channels = n_channels;
+	render_bit_depth = bit_depth;
+	render_sample_size = bit_depth/8u;
+
+	//Chunks at least as long as the halo, so copying halos doesn't cost more than the chunks themselves
+
+	render_chunk_frames = RENDER_CHUNK_FRAMES;
+	if(render_chunk_frames < render_history_frames) render_chunk_frames = render_history_frames;
+
+	if(!n_threads) n_threads = std::thread::hardware_concurrency();
+	if(!n_threads) n_threads = 1u;
+	if(n_threads > RENDER_MAX_THREADS) n_threads = RENDER_MAX_THREADS;
+
+	//Twice as many chunks in flight as threads: workers keep going while the oldest chunk is being written
+
+	render_n_workers = n_threads;
+	render_n_slots = (n_threads > 1u) ? (2u*n_threads + 2u) : 2u;
+
+	halo_size = render_history_frames*n_channels*render_sample_size;
+	chunk_size = render_chunk_frames*n_channels*render_sample_size;
+
+	render_slots = (render_slot_t*) calloc(render_n_slots, sizeof(render_slot_t));
+	render_workers = new render_worker_t[render_n_workers](); //Value initialized: buffer pointers start NULL, render_deinit() may run before they are all allocated
+
+	if(render_slots == NULL)
+	{
+		render_deinit();
+		return false;
+	}
+
+	for(n_slot = 0u; n_slot < render_n_slots; n_slot++)
+	{
+		render_slots[n_slot].p_in = (unsigned char*) malloc(halo_size + chunk_size);
+		render_slots[n_slot].p_out = (unsigned char*) malloc(chunk_size);
+
+		if((render_slots[n_slot].p_in == NULL) || (render_slots[n_slot].p_out == NULL))
+		{
+			render_deinit();
+			return false;
+		}
+	}
+
+	for(n_worker = 0u; n_worker < render_n_workers; n_worker++)
+	{
+		render_workers[n_worker].p_buffer = (int*) malloc((render_history_frames + render_chunk_frames)*n_channels*sizeof(int));
+		render_workers[n_worker].p_acc = (int*) malloc(render_chunk_frames*n_channels*sizeof(int));
+
+		if((render_workers[n_worker].p_buffer == NULL) || (render_workers[n_worker].p_acc == NULL))
+		{
+			render_deinit();
+			return false;
+		}
+	}
+
+	render_quit = false;
+	render_n_queued = 0u;
+
+	if(n_threads > 1u)
+	{
+		render_pool = true;
+		for(n_worker = 0u; n_worker < render_n_workers; n_worker++) render_workers[n_worker].thread = std::thread(render_worker_proc, n_worker);
+	}
+
+	return true;
+}
+
+void render_deinit(void)
+{
+	unsigned int n_slot = 0u;
+	unsigned int n_worker = 0u;
+
+	if(render_pool)
+	{
+		{
+			std::lock_guard<std::mutex> lock(render_mutex);
+			render_quit = true;
+		}
+
+		render_job_cond.notify_all();
+
+		for(n_worker = 0u; n_worker < render_n_workers; n_worker++)
+			if(render_workers[n_worker].thread.joinable()) render_workers[n_worker].thread.join();
+
+		render_pool = false;
+	}
+
+	if(render_workers != NULL)
+	{
+		for(n_worker = 0u; n_worker < render_n_workers; n_worker++)
+		{
+			if(render_workers[n_worker].p_buffer != NULL) free(render_workers[n_worker].p_buffer);
+			if(render_workers[n_worker].p_acc != NULL) free(render_workers[n_worker].p_acc);
+		}
+
+		delete[] render_workers;
+	}
+
+	if(render_slots != NULL)
+	{
+		for(n_slot = 0u; n_slot < render_n_slots; n_slot++)
+		{
+			if(render_slots[n_slot].p_in != NULL) free(render_slots[n_slot].p_in);
+			if(render_slots[n_slot].p_out != NULL) free(render_slots[n_slot].p_out);
+		}
+
+		free(render_slots);
+	}
+
+	if(render_taps != NULL) free(render_taps);
+
+	render_taps = NULL;
+	render_slots = NULL;
+	render_workers = NULL;
+
+	render_n_taps = 0u;
+	render_history_frames = 0ul;
+	render_n_slots = 0u;
+	render_n_workers = 0u;
+	render_slot_next = 0u;
+	render_slot_oldest = 0u;
+	render_n_pending = 0u;
+	render_n_submitted = 0ul;
+
+	return;
+}
+
+//pol*sample/cycle_div, truncated toward zero: divide the magnitude, then put the sign back. Same results at every level.
+
+static void render_tap_scalar(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap)
+{
+	unsigned long n_sample = 0ul;
+	int sample = 0;
+	int sign = 0;
+	uint32_t q = 0u;
+
+	for(n_sample = 0ul; n_sample < n_samples; n_sample++)
+	{
+		sample = p_tap->pol*p_src[n_sample];
+		sign = sample >> 31;
+
+		q = (uint32_t) ((((uint64_t) ((uint32_t) ((sample ^ sign) - sign)))*((uint64_t) p_tap->magic)) >> p_tap->shift);
+
+		p_acc[n_sample] += (((int) q) ^ sign) - sign;
+	}
+
+	return;
+}
+
+#ifdef RENDER_X86
+
+//32x32 -> 64bit multiplies (pmuludq) on the even lanes, then on the odd lanes. The quotients fit in 32bit, so the halves are just ORed back together.
+
+__attribute__((target("ssse3"))) static void render_tap_ssse3(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap)
+{
+	unsigned long n_sample = 0ul;
+	unsigned long n_vec = 0ul;
+	__m128i v_pol, v_magic, v_shift, v_sample, v_abs, v_q;
+
+	v_pol = _mm_set1_epi32(p_tap->pol);
+	v_magic = _mm_set1_epi32((int) p_tap->magic);
+	v_shift = _mm_cvtsi32_si128((int) p_tap->shift);
+
+	n_vec = n_samples & ~3ul;
+
+	for(n_sample = 0ul; n_sample < n_vec; n_sample += 4ul)
+	{
+		v_sample = _mm_sign_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample]), v_pol);
+		v_abs = _mm_abs_epi32(v_sample);
+
+		v_q = _mm_or_si128(_mm_srl_epi64(_mm_mul_epu32(v_abs, v_magic), v_shift), _mm_slli_epi64(_mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(v_abs, 32), v_magic), v_shift), 32));
+
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), _mm_sign_epi32(v_q, v_sample)));
+	}
+
+	render_tap_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, p_tap);
+	return;
+}
+
+__attribute__((target("avx2"))) static void render_tap_avx2(int *p_acc, const int *p_src, unsigned long n_samples, const render_tap_t *p_tap)
+{
+	unsigned long n_sample = 0ul;
+	unsigned long n_vec = 0ul;
+	__m256i v_pol, v_magic, v_sample, v_abs, v_q;
+	__m128i v_shift;
+
+	v_pol = _mm256_set1_epi32(p_tap->pol);
+	v_magic = _mm256_set1_epi32((int) p_tap->magic);
+	v_shift = _mm_cvtsi32_si128((int) p_tap->shift);
+
+	n_vec = n_samples & ~7ul;
+
+	for(n_sample = 0ul; n_sample < n_vec; n_sample += 8ul)
+	{
+		v_sample = _mm256_sign_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]), v_pol);
+		v_abs = _mm256_abs_epi32(v_sample);
+
+		v_q = _mm256_or_si256(_mm256_srl_epi64(_mm256_mul_epu32(v_abs, v_magic), v_shift), _mm256_slli_epi64(_mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v_abs, 32), v_magic), v_shift), 32));
+
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), _mm256_sign_epi32(v_q, v_sample)));
+	}
+
+	render_tap_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, p_tap);
+	return;
+}
+
+#endif //RENDER_X86
+
+//Renders one chunk: halo + chunk raw samples in, chunk raw samples out. p_worker only provides the scratch buffers.
+
+static void render_chunk(render_worker_t *p_worker, render_slot_t *p_slot)
+{
+	const int *p_block = NULL;
+	const short *p_src16 = NULL;
+	short *p_dst16 = NULL;
+	unsigned long n_samples_in = 0ul;
+	unsigned long n_samples = 0ul;
+	unsigned long n_sample = 0ul;
+	unsigned int n_tap = 0u;
+	int wet = 0;
+
+	n_samples_in = (render_history_frames + p_slot->n_frames)*render_n_channels;
+	n_samples = p_slot->n_frames*render_n_channels;
+
+	if(render_bit_depth == 24u) render_pcm24->unpack_s24_3le(p_worker->p_buffer, p_slot->p_in, n_samples_in);
+	else
+	{
+		p_src16 = (const short*) p_slot->p_in;
+		for(n_sample = 0ul; n_sample < n_samples_in; n_sample++) p_worker->p_buffer[n_sample] = p_src16[n_sample];
+	}
+
+	p_block = &p_worker->p_buffer[render_history_frames*render_n_channels];
+
+	memset(p_worker->p_acc, 0, n_samples*sizeof(int));
+
+	for(n_tap = 0u; n_tap < render_n_taps; n_tap++)
+		render_tap(p_worker->p_acc, p_block - render_taps[n_tap].delay_frames*render_n_channels, n_samples, &render_taps[n_tap]);
+
+	for(n_sample = 0ul; n_sample < n_samples; n_sample++)
+	{
+		wet = p_worker->p_acc[n_sample];
+
+		if(wet > render_sample_max) wet = render_sample_max;
+		else if(wet < render_sample_min) wet = render_sample_min;
+
+		p_worker->p_acc[n_sample] = (p_block[n_sample] + wet)/2;
+	}
+
+	if(render_bit_depth == 24u) render_pcm24->pack_s24_3le(p_slot->p_out, p_worker->p_acc, n_samples);
+	else
+	{
+		p_dst16 = (short*) p_slot->p_out;
+		for(n_sample = 0ul; n_sample < n_samples; n_sample++) p_dst16[n_sample] = (short) p_worker->p_acc[n_sample];
+	}
+
+	return;
+}
+
+//Next job for worker n_worker: the oldest one in its own queue, else the oldest one in another worker's queue. -1 if there's none.
+
+static int render_job_take(unsigned int n_worker)
+{
+	render_worker_t *p_worker = NULL;
+	unsigned int n_victim = 0u;
+	int n_slot = -1;
+
+	for(n_victim = 0u; n_victim < render_n_workers; n_victim++)
+	{
+		p_worker = &render_workers[(n_worker + n_victim)%render_n_workers];
+
+		std::lock_guard<std::mutex> lock(p_worker->mutex);
+
+		if(!p_worker->jobs.empty())
+		{
+			n_slot = (int) p_worker->jobs.front();
+			p_worker->jobs.pop_front();
+			break;
+		}
+	}
+
+	if(n_slot >= 0)
+	{
+		std::lock_guard<std::mutex> lock(render_mutex);
+		render_n_queued--;
+	}
+
+	return n_slot;
+}
+
+static void render_worker_proc(unsigned int n_worker)
+{
+	int n_slot = 0;
+
+	while(true)
+	{
+		n_slot = render_job_take(n_worker);
+
+		if(n_slot < 0)
+		{
+			std::unique_lock<std::mutex> lock(render_mutex);
+
+			render_job_cond.wait(lock, []{return render_n_queued || render_quit;});
+			if(!render_n_queued) break; //Quit
+
+			continue;
+		}
+
+		render_chunk(&render_workers[n_worker], &render_slots[n_slot]);
+
+		{
+			std::lock_guard<std::mutex> lock(render_mutex);
+			render_slots[n_slot].done = true;
+		}
+
+		render_done_cond.notify_all();
+	}
+
+	return;
+}
+
+bool render_full(void)
+{
+	return (render_n_pending >= render_n_slots);
+}
+
+unsigned char *render_input_chunk(void)
+{
+	return &render_slots[render_slot_next].p_in[render_history_frames*render_n_channels*render_sample_size];
+}
+
+void render_submit(unsigned long n_frames)
+{
+	render_slot_t *p_slot = NULL;
+	render_slot_t *p_slot_prev = NULL;
+	render_worker_t *p_worker = NULL;
+	unsigned int n_slot = 0u;
+	unsigned long frame_size = 0ul;
+
+	n_slot = render_slot_next;
+	p_slot = &render_slots[n_slot];
+	p_slot_prev = &render_slots[(n_slot + render_n_slots - 1u)%render_n_slots];
+
+	//Halo: the last render_history_frames frames of the previous slot (halo + chunk), it's the last one submitted so it's still there
+
+	frame_size = render_n_channels*render_sample_size;
+
+	if(render_history_frames)
+	{
+		if(render_n_submitted) memcpy(p_slot->p_in, &p_slot_prev->p_in[p_slot_prev->n_frames*frame_size], render_history_frames*frame_size);
+		else memset(p_slot->p_in, 0, render_history_frames*frame_size); //Silence before the start of the data
+	}
+
+	p_slot->n_frames = n_frames;
+	p_slot->done = false;
+
+	render_slot_next = (n_slot + 1u)%render_n_slots;
+	render_n_pending++;
+
+	if(!render_pool)
+	{
+		render_chunk(&render_workers[0], p_slot);
+		p_slot->done = true;
+		render_n_submitted++;
+		return;
+	}
+
+	p_worker = &render_workers[render_n_submitted%render_n_workers];
+	render_n_submitted++;
+
+	//Counted before it's published: a worker can take the job (and decrement the count) as soon as it's in the queue
+
+	{
+		std::lock_guard<std::mutex> lock(render_mutex);
+		render_n_queued++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(p_worker->mutex);
+		p_worker->jobs.push_back(n_slot);
+	}
+
+	render_job_cond.notify_one();
+	return;
+}
+
+const unsigned char *render_output_chunk(unsigned long *p_n_bytes)
+{
+	render_slot_t *p_slot = NULL;
+
+	if(!render_n_pending) return NULL;
+
+	p_slot = &render_slots[render_slot_oldest];
+
+	if(render_pool)
+	{
+		std::unique_lock<std::mutex> lock(render_mutex);
+		render_done_cond.wait(lock, [p_slot]{return p_slot->done;});
+	}
+
+	*p_n_bytes = p_slot->n_frames*render_n_channels*render_sample_size;
+	return p_slot->p_out;
+}
+
+void render_release(void)
+{
+	if(!render_n_pending) return;
+
+	render_slot_oldest = (render_slot_oldest + 1u)%render_n_slots;
+	render_n_pending--;
+
+	return;
+}
+
+#endif //RENDER_H
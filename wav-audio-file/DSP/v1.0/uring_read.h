@@ -0,0 +1,352 @@
+/*
+ * Audio Delay File Generation
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+/*
+ * io_uring input file reader, used by main.cpp ("--uring" option).
+ * This is a header only module: the whole program is built from main.cpp alone.
+ *
+ * The input file is read in blocks of block_size bytes, one after the other, starting at pos.
+ * URING_READ_DEPTH block reads are kept in flight, so the next blocks are already being read while the current one is processed.
+ * Read buffers and the file are registered with the kernel (fixed buffers, fixed file) when possible.
+ *
+ * uring_read_open(): returns false if io_uring is not available (old kernel or disabled by the system). The caller should use regular reads then.
+ * uring_read_next(): copies the next block into p_dst, returns the number of bytes read (less than block_size only at the end of the file), or -1 on error.
+ * Like std::fstream::read(), bytes past the end of the file are left untouched in p_dst.
+ * uring_read_close(): waits for the reads still in flight, then closes the file and the ring.
+ */
+
+#ifndef URING_READ_H
+#define URING_READ_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define URING_READ_ENABLED
+#endif
+
+#define URING_READ_DEPTH 4U
+
+#ifdef URING_READ_ENABLED
+
+static int uring_fd = -1;
+static int uring_file_fd = -1;
+
+static unsigned char *uring_buffer = NULL;
+static unsigned long uring_block_size = 0ul;
+
+static unsigned long uring_submit_pos = 0ul;
+static unsigned long uring_read_pos = 0ul;
+static unsigned int uring_next_block = 0u;
+
+static long uring_results[URING_READ_DEPTH];
+static bool uring_done[URING_READ_DEPTH];
+static unsigned int uring_inflight = 0u;
+
+static bool uring_fixed_buffers = false;
+static bool uring_fixed_file = false;
+
+static void *uring_sq_ring = NULL;
+static void *uring_cq_ring = NULL;
+static struct io_uring_sqe *uring_sqes = NULL;
+
+static size_t uring_sq_ring_size = 0u;
+static size_t uring_cq_ring_size = 0u;
+static size_t uring_sqes_size = 0u;
+
+static unsigned int *uring_sq_tail = NULL;
+static unsigned int *uring_sq_array = NULL;
+static unsigned int uring_sq_mask = 0u;
+
+static unsigned int *uring_cq_head = NULL;
+static unsigned int *uring_cq_tail = NULL;
+static struct io_uring_cqe *uring_cqes = NULL;
+static unsigned int uring_cq_mask = 0u;
+
+void uring_read_close(void);
+
+static bool uring_read_submit(unsigned int n_block)
+{
+	struct io_uring_sqe *sqe = NULL;
+	unsigned int tail = 0u;
+	unsigned int index = 0u;
+	int n_ret = 0;
+
+	tail = *uring_sq_tail;
+	index = tail & uring_sq_mask;
+
+	sqe = &uring_sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	if(uring_fixed_buffers)
+	{
+		sqe->opcode = IORING_OP_READ_FIXED;
+		sqe->buf_index = (unsigned short) n_block;
+	}
+	else sqe->opcode = IORING_OP_READ;
+
+	if(uring_fixed_file)
+	{
+		sqe->fd = 0;
+		sqe->flags = IOSQE_FIXED_FILE;
+	}
+	else sqe->fd = uring_file_fd;
+
+	sqe->off = (unsigned long long) uring_submit_pos;
+	sqe->addr = (unsigned long long) (size_t) &uring_buffer[n_block*uring_block_size];
+	sqe->len = (unsigned int) uring_block_size;
+	sqe->user_data = (unsigned long long) n_block;
+
+	uring_sq_array[index] = index;
+	__atomic_store_n(uring_sq_tail, tail + 1u, __ATOMIC_RELEASE);
+
+	do n_ret = (int) syscall(__NR_io_uring_enter, uring_fd, 1u, 0u, 0u, NULL, 0u);
+	while((n_ret < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+	if(n_ret < 1) return false;
+
+	uring_done[n_block] = false;
+	uring_submit_pos += uring_block_size;
+	uring_inflight++;
+
+	return true;
+}
+
+static bool uring_read_wait(void)
+{
+	struct io_uring_cqe *cqe = NULL;
+	unsigned int head = 0u;
+	int n_ret = 0;
+
+	head = *uring_cq_head;
+
+	while(head == __atomic_load_n(uring_cq_tail, __ATOMIC_ACQUIRE))
+	{
+		n_ret = (int) syscall(__NR_io_uring_enter, uring_fd, 0u, 1u, IORING_ENTER_GETEVENTS, NULL, 0u);
+		if((n_ret < 0) && (errno != EINTR)) return false;
+	}
+
+	cqe = &uring_cqes[head & uring_cq_mask];
+
+	uring_results[cqe->user_data] = (long) cqe->res;
+	uring_done[cqe->user_data] = true;
+
+	__atomic_store_n(uring_cq_head, head + 1u, __ATOMIC_RELEASE);
+
+	uring_inflight--;
+	return true;
+}
+
+bool uring_read_open(const char *file_dir, unsigned long pos, unsigned long block_size)
+{
+	struct io_uring_params params;
+	struct iovec iovecs[URING_READ_DEPTH];
+	unsigned int n_block = 0u;
+	int n_ret = 0;
+
+	uring_read_close();
+
+	uring_file_fd = open(file_dir, O_RDONLY);
+	if(uring_file_fd < 0) return false;
+
+	uring_block_size = block_size;
+	uring_buffer = (unsigned char*) aligned_alloc(4096u, ((URING_READ_DEPTH*block_size + 4095u)/4096u)*4096u);
+	if(uring_buffer == NULL)
+	{
+		uring_read_close();
+		return false;
+	}
+
+	memset(&params, 0, sizeof(struct io_uring_params));
+
+	n_ret = (int) syscall(__NR_io_uring_setup, URING_READ_DEPTH, &params);
+	if(n_ret < 0)
+	{
+		uring_read_close();
+		return false;
+	}
+
+	uring_fd = n_ret;
+
+	uring_sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned int);
+	uring_cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+	uring_sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+
+	uring_sq_ring = mmap(NULL, uring_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQ_RING);
+	uring_cq_ring = mmap(NULL, uring_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_CQ_RING);
+	uring_sqes = (struct io_uring_sqe*) mmap(NULL, uring_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQES);
+
+	if(uring_sq_ring == MAP_FAILED) uring_sq_ring = NULL;
+	if(uring_cq_ring == MAP_FAILED) uring_cq_ring = NULL;
+	if(uring_sqes == MAP_FAILED) uring_sqes = NULL;
+
+	if((uring_sq_ring == NULL) || (uring_cq_ring == NULL) || (uring_sqes == NULL))
+	{
+		uring_read_close();
+		return false;
+	}
+
+	uring_sq_tail = (unsigned int*) (((size_t) uring_sq_ring) + params.sq_off.tail);
+	uring_sq_array = (unsigned int*) (((size_t) uring_sq_ring) + params.sq_off.array);
+	uring_sq_mask = *((unsigned int*) (((size_t) uring_sq_ring) + params.sq_off.ring_mask));
+
+	uring_cq_head = (unsigned int*) (((size_t) uring_cq_ring) + params.cq_off.head);
+	uring_cq_tail = (unsigned int*) (((size_t) uring_cq_ring) + params.cq_off.tail);
+	uring_cqes = (struct io_uring_cqe*) (((size_t) uring_cq_ring) + params.cq_off.cqes);
+	uring_cq_mask = *((unsigned int*) (((size_t) uring_cq_ring) + params.cq_off.ring_mask));
+
+	//Registering buffers and file is optional (buffer registration may be refused because of RLIMIT_MEMLOCK)
+
+	for(n_block = 0u; n_block < URING_READ_DEPTH; n_block++)
+	{
+		iovecs[n_block].iov_base = (void*) &uring_buffer[n_block*block_size];
+		iovecs[n_block].iov_len = block_size;
+	}
+
+	uring_fixed_buffers = (syscall(__NR_io_uring_register, uring_fd, IORING_REGISTER_BUFFERS, iovecs, URING_READ_DEPTH) == 0);
+	uring_fixed_file = (syscall(__NR_io_uring_register, uring_fd, IORING_REGISTER_FILES, &uring_file_fd, 1u) == 0);
+
+	uring_submit_pos = pos;
+	uring_read_pos = pos;
+	uring_next_block = 0u;
+	uring_inflight = 0u;
+
+	for(n_block = 0u; n_block < URING_READ_DEPTH; n_block++)
+	{
+		if(!uring_read_submit(n_block))
+		{
+			uring_read_close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+long uring_read_next(void *p_dst)
+{
+	unsigned int n_block = 0u;
+	long n_result = 0l;
+	long n_ret = 0l;
+
+	if(uring_fd < 0) return -1l;
+
+	n_block = uring_next_block;
+
+	//Blocks may complete in any order, they're handed over in file order
+
+	while(!uring_done[n_block]) if(!uring_read_wait()) return -1l;
+
+	n_result = uring_results[n_block];
+
+	if(n_result < 0l)
+	{
+		if((n_result != -EINTR) && (n_result != -EAGAIN)) return -1l;
+		n_result = 0l;
+	}
+
+	//Short read: end of file, or the read was cut short. pread() finds out which.
+
+	while((unsigned long) n_result < uring_block_size)
+	{
+		n_ret = (long) pread(uring_file_fd, &uring_buffer[n_block*uring_block_size + n_result], uring_block_size - n_result, (off_t) (uring_read_pos + n_result));
+
+		if(n_ret < 0l)
+		{
+			if(errno == EINTR) continue;
+			return -1l;
+		}
+
+		if(!n_ret) break;
+		n_result += n_ret;
+	}
+
+	memcpy(p_dst, &uring_buffer[n_block*uring_block_size], (size_t) n_result);
+	uring_read_pos += uring_block_size;
+
+	//Block buffer is free again: queue the read URING_READ_DEPTH blocks ahead
+
+	if(!uring_read_submit(n_block)) return -1l;
+
+	uring_next_block = (n_block + 1u)%URING_READ_DEPTH;
+	return n_result;
+}
+
+void uring_read_close(void)
+{
+	bool drained = true;
+
+	//Ring teardown is asynchronous: a read still in flight could land in the buffer after it's freed. Reap every completion first.
+
+	if((uring_fd >= 0) && (uring_cq_ring != NULL))
+	{
+		while(uring_inflight)
+		{
+			if(!uring_read_wait())
+			{
+				drained = false;
+				break;
+			}
+		}
+	}
+	else drained = !uring_inflight;
+
+	if(uring_sqes != NULL) munmap(uring_sqes, uring_sqes_size);
+	if(uring_cq_ring != NULL) munmap(uring_cq_ring, uring_cq_ring_size);
+	if(uring_sq_ring != NULL) munmap(uring_sq_ring, uring_sq_ring_size);
+
+	uring_sqes = NULL;
+	uring_cq_ring = NULL;
+	uring_sq_ring = NULL;
+
+	if(uring_fd >= 0) close(uring_fd);
+	if(uring_file_fd >= 0) close(uring_file_fd);
+
+	uring_fd = -1;
+	uring_file_fd = -1;
+
+	//If the reads could not be reaped, the buffer is leaked rather than handed back while the kernel may still write to it
+
+	if((uring_buffer != NULL) && drained) free(uring_buffer);
+	uring_buffer = NULL;
+
+	uring_fixed_buffers = false;
+	uring_fixed_file = false;
+	uring_inflight = 0u;
+
+	return;
+}
+
+#else //URING_READ_ENABLED
+
+//Built without io_uring support: regular reads are always used
+
+bool uring_read_open(const char *file_dir, unsigned long pos, unsigned long block_size)
+{
+	return false;
+}
+
+long uring_read_next(void *p_dst)
+{
+	return -1l;
+}
+
+void uring_read_close(void)
+{
+	return;
+}
+
+#endif //URING_READ_ENABLED
+
+#endif //URING_READ_H
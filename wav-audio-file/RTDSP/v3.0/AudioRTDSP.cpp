@@ -10,8 +10,17 @@
 #include "cstrdef.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 #include <poll.h>
+#include <sys/eventfd.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <math.h>
 #include <iostream>
 
 AudioRTDSP::AudioRTDSP(const audiortdsp_pb_params_t *p_pbparams)
@@ -54,6 +63,82 @@ bool AudioRTDSP::setPlaybackParameters(const audiortdsp_pb_params_t *p_pbparams)
 	this->SAMPLE_RATE = (size_t) p_pbparams->sample_rate;
 	this->N_CHANNELS = (size_t) p_pbparams->n_channels;
 
+	if(!p_pbparams->bufferout_n_segments) this->BUFFEROUT_N_SEGMENTS = this->BUFFEROUT_N_SEGMENTS_DEFAULT;
+	else if(((size_t) p_pbparams->bufferout_n_segments) < this->BUFFEROUT_N_SEGMENTS_MIN) this->BUFFEROUT_N_SEGMENTS = this->BUFFEROUT_N_SEGMENTS_MIN;
+	else if(((size_t) p_pbparams->bufferout_n_segments) > this->BUFFEROUT_N_SEGMENTS_MAX)
+	{
+		this->err_msg = "AudioRTDSP::setPlaybackParameters: Error: given p_pbparams object: bufferout_n_segments is too big.";
+		return false;
+	}
+	else this->BUFFEROUT_N_SEGMENTS = (size_t) p_pbparams->bufferout_n_segments;
+
+	this->BUFFEROUT_N_SEGMENTS_REQUESTED = (p_pbparams->bufferout_n_segments != 0u);
+
+	this->MMAP_ACCESS_REQUESTED = p_pbparams->mmap_access;
+	this->DSP_BITEXACT = p_pbparams->dsp_bitexact;
+	this->DSPKERNEL_LEVEL = p_pbparams->dsp_kernel;
+	this->DSPENGINE_MODE = p_pbparams->dsp_engine;
+	this->DITHER = p_pbparams->dither;
+
+	if(!p_pbparams->prefetch_chunk_size) this->PREFETCH_CHUNK_SIZE_BYTES = this->PREFETCH_CHUNK_SIZE_DEFAULT;
+	else if(((size_t) p_pbparams->prefetch_chunk_size) < this->PREFETCH_CHUNK_SIZE_MIN) this->PREFETCH_CHUNK_SIZE_BYTES = this->PREFETCH_CHUNK_SIZE_MIN;
+	else if(((size_t) p_pbparams->prefetch_chunk_size) > this->PREFETCH_CHUNK_SIZE_MAX)
+	{
+		this->err_msg = "AudioRTDSP::setPlaybackParameters: Error: given p_pbparams object: prefetch_chunk_size is too big.";
+		return false;
+	}
+	else this->PREFETCH_CHUNK_SIZE_BYTES = (size_t) p_pbparams->prefetch_chunk_size;
+
+	this->FILEIN_ACCESS = p_pbparams->filein_access;
+	this->FILEIN_STREAM = p_pbparams->filein_stream;
+	this->FILEIN_STREAM_FD = (this->FILEIN_STREAM) ? p_pbparams->filein_stream_fd : -1;
+	this->FILEIN_STREAM_STDIN = (this->FILEIN_STREAM && (this->FILEIN_STREAM_FD == STDIN_FILENO));
+
+	if(p_pbparams->taps_file != NULL) this->TAPS_FILE = p_pbparams->taps_file;
+	else this->TAPS_FILE = "";
+
+	return true;
+}
+
+bool AudioRTDSP::setRealTimeParameters(const audiortdsp_rt_params_t *p_rtparams)
+{
+	if(this->status > 0)
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: audio object is already initialized.";
+		return false;
+	}
+
+	if(p_rtparams == NULL)
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: given p_rtparams object is NULL.";
+		return false;
+	}
+
+	if((p_rtparams->sched_policy != SCHED_FIFO) && (p_rtparams->sched_policy != SCHED_RR))
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: given p_rtparams object: sched_policy must be SCHED_FIFO or SCHED_RR.";
+		return false;
+	}
+
+	if((p_rtparams->playthread_priority < sched_get_priority_min(p_rtparams->sched_policy)) || (p_rtparams->playthread_priority > sched_get_priority_max(p_rtparams->sched_policy)))
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: given p_rtparams object: playthread_priority is out of range.";
+		return false;
+	}
+
+	if((p_rtparams->loadthread_priority < sched_get_priority_min(p_rtparams->sched_policy)) || (p_rtparams->loadthread_priority > sched_get_priority_max(p_rtparams->sched_policy)))
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: given p_rtparams object: loadthread_priority is out of range.";
+		return false;
+	}
+
+	if((p_rtparams->playthread_cpu >= CPU_SETSIZE) || (p_rtparams->loadthread_cpu >= CPU_SETSIZE))
+	{
+		this->err_msg = "AudioRTDSP::setRealTimeParameters: Error: given p_rtparams object: CPU index is out of range.";
+		return false;
+	}
+
+	this->rt_params = *p_rtparams;
 	return true;
 }
 
@@ -63,6 +148,21 @@ bool AudioRTDSP::initialize(void)
 
 	this->status = this->STATUS_UNINITIALIZED;
 
+	/*Custom taps are read before anything is set up: a bad tap file is reported at once*/
+
+	this->fx_params.n_custom_taps = 0u;
+
+	if(!this->TAPS_FILE.empty())
+	{
+		if(!this->customtaps_load(this->TAPS_FILE.c_str()))
+		{
+			this->status = this->STATUS_ERROR_GENERIC;
+			return false;
+		}
+
+		std::cout << "Custom taps: " << std::to_string(this->fx_params.n_custom_taps) << " taps loaded from " << this->TAPS_FILE << std::endl;
+	}
+
 	if(!this->filein_open())
 	{
 		this->status = this->STATUS_ERROR_NOFILE;
@@ -70,6 +170,17 @@ bool AudioRTDSP::initialize(void)
 		return false;
 	}
 
+	if(this->FILEIN_STREAM && (this->FILEIN_ACCESS != FILEIN_ACCESS_READ))
+	{
+		std::cout << "Warning: input is a stream (no random access). Using read access.\n";
+		this->FILEIN_ACCESS = FILEIN_ACCESS_READ;
+	}
+
+	if(this->FILEIN_ACCESS == FILEIN_ACCESS_MMAP)
+	{
+		if(!this->filein_map()) std::cout << "Warning: input file could not be memory mapped. Using read access.\n";
+	}
+
 	if(!this->audio_hw_init())
 	{
 		this->filein_close();
@@ -77,6 +188,10 @@ bool AudioRTDSP::initialize(void)
 		return false;
 	}
 
+	if(this->MMAP_ACCESS_REQUESTED && !this->MMAP_ACCESS) std::cout << "Warning: audio device does not support mmap access. Using read/write access.\n";
+	if(this->MMAP_ACCESS && this->BUFFEROUT_N_SEGMENTS_REQUESTED) std::cout << "Warning: render-ahead ring size is not used with mmap access (the device buffer is the render-ahead ring).\n";
+	std::cout << "Audio device format: " << snd_pcm_format_name(this->AUDIODEV_FORMAT) << std::endl;
+
 	if(!this->buffer_alloc())
 	{
 		this->filein_close();
@@ -86,6 +201,120 @@ bool AudioRTDSP::initialize(void)
 		return false;
 	}
 
+	if(!this->segqueue_init())
+	{
+		this->filein_close();
+		this->audio_hw_deinit();
+		this->buffer_free();
+		this->status = this->STATUS_ERROR_MEMALLOC;
+		this->err_msg = "AudioRTDSP::initialize: Error: segment queue initialize failed.";
+		return false;
+	}
+
+	if(!this->taptable_alloc())
+	{
+		this->filein_close();
+		this->audio_hw_deinit();
+		this->buffer_free();
+		this->segqueue_deinit();
+		this->status = this->STATUS_ERROR_MEMALLOC;
+		this->err_msg = "AudioRTDSP::initialize: Error: memory allocate failed.";
+		return false;
+	}
+
+	if(!this->prefetch_alloc())
+	{
+		this->filein_close();
+		this->audio_hw_deinit();
+		this->buffer_free();
+		this->segqueue_deinit();
+		this->taptable_free();
+		this->status = this->STATUS_ERROR_MEMALLOC;
+		this->err_msg = "AudioRTDSP::initialize: Error: prefetch buffer allocate failed.";
+		return false;
+	}
+
+	if((this->FILEIN_ACCESS == FILEIN_ACCESS_URING) && !this->FILEIN_URING) std::cout << "Warning: io_uring is not available. Using read access.\n";
+
+	if(!this->userthread_event_init())
+	{
+		this->filein_close();
+		this->audio_hw_deinit();
+		this->buffer_free();
+		this->segqueue_deinit();
+		this->taptable_free();
+		this->prefetch_free();
+		this->status = this->STATUS_ERROR_GENERIC;
+		this->err_msg = "AudioRTDSP::initialize: Error: eventfd create failed.";
+		return false;
+	}
+
+	this->p_dspkernel = dspkernel_select(this->DSPKERNEL_LEVEL);
+	this->p_pcm24 = pcm24_select((this->DSPKERNEL_LEVEL == DSPKERNEL_SCALAR) ? PCM24_SCALAR : PCM24_AUTO);
+
+	if(this->DSP_BITEXACT) std::cout << "DSP kernel: scalar (bit-exact)\n";
+	else
+	{
+		std::cout << "DSP kernel: " << this->p_dspkernel->name << std::endl;
+		if((this->DSPKERNEL_LEVEL > DSPKERNEL_AUTO) && (this->p_dspkernel->level != this->DSPKERNEL_LEVEL)) std::cout << "Warning: requested DSP kernel is not supported by this CPU.\n";
+	}
+
+	/*FFT and recursive comb engines are optional: if they can't be set up, the direct form does the job*/
+
+	if(this->DSP_BITEXACT)
+	{
+		if(this->DSPENGINE_MODE > DSPENGINE_DIRECT) std::cout << "Warning: FFT and recursive comb engines are not available in bit-exact mode. Using direct form.\n";
+		std::cout << "DSP engine: direct\n";
+	}
+	else if(this->DSPENGINE_MODE == DSPENGINE_DIRECT) std::cout << "DSP engine: direct\n";
+	else
+	{
+		if((this->DSPENGINE_MODE == DSPENGINE_AUTO) || (this->DSPENGINE_MODE == DSPENGINE_COMB))
+		{
+			if(!this->comb_init()) std::cout << "Warning: recursive comb engine could not be set up.\n";
+		}
+
+		if((this->DSPENGINE_MODE == DSPENGINE_AUTO) || (this->DSPENGINE_MODE == DSPENGINE_FFT))
+		{
+			if(!this->fftconv_init()) std::cout << "Warning: FFT engine could not be set up.\n";
+		}
+
+		if(this->DSPENGINE_MODE == DSPENGINE_FFT) std::cout << "DSP engine: FFT";
+		else if(this->DSPENGINE_MODE == DSPENGINE_COMB) std::cout << "DSP engine: recursive comb (exponential divider), direct form otherwise";
+		else std::cout << "DSP engine: auto, direct form, FFT or recursive comb";
+
+		if(this->FFTCONV_READY) std::cout << " (FFT block size: " << std::to_string(this->fftconv.getBlockFrames()) << " frames, FFT size: " << std::to_string(this->fftconv.getFFTSize()) << ")";
+
+		std::cout << std::endl;
+	}
+
+	if(this->rt_params.enable && this->rt_params.lock_memory)
+	{
+		/*Failing to lock memory is not fatal. rt_memory_lock() reports it.*/
+
+		if(this->rt_memory_lock())
+		{
+			this->rt_memory_prefault(this->p_bufferinput, 2u*(this->BUFFERIN_SIZE_BYTES)); /*Both mirror halves*/
+			this->rt_memory_prefault(this->p_bufferoutput, this->BUFFEROUT_SIZE_BYTES);
+			if(this->p_prefetch_chunk != NULL) this->rt_memory_prefault(this->p_prefetch_chunk, this->PREFETCH_CHUNK_SIZE_BYTES + this->FILEIN_SEGMENT_SIZE_BYTES);
+			if(this->p_prefetch_uringbuf != NULL) this->rt_memory_prefault(this->p_prefetch_uringbuf, (this->PREFETCH_URING_DEPTH)*(this->PREFETCH_CHUNK_SIZE_BYTES));
+			this->rt_memory_prefault(this->p_prefetchbuffer, (this->PREFETCH_N_SEGMENTS)*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
+
+			/*DSP engine buffers (the load thread uses them at any time, whenever the engine changes)*/
+
+			this->rt_memory_prefault(this->p_taptable, this->TAPTABLE_SIZE*sizeof(audiortdsp_tap_t));
+			this->rt_memory_prefault(this->p_fbdelay, (this->FBDELAY_SIZE_FRAMES)*(this->N_CHANNELS)*sizeof(float));
+			this->rt_memory_prefault(this->p_fbdelay_prime, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+			this->rt_memory_prefault(this->p_fftconv_ir, this->BUFFERIN_SIZE_FRAMES*sizeof(double));
+			this->rt_memory_prefault(this->p_fftconv_in, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+			this->rt_memory_prefault(this->p_fftconv_out, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+			this->rt_memory_prefault(this->p_comb_state, this->BUFFERIN_SIZE_SAMPLES*sizeof(int32_t));
+			this->rt_memory_prefault(this->p_comb_prime, 2u*(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES)*sizeof(double));
+
+			this->buffer_prefault();
+		}
+	}
+
 	this->status = this->STATUS_READY;
 	return true;
 }
@@ -98,19 +327,35 @@ bool AudioRTDSP::runPlayback(void)
 		return false;
 	}
 
+	/*Playback state (including fx_params) must be set before the user thread is started*/
+
+	this->playback_init();
+
 	std::cout << "Playback started\n";
 
 	this->userthread = std::thread(&AudioRTDSP::userthread_proc, this);
 
 	this->playback_proc();
 
+	this->userthread_event_signal(); /*Wake up the user thread, playback is over*/
 	this->wait_all_threads();
 
 	std::cout << "Playback finished\n";
+	if(this->prefetch_read_error) std::cout << "Warning: input file read error. Playback stopped before the end of the audio data.\n";
+
+	this->cmdui_print_timing_stats();
+	this->cmdui_print_prefetch_stats();
 
 	this->filein_close();
 	this->audio_hw_deinit();
 	this->buffer_free();
+	this->segqueue_deinit();
+	this->taptable_free();
+	this->fftconv_deinit();
+	this->comb_deinit();
+	this->prefetch_free();
+	this->userthread_event_deinit();
+	this->rt_memory_unlock();
 
 	this->status = this->STATUS_UNINITIALIZED;
 	return true;
@@ -135,6 +380,7 @@ void AudioRTDSP::stop_all_threads(void)
 {
 	cppthread_stop(&(this->playthread));
 	cppthread_stop(&(this->userthread));
+	cppthread_stop(&(this->prefetchthread));
 	return;
 }
 
@@ -142,6 +388,16 @@ bool AudioRTDSP::filein_open(void)
 {
 	this->filein_close(); /*Clear any previous file handle*/
 
+	if(this->FILEIN_STREAM)
+	{
+		/*Already open, and read up to AUDIO_DATA_BEGIN. It can only be taken once.*/
+
+		this->h_filein = this->FILEIN_STREAM_FD;
+		this->FILEIN_STREAM_FD = -1;
+
+		return (this->h_filein >= 0);
+	}
+
 	this->h_filein = open(this->FILEIN_DIR.c_str(), O_RDONLY);
 	if(this->h_filein < 0) return false;
 
@@ -151,6 +407,8 @@ bool AudioRTDSP::filein_open(void)
 
 void AudioRTDSP::filein_close(void)
 {
+	this->filein_unmap();
+
 	if(this->h_filein < 0) return;
 
 	close(this->h_filein);
@@ -160,6 +418,84 @@ void AudioRTDSP::filein_close(void)
 	return;
 }
 
+bool AudioRTDSP::filein_map(void)
+{
+	void *p_map = NULL;
+
+	this->filein_unmap(); /*Clear any previous mapping*/
+
+	if(this->h_filein < 0) return false;
+	if(this->AUDIO_DATA_END <= this->AUDIO_DATA_BEGIN) return false;
+
+	this->FILEIN_PAGE_SIZE = (size_t) sysconf(_SC_PAGESIZE);
+	if(!this->FILEIN_PAGE_SIZE) this->FILEIN_PAGE_SIZE = 4096u;
+
+	this->FILEIN_MAP_OFFSET = this->AUDIO_DATA_BEGIN - (this->AUDIO_DATA_BEGIN%((__offset) this->FILEIN_PAGE_SIZE));
+	this->FILEIN_MAP_SIZE = (size_t) (this->AUDIO_DATA_END - this->FILEIN_MAP_OFFSET);
+
+	p_map = __MMAP(NULL, this->FILEIN_MAP_SIZE, PROT_READ, MAP_SHARED, this->h_filein, this->FILEIN_MAP_OFFSET);
+	if(p_map == MAP_FAILED)
+	{
+		this->FILEIN_MAP_SIZE = 0u;
+		return false;
+	}
+
+	madvise(p_map, this->FILEIN_MAP_SIZE, MADV_SEQUENTIAL);
+
+	this->p_filein_map = (uint8_t*) p_map;
+	this->filein_map_released = 0u;
+	this->FILEIN_MAPPED = true;
+
+	return true;
+}
+
+void AudioRTDSP::filein_unmap(void)
+{
+	if(this->p_filein_map == NULL) return;
+
+	munmap(this->p_filein_map, this->FILEIN_MAP_SIZE);
+
+	this->p_filein_map = NULL;
+	this->FILEIN_MAP_SIZE = 0u;
+	this->FILEIN_MAPPED = false;
+
+	return;
+}
+
+bool AudioRTDSP::userthread_event_init(void)
+{
+	this->userthread_event_deinit(); /*Clear any previous instances*/
+
+	this->h_userthread_event = eventfd(0u, EFD_CLOEXEC);
+	if(this->h_userthread_event < 0)
+	{
+		this->h_userthread_event = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void AudioRTDSP::userthread_event_deinit(void)
+{
+	if(this->h_userthread_event < 0) return;
+
+	close(this->h_userthread_event);
+	this->h_userthread_event = -1;
+
+	return;
+}
+
+void AudioRTDSP::userthread_event_signal(void)
+{
+	uint64_t event_value = 1u;
+
+	if(this->h_userthread_event < 0) return;
+
+	write(this->h_userthread_event, &event_value, sizeof(uint64_t));
+	return;
+}
+
 void AudioRTDSP::audio_hw_deinit(void)
 {
 	if(this->p_audiodev == NULL) return;
@@ -173,8 +509,12 @@ void AudioRTDSP::audio_hw_deinit(void)
 
 void AudioRTDSP::playback_proc(void)
 {
-	this->playback_init();
-	this->playback_loop();
+	this->prefetch_start();
+
+	if(this->MMAP_ACCESS) this->playback_loop_mmap();
+	else this->playback_loop();
+
+	this->prefetch_stop();
 
 	snd_pcm_drain(this->p_audiodev);
 	return;
@@ -182,49 +522,1793 @@ void AudioRTDSP::playback_proc(void)
 
 void AudioRTDSP::playback_init(void)
 {
+	size_t n_seg = 0u;
+
 	this->bufferout_nseg_load = 0u;
-	this->bufferout_nseg_play = 1u;
+	this->bufferout_nseg_play = 0u;
+
+	this->segqueue_load.reset();
+	this->segqueue_play.reset();
+
+	for(n_seg = 0u; n_seg < this->BUFFEROUT_N_SEGMENTS; n_seg++) this->segqueue_load.push(n_seg);
+
+	this->prefetchqueue_free.reset();
+	this->prefetchqueue_ready.reset();
+
+	for(n_seg = 0u; n_seg < this->PREFETCH_N_SEGMENTS; n_seg++) this->prefetchqueue_free.push(n_seg);
 
 	this->bufferin_nseg_curr = 0u;
 
-	this->fx_params.n_delay = 240;
-	this->fx_params.n_feedback = 20;
-	this->fx_params.feedback_altpol = true;
-	this->fx_params.cyclediv_incone = true;
+	this->fx_params.n_delay = 240;
+	this->fx_params.n_feedback = 20;
+	this->fx_params.feedback_altpol = true;
+	this->fx_params.cyclediv_incone = true;
+	this->fx_params.feedback_iir = false;
+	this->fx_params.feedback_gain = 50;
+	this->fx_params.custom_taps = !this->TAPS_FILE.empty(); /*The custom tap list itself is set by initialize()*/
+
+	this->fx_params_reset();
+	this->taptable_valid = false;
+
+	this->fftconv_active = false;
+	this->fftconv_serial = this->taptable_serial;
+	this->fftconv_history_frames = 0u;
+	this->comb_active = false;
+	this->fbdelay_active = false;
+	this->dspengine_curr.store(DSPENGINE_DIRECT, std::memory_order_relaxed);
+
+	this->stop_playback = false;
+	this->filein_pos = this->AUDIO_DATA_BEGIN;
+	this->filein_map_released = 0u;
+
+	this->playthread_timing_reset();
+	this->prefetch_stats_reset();
+
+	return;
+}
+
+void AudioRTDSP::playback_loop(void)
+{
+	/*
+	 * playthread and the load thread (main thread) are started only once.
+	 * From here on they only exchange buffer segment indexes through the segment queues.
+	 */
+
+	if(this->rt_params.enable) this->rt_thread_setup(pthread_self(), this->rt_params.loadthread_priority, this->rt_params.loadthread_cpu, "load thread");
+
+	dspkernel_denormals_off();
+	this->buffer_prerender();
+
+	this->playthread = std::thread(&AudioRTDSP::playthread_proc, this);
+
+	if(this->rt_params.enable) this->rt_thread_setup(this->playthread.native_handle(), this->rt_params.playthread_priority, this->rt_params.playthread_cpu, "play thread");
+
+	this->loadthread_proc();
+
+	cppthread_wait(&(this->playthread));
+
+	if(this->rt_params.enable) this->rt_loadthread_restore();
+
+	return;
+}
+
+void AudioRTDSP::playback_loop_mmap(void)
+{
+	/*
+	 * mmap access: a single thread (main thread) does the whole job.
+	 * The play thread priority/CPU settings are used for it, since it is the one feeding the device.
+	 */
+
+	if(this->rt_params.enable) this->rt_thread_setup(pthread_self(), this->rt_params.playthread_priority, this->rt_params.playthread_cpu, "load/play thread");
+
+	dspkernel_denormals_off();
+
+	while(!this->stop_playback)
+	{
+		this->buffer_load();
+
+		if(this->stop_playback) break;
+
+		this->bufferin_mirror_update();
+
+		if(!this->buffer_render_mmap()) break;
+
+		this->buffer_segment_update();
+	}
+
+	if(this->rt_params.enable) this->rt_loadthread_restore();
+
+	return;
+}
+
+bool AudioRTDSP::rt_memory_lock(void)
+{
+	struct rlimit memlock_limit;
+	int lock_flags = MCL_CURRENT;
+
+	if(this->rt_memory_locked) return true;
+
+	/*
+	 * MCL_FUTURE is only used when there's no memory lock limit.
+	 * Otherwise every new mapping (including new thread stacks) would count against RLIMIT_MEMLOCK and might fail.
+	 */
+
+	if(geteuid() == 0) lock_flags |= MCL_FUTURE;
+	else if(getrlimit(RLIMIT_MEMLOCK, &memlock_limit) == 0)
+		if(memlock_limit.rlim_cur == RLIM_INFINITY) lock_flags |= MCL_FUTURE;
+
+#ifdef MCL_ONFAULT
+	/*
+	 * A mapped input file must not be read in whole (and pinned) by mlockall(). Lock pages as they're faulted in instead,
+	 * the file mapping is unlocked right after. Memory is then only populated where it's touched: initialize() pre-faults
+	 * every buffer the real time threads use (rt_memory_prefault(), buffer_prefault()), FFTConvolver writes all of its arrays when it's initialized.
+	 */
+
+	if(this->FILEIN_MAPPED) lock_flags |= MCL_ONFAULT;
+#endif
+
+	/*Keep freed memory in the process, so it doesn't need to be faulted in again later*/
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if(mlockall(lock_flags) < 0)
+	{
+		std::cout << "Real time mode: memory locking failed (" << strerror(errno) << "). Memory is not locked.\n";
+		return false;
+	}
+
+	/*The prefetch thread drops file pages it's done with (MADV_DONTNEED), that doesn't work on locked pages*/
+	if(this->FILEIN_MAPPED) munlock(this->p_filein_map, this->FILEIN_MAP_SIZE);
+
+	if(lock_flags & MCL_FUTURE) std::cout << "Real time mode: memory locked (current and future allocations).\n";
+	else std::cout << "Real time mode: memory locked (current allocations only).\n";
+
+	this->rt_memory_locked = true;
+	return true;
+}
+
+void AudioRTDSP::rt_memory_unlock(void)
+{
+	if(!this->rt_memory_locked) return;
+
+	munlockall();
+
+	this->rt_memory_locked = false;
+	return;
+}
+
+void AudioRTDSP::rt_memory_prefault(void *p_mem, size_t size)
+{
+	volatile uint8_t *p_byte = NULL;
+	size_t page_size = 0u;
+	size_t n_byte = 0u;
+
+	if(p_mem == NULL) return;
+
+	page_size = (size_t) sysconf(_SC_PAGESIZE);
+	if(!page_size) page_size = 4096u;
+
+	p_byte = (volatile uint8_t*) p_mem;
+
+	/*Write the same value back, so buffer contents are kept*/
+	for(n_byte = 0u; n_byte < size; n_byte += page_size) p_byte[n_byte] = p_byte[n_byte];
+
+	return;
+}
+
+bool AudioRTDSP::rt_thread_setup(pthread_t thread, int priority, int cpu, const char *thread_name)
+{
+	struct sched_param schedparam;
+	struct rlimit rtprio_limit;
+	cpu_set_t cpu_set;
+	int n_ret = 0;
+	bool success = true;
+
+	memset(&schedparam, 0, sizeof(struct sched_param));
+
+	if(thread_name == NULL) thread_name = "audio thread";
+
+	if(pthread_equal(thread, pthread_self()))
+	{
+		pthread_getschedparam(thread, &(this->loadthread_prev_policy), &(this->loadthread_prev_schedparam));
+		pthread_getaffinity_np(thread, sizeof(cpu_set_t), &(this->loadthread_prev_cpuset));
+	}
+
+	/*SET SCHEDULING POLICY/PRIORITY*/
+
+	schedparam.sched_priority = priority;
+	n_ret = pthread_setschedparam(thread, this->rt_params.sched_policy, &schedparam);
+
+	if(n_ret == EPERM)
+	{
+		/*Unprivileged processes may still be allowed a lower priority by RLIMIT_RTPRIO*/
+
+		if(getrlimit(RLIMIT_RTPRIO, &rtprio_limit) == 0)
+		{
+			if((rtprio_limit.rlim_cur > 0) && (rtprio_limit.rlim_cur < ((rlim_t) priority)))
+			{
+				schedparam.sched_priority = (int) rtprio_limit.rlim_cur;
+				n_ret = pthread_setschedparam(thread, this->rt_params.sched_policy, &schedparam);
+			}
+		}
+	}
+
+	if(n_ret)
+	{
+		std::cout << "Real time mode: " << thread_name << ": could not set real time scheduling (" << strerror(n_ret) << "). Running with default scheduling.\n";
+		success = false;
+	}
+	else
+	{
+		std::cout << "Real time mode: " << thread_name << ": ";
+
+		if(this->rt_params.sched_policy == SCHED_RR) std::cout << "SCHED_RR";
+		else std::cout << "SCHED_FIFO";
+
+		std::cout << " priority " << std::to_string(schedparam.sched_priority);
+
+		if(schedparam.sched_priority != priority) std::cout << " (requested " << std::to_string(priority) << ", limited by RLIMIT_RTPRIO)";
+
+		std::cout << std::endl;
+	}
+
+	/*SET CPU AFFINITY*/
+
+	if(cpu < 0) return success;
+
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+
+	n_ret = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set);
+	if(n_ret)
+	{
+		std::cout << "Real time mode: " << thread_name << ": could not pin to CPU " << std::to_string(cpu) << " (" << strerror(n_ret) << ").\n";
+		return false;
+	}
+
+	std::cout << "Real time mode: " << thread_name << ": pinned to CPU " << std::to_string(cpu) << std::endl;
+	return success;
+}
+
+void AudioRTDSP::rt_loadthread_restore(void)
+{
+	pthread_setschedparam(pthread_self(), this->loadthread_prev_policy, &(this->loadthread_prev_schedparam));
+
+	if(this->rt_params.loadthread_cpu >= 0) pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &(this->loadthread_prev_cpuset));
+
+	return;
+}
+
+bool AudioRTDSP::bufferin_alloc(void)
+{
+	size_t page_size = 0u;
+	uint8_t *p_map = NULL;
+	int h_memfd = -1;
+
+	this->bufferin_free(); /*Clear any previous allocations*/
+
+	if(!this->BUFFERIN_SIZE_BYTES) return false;
+
+	page_size = (size_t) sysconf(_SC_PAGESIZE);
+	if(!page_size) page_size = 4096u;
+
+	this->BUFFERIN_MIRROR_COPY = false;
+
+	/*
+	 * Map the same memory file twice, back to back.
+	 * Mapping size must be a multiple of the page size.
+	 */
+
+	if(!(this->BUFFERIN_SIZE_BYTES%page_size)) h_memfd = memfd_create("rtdsp_bufferin", MFD_CLOEXEC);
+
+	if(h_memfd >= 0)
+	{
+		if(ftruncate(h_memfd, (off_t) this->BUFFERIN_SIZE_BYTES) == 0)
+		{
+			/*Reserve the whole address range first, then map the file over both halves*/
+
+			p_map = (uint8_t*) mmap(NULL, 2u*(this->BUFFERIN_SIZE_BYTES), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if(p_map == MAP_FAILED) p_map = NULL;
+			else if((mmap(p_map, this->BUFFERIN_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, h_memfd, 0) == MAP_FAILED)
+				|| (mmap(p_map + this->BUFFERIN_SIZE_BYTES, this->BUFFERIN_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, h_memfd, 0) == MAP_FAILED))
+			{
+				munmap(p_map, 2u*(this->BUFFERIN_SIZE_BYTES));
+				p_map = NULL;
+			}
+		}
+
+		close(h_memfd); /*The mappings keep the memory file alive*/
+	}
+
+	if(p_map != NULL)
+	{
+		this->p_bufferinput = (void*) p_map;
+		this->BUFFERIN_MIRROR_MAPPED = true;
+		return true;
+	}
+
+	/*memfd_create() or mmap() not available: plain buffer, twice the size, mirrored by bufferin_mirror_update()*/
+
+	this->p_bufferinput = calloc(2u, this->BUFFERIN_SIZE_BYTES);
+	if(this->p_bufferinput == NULL) return false;
+
+	this->BUFFERIN_MIRROR_COPY = true;
+	return true;
+}
+
+void AudioRTDSP::bufferin_free(void)
+{
+	if(this->p_bufferinput == NULL) return;
+
+	if(this->BUFFERIN_MIRROR_MAPPED) munmap(this->p_bufferinput, 2u*(this->BUFFERIN_SIZE_BYTES));
+	else free(this->p_bufferinput);
+
+	this->p_bufferinput = NULL;
+	this->BUFFERIN_MIRROR_MAPPED = false;
+	this->BUFFERIN_MIRROR_COPY = false;
+
+	return;
+}
+
+void AudioRTDSP::bufferin_mirror_update(void)
+{
+	if(!this->BUFFERIN_MIRROR_COPY) return;
+
+	memcpy((void*) (((size_t) this->pp_bufferinput_segments[this->bufferin_nseg_curr]) + this->BUFFERIN_SIZE_BYTES), this->pp_bufferinput_segments[this->bufferin_nseg_curr], this->AUDIOBUFFER_SEGMENT_SIZE_BYTES);
+	return;
+}
+
+bool AudioRTDSP::taptable_alloc(void)
+{
+	this->taptable_free(); /*Clear any previous allocations*/
+
+	this->p_taptable = (audiortdsp_tap_t*) malloc(this->TAPTABLE_SIZE*sizeof(audiortdsp_tap_t));
+	this->p_fbdelay = (float*) malloc((this->FBDELAY_SIZE_FRAMES)*(this->N_CHANNELS)*sizeof(float));
+	this->p_fbdelay_prime = (double*) malloc(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+
+	if((this->p_taptable == NULL) || (this->p_fbdelay == NULL) || (this->p_fbdelay_prime == NULL))
+	{
+		this->taptable_free();
+		return false;
+	}
+
+	memset(this->p_taptable, 0, this->TAPTABLE_SIZE*sizeof(audiortdsp_tap_t));
+	memset(this->p_fbdelay, 0, (this->FBDELAY_SIZE_FRAMES)*(this->N_CHANNELS)*sizeof(float));
+
+	this->taptable_n_taps = 0u;
+	this->taptable_valid = false;
+
+	return true;
+}
+
+void AudioRTDSP::taptable_free(void)
+{
+	if(this->p_taptable != NULL)
+	{
+		free(this->p_taptable);
+		this->p_taptable = NULL;
+	}
+
+	if(this->p_fbdelay != NULL)
+	{
+		free(this->p_fbdelay);
+		this->p_fbdelay = NULL;
+	}
+
+	if(this->p_fbdelay_prime != NULL)
+	{
+		free(this->p_fbdelay_prime);
+		this->p_fbdelay_prime = NULL;
+	}
+
+	this->taptable_n_taps = 0u;
+	this->taptable_valid = false;
+	this->fbdelay_active = false;
+
+	return;
+}
+
+void AudioRTDSP::fx_params_reset(void)
+{
+	/*Must not be called while the playback threads are running*/
+
+	this->fx_params_slots[0] = this->fx_params;
+	this->fx_params_slots[1] = this->fx_params;
+	this->fx_params_slots[2] = this->fx_params;
+
+	this->fx_params_nslot_back = 0u;
+	this->fx_params_nslot_front = 2u;
+	this->fx_params_nslot_mid.store(1u, std::memory_order_release);
+
+	return;
+}
+
+void AudioRTDSP::fx_params_publish(void)
+{
+	/*User thread only. Write the back slot, then swap it with the middle slot, flagged as new.*/
+
+	this->fx_params_slots[this->fx_params_nslot_back] = this->fx_params;
+	this->fx_params_nslot_back = this->fx_params_nslot_mid.exchange(this->fx_params_nslot_back | this->FX_PARAMS_SLOT_NEW, std::memory_order_acq_rel) & ~(this->FX_PARAMS_SLOT_NEW);
+
+	return;
+}
+
+const audiortdsp_fx_params_t *AudioRTDSP::fx_params_fetch(void)
+{
+	/*Load thread only. If there's a new snapshot in the middle slot, swap it with the front slot.*/
+
+	if(this->fx_params_nslot_mid.load(std::memory_order_relaxed) & this->FX_PARAMS_SLOT_NEW)
+		this->fx_params_nslot_front = this->fx_params_nslot_mid.exchange(this->fx_params_nslot_front, std::memory_order_acq_rel) & ~(this->FX_PARAMS_SLOT_NEW);
+
+	return &(this->fx_params_slots[this->fx_params_nslot_front]);
+}
+
+void AudioRTDSP::taptable_update(uint32_t gain_q_bits, uint32_t sample_bits)
+{
+	const audiortdsp_fx_params_t *p_fx_params = NULL;
+	size_t n_taps = 0u;
+	size_t n_tap = 0u;
+
+	p_fx_params = this->fx_params_fetch();
+
+	if(this->taptable_valid)
+	{
+		if((p_fx_params->n_delay == this->taptable_fx_params.n_delay) && (p_fx_params->n_feedback == this->taptable_fx_params.n_feedback)
+			&& (p_fx_params->feedback_altpol == this->taptable_fx_params.feedback_altpol) && (p_fx_params->cyclediv_incone == this->taptable_fx_params.cyclediv_incone)
+			&& (p_fx_params->feedback_iir == this->taptable_fx_params.feedback_iir) && (p_fx_params->feedback_gain == this->taptable_fx_params.feedback_gain)
+			&& (p_fx_params->custom_taps == this->taptable_fx_params.custom_taps))
+		{
+			if(!p_fx_params->custom_taps) return;
+
+			if((p_fx_params->n_custom_taps == this->taptable_fx_params.n_custom_taps)
+				&& !memcmp(p_fx_params->custom_tap_list, this->taptable_fx_params.custom_tap_list, (p_fx_params->n_custom_taps)*sizeof(audiortdsp_custom_tap_t)))
+				return;
+		}
+	}
+
+	if(p_fx_params->feedback_iir) n_taps = 0u; /*Feedback delay mode: no taps (dspengine_update() engages the feedback delay line)*/
+	else if(p_fx_params->custom_taps) n_taps = this->taptable_gen_custom(p_fx_params, gain_q_bits);
+	else n_taps = this->taptable_gen_preset(p_fx_params, gain_q_bits, sample_bits);
+
+	this->taptable_n_routed = 0u;
+	for(n_tap = 0u; n_tap < n_taps; n_tap++)
+	{
+		if(this->p_taptable[n_tap].src_channel >= 0) this->taptable_n_routed++;
+	}
+
+	this->taptable_n_taps = n_taps;
+	this->taptable_fx_params = *p_fx_params;
+	this->taptable_valid = true;
+	this->taptable_serial++;
+
+	return;
+}
+
+size_t AudioRTDSP::taptable_gen_preset(const audiortdsp_fx_params_t *p_fx_params, uint32_t gain_q_bits, uint32_t sample_bits)
+{
+	audiortdsp_tap_t *p_tap = NULL;
+
+	size_t n_taps = 0u;
+	uint64_t cycle_div = 0u;
+	uint32_t cycle_div_log2 = 0u;
+	uint32_t cycle_div_log2_ceil = 0u;
+	int64_t gain = 0;
+
+	int32_t n_cycles = 0;
+	int32_t n_cycle = 0;
+	int32_t pol = 0;
+
+	n_cycles = p_fx_params->n_feedback + 1;
+	if(((size_t) n_cycles) > this->TAPTABLE_SIZE) n_cycles = (int32_t) this->TAPTABLE_SIZE;
+
+	pol = 1;
+
+	for(n_cycle = 1; n_cycle <= n_cycles; n_cycle++)
+	{
+		if(p_fx_params->feedback_altpol) pol = -pol;
+
+		if(p_fx_params->cyclediv_incone)
+		{
+			cycle_div = (uint64_t) (n_cycle + 1);
+
+			cycle_div_log2 = 0u;
+			while((((uint64_t) 1u) << (cycle_div_log2 + 1u)) <= cycle_div) cycle_div_log2++;
+		}
+		else
+		{
+			if(n_cycle > 62) break;
+
+			cycle_div = (((uint64_t) 1u) << n_cycle);
+			cycle_div_log2 = (uint32_t) n_cycle;
+		}
+
+		/*
+		 * Tap weights only decrease from here on.
+		 * Once cycle_div is bigger than any sample magnitude, truncating division always gives 0: stop.
+		 */
+
+		if(cycle_div > (((uint64_t) 1u) << this->TAPTABLE_MAGIC_BITS)) break;
+
+		p_tap = &(this->p_taptable[n_taps]);
+		p_tap->n_delay = ((size_t) n_cycle)*((size_t) p_fx_params->n_delay);
+		p_tap->src_channel = -1;
+		p_tap->dst_channel = -1;
+
+		if(this->DSP_BITEXACT)
+		{
+			/*
+			 * Exact unsigned division by invariant integer (Granlund & Montgomery):
+			 * For 0 <= x < 2^N, l = ceil(log2(d)), m = floor(2^(N + l)/d) + 1: x/d == (x*m) >> (N + l)
+			 */
+
+			cycle_div_log2_ceil = cycle_div_log2;
+			if((((uint64_t) 1u) << cycle_div_log2) < cycle_div) cycle_div_log2_ceil++;
+
+			p_tap->gain = pol;
+			p_tap->shift = this->TAPTABLE_MAGIC_BITS + cycle_div_log2_ceil;
+			p_tap->magic = ((((uint64_t) 1u) << p_tap->shift)/cycle_div) + 1u;
+		}
+		else if(!p_fx_params->cyclediv_incone)
+		{
+			/*Exponential divider: cycle_div is a power of 2, a shift does the job*/
+
+			if(cycle_div_log2 >= sample_bits) break;
+
+			p_tap->gain = pol;
+			p_tap->shift = cycle_div_log2;
+			p_tap->magic = 0u;
+		}
+		else
+		{
+			gain = ((((int64_t) 1) << gain_q_bits) + ((int64_t) (cycle_div/2u)))/((int64_t) cycle_div); /*Rounded to nearest*/
+
+			if(!gain) break;
+
+			p_tap->gain = (int32_t) (pol*gain);
+			p_tap->shift = gain_q_bits;
+			p_tap->magic = 0u;
+		}
+
+		p_tap->gain_f = ((float) pol)/((float) cycle_div);
+
+		n_taps++;
+	}
+
+	return n_taps;
+}
+
+size_t AudioRTDSP::taptable_gen_custom(const audiortdsp_fx_params_t *p_fx_params, uint32_t gain_q_bits)
+{
+	const audiortdsp_custom_tap_t *p_custom_tap = NULL;
+	audiortdsp_tap_t *p_tap = NULL;
+
+	size_t n_taps = 0u;
+	uint32_t n_custom_tap = 0u;
+	uint32_t shift = 0u;
+	double gain_abs = 0.0;
+	long gain = 0;
+
+	/*The custom tap list is kept in delay time order (customtap_insert()), so the tap table is too*/
+
+	for(n_custom_tap = 0u; n_custom_tap < p_fx_params->n_custom_taps; n_custom_tap++)
+	{
+		if(n_taps >= this->TAPTABLE_SIZE) break;
+
+		p_custom_tap = &(p_fx_params->custom_tap_list[n_custom_tap]);
+
+		if((p_custom_tap->n_delay < 0) || (((size_t) p_custom_tap->n_delay) >= this->BUFFERIN_SIZE_FRAMES)) continue;
+		if((p_custom_tap->src_channel >= 0) && ((((size_t) p_custom_tap->src_channel) >= this->N_CHANNELS) || (p_custom_tap->dst_channel < 0) || (((size_t) p_custom_tap->dst_channel) >= this->N_CHANNELS))) continue;
+
+		/*Largest shift the gain fits in: keeps as many gain bits as the kernels allow (|gain| < 2^gain_q_bits)*/
+
+		gain_abs = fabs((double) p_custom_tap->gain);
+		shift = gain_q_bits;
+		while(shift && (ldexp(gain_abs, (int) shift) > ((double) ((((int64_t) 1) << gain_q_bits) - 1)))) shift--;
+
+		gain = lrint(ldexp((double) p_custom_tap->gain, (int) shift));
+		if(!gain) continue; /*Too small to make any difference*/
+
+		p_tap = &(this->p_taptable[n_taps]);
+		p_tap->n_delay = (size_t) p_custom_tap->n_delay;
+		p_tap->gain = (int32_t) gain;
+		p_tap->shift = shift;
+		p_tap->magic = 0u;
+		p_tap->gain_f = p_custom_tap->gain;
+
+		if(p_custom_tap->src_channel >= 0)
+		{
+			p_tap->src_channel = p_custom_tap->src_channel;
+			p_tap->dst_channel = p_custom_tap->dst_channel;
+		}
+		else
+		{
+			p_tap->src_channel = -1;
+			p_tap->dst_channel = -1;
+		}
+
+		n_taps++;
+	}
+
+	return n_taps;
+}
+
+const char *AudioRTDSP::customtap_parse(const char *text, audiortdsp_custom_tap_t *p_tap)
+{
+	const char *p_text = NULL;
+	char *p_end = NULL;
+
+	long n_delay = 0;
+	float gain = 0.0f;
+	long src_channel = 0;
+	long dst_channel = 0;
+
+	if((text == NULL) || (p_tap == NULL)) return "no tap given";
+
+	/*Numbers are separated by spaces and/or one comma*/
+
+	n_delay = strtol(text, &p_end, 10);
+	if(p_end == text) return "delay time expected";
+
+	p_text = p_end;
+	while(isspace(*p_text)) p_text++;
+	if(*p_text == ',') p_text++;
+
+	gain = strtof(p_text, &p_end);
+	if(p_end == p_text) return "gain expected";
+
+	p_text = p_end;
+	while(isspace(*p_text)) p_text++;
+	if(*p_text == ',') p_text++;
+	while(isspace(*p_text)) p_text++;
+
+	if(*p_text == '\0')
+	{
+		src_channel = 0;
+		dst_channel = 0;
+	}
+	else
+	{
+		src_channel = strtol(p_text, &p_end, 10);
+		if(p_end == p_text) return "source channel expected";
+
+		p_text = p_end;
+		while(isspace(*p_text)) p_text++;
+		if(*p_text == ',') p_text++;
+
+		dst_channel = strtol(p_text, &p_end, 10);
+		if(p_end == p_text) return "destination channel expected";
+
+		p_text = p_end;
+		while(isspace(*p_text)) p_text++;
+		if(*p_text != '\0') return "too many values";
+
+		if((src_channel < 1) || (((size_t) src_channel) > this->N_CHANNELS) || (dst_channel < 1) || (((size_t) dst_channel) > this->N_CHANNELS)) return "channel out of range";
+	}
+
+	if((n_delay < 0) || (((size_t) n_delay) >= this->BUFFERIN_SIZE_FRAMES)) return "delay time out of range";
+	if(!(fabsf(gain) <= 1.0f)) return "gain out of range (-1 to 1)";
+
+	p_tap->n_delay = (int32_t) n_delay;
+	p_tap->gain = gain;
+	p_tap->src_channel = (int16_t) (src_channel - 1);
+	p_tap->dst_channel = (int16_t) (dst_channel - 1);
+
+	return NULL;
+}
+
+bool AudioRTDSP::customtap_insert(const audiortdsp_custom_tap_t *p_tap)
+{
+	uint32_t n_tap = 0u;
+
+	if(p_tap == NULL) return false;
+	if(this->fx_params.n_custom_taps >= AUDIORTDSP_CUSTOMTAPS_MAX) return false;
+
+	/*Insertion sort step: taps with the same delay time stay in the order they were given*/
+
+	n_tap = this->fx_params.n_custom_taps;
+
+	while(n_tap && (this->fx_params.custom_tap_list[n_tap - 1u].n_delay > p_tap->n_delay))
+	{
+		this->fx_params.custom_tap_list[n_tap] = this->fx_params.custom_tap_list[n_tap - 1u];
+		n_tap--;
+	}
+
+	this->fx_params.custom_tap_list[n_tap] = *p_tap;
+	this->fx_params.n_custom_taps++;
+
+	return true;
+}
+
+bool AudioRTDSP::customtaps_load(const char *file_dir)
+{
+	FILE *p_file = NULL;
+	char *p_comment = NULL;
+	const char *p_text = NULL;
+	const char *parse_error = NULL;
+	char line[256];
+	size_t line_length = 0u;
+	size_t n_line = 0u;
+	audiortdsp_custom_tap_t custom_tap;
+
+	if(file_dir == NULL) return false;
+
+	this->fx_params.n_custom_taps = 0u;
+
+	p_file = fopen(file_dir, "r");
+	if(p_file == NULL)
+	{
+		this->err_msg = "AudioRTDSP::customtaps_load: Error: could not open tap file.";
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), p_file) != NULL)
+	{
+		n_line++;
+
+		line_length = strlen(line);
+		if(line_length && (line[line_length - 1u] == '\n')) line[--line_length] = '\0';
+		else if(!feof(p_file))
+		{
+			fclose(p_file);
+			this->err_msg = "AudioRTDSP::customtaps_load: Error: tap file line " + std::to_string(n_line) + ": line is too long.";
+			return false;
+		}
+
+		p_comment = strchr(line, '#');
+		if(p_comment != NULL) *p_comment = '\0';
+
+		p_text = line;
+		while(isspace(*p_text)) p_text++;
+		if(*p_text == '\0') continue;
+
+		parse_error = this->customtap_parse(p_text, &custom_tap);
+
+		if(parse_error != NULL)
+		{
+			fclose(p_file);
+			this->err_msg = "AudioRTDSP::customtaps_load: Error: tap file line " + std::to_string(n_line) + ": " + parse_error + ".";
+			return false;
+		}
+
+		if(!this->customtap_insert(&custom_tap))
+		{
+			fclose(p_file);
+			this->err_msg = "AudioRTDSP::customtaps_load: Error: tap file has too many taps (max " + std::to_string(AUDIORTDSP_CUSTOMTAPS_MAX) + ").";
+			return false;
+		}
+	}
+
+	fclose(p_file);
+	return true;
+}
+
+void AudioRTDSP::customtaps_preset(void)
+{
+	audiortdsp_custom_tap_t custom_tap;
+
+	int32_t n_cycles = 0;
+	int32_t n_cycle = 0;
+	float pol = 1.0f;
+	float cycle_div = 1.0f;
+
+	/*Same taps as taptable_gen_preset(), with float gains. Taps past the custom tap list capacity are dropped.*/
+
+	this->fx_params.n_custom_taps = 0u;
+
+	n_cycles = this->fx_params.n_feedback + 1;
+
+	for(n_cycle = 1; n_cycle <= n_cycles; n_cycle++)
+	{
+		if(this->fx_params.feedback_altpol) pol = -pol;
+
+		if(this->fx_params.cyclediv_incone) cycle_div = (float) (n_cycle + 1);
+		else cycle_div *= 2.0f;
+
+		if(cycle_div > ((float) (1u << this->TAPTABLE_MAGIC_BITS))) break;
+		if(((size_t) n_cycle)*((size_t) this->fx_params.n_delay) >= this->BUFFERIN_SIZE_FRAMES) break;
+
+		if(this->fx_params.n_custom_taps >= AUDIORTDSP_CUSTOMTAPS_MAX)
+		{
+			std::cout << "Warning: custom tap list is full. Only the first " << std::to_string(AUDIORTDSP_CUSTOMTAPS_MAX) << " taps were copied.\n";
+			break;
+		}
+
+		custom_tap.n_delay = n_cycle*(this->fx_params.n_delay);
+		custom_tap.gain = pol/cycle_div;
+		custom_tap.src_channel = -1;
+		custom_tap.dst_channel = -1;
+
+		this->customtap_insert(&custom_tap);
+	}
+
+	return;
+}
+
+bool AudioRTDSP::fftconv_init(void)
+{
+	this->fftconv_deinit(); /*Clear any previous allocations*/
+
+	/*Block size is the period size: the FFT engine adds no latency. Impulse responses up to the input buffer size.*/
+
+	if(!this->fftconv.initialize(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES, this->N_CHANNELS, this->BUFFERIN_SIZE_FRAMES)) return false;
+
+	this->p_fftconv_ir = (double*) malloc(this->BUFFERIN_SIZE_FRAMES*sizeof(double));
+	this->p_fftconv_in = (double*) malloc(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+	this->p_fftconv_out = (double*) malloc(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+
+	if((this->p_fftconv_ir == NULL) || (this->p_fftconv_in == NULL) || (this->p_fftconv_out == NULL))
+	{
+		this->fftconv_deinit();
+		return false;
+	}
+
+	this->FFTCONV_READY = true;
+	return true;
+}
+
+void AudioRTDSP::fftconv_deinit(void)
+{
+	this->fftconv.deinitialize();
+
+	if(this->p_fftconv_ir != NULL)
+	{
+		free(this->p_fftconv_ir);
+		this->p_fftconv_ir = NULL;
+	}
+
+	if(this->p_fftconv_in != NULL)
+	{
+		free(this->p_fftconv_in);
+		this->p_fftconv_in = NULL;
+	}
+
+	if(this->p_fftconv_out != NULL)
+	{
+		free(this->p_fftconv_out);
+		this->p_fftconv_out = NULL;
+	}
+
+	this->FFTCONV_READY = false;
+	this->fftconv_active = false;
+
+	return;
+}
+
+bool AudioRTDSP::comb_init(void)
+{
+	this->comb_deinit(); /*Clear any previous allocations*/
+
+	this->p_comb_state = malloc(this->BUFFERIN_SIZE_SAMPLES*sizeof(int32_t)); /*sizeof(int32_t) == sizeof(float)*/
+	this->p_comb_prime = (double*) malloc(2u*(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES)*sizeof(double));
+
+	if((this->p_comb_state == NULL) || (this->p_comb_prime == NULL))
+	{
+		this->comb_deinit();
+		return false;
+	}
+
+	memset(this->p_comb_state, 0, this->BUFFERIN_SIZE_SAMPLES*sizeof(int32_t));
+
+	this->COMB_READY = true;
+	return true;
+}
+
+void AudioRTDSP::comb_deinit(void)
+{
+	if(this->p_comb_state != NULL)
+	{
+		free(this->p_comb_state);
+		this->p_comb_state = NULL;
+	}
+
+	if(this->p_comb_prime != NULL)
+	{
+		free(this->p_comb_prime);
+		this->p_comb_prime = NULL;
+	}
+
+	this->COMB_READY = false;
+	this->comb_active = false;
+
+	return;
+}
+
+void AudioRTDSP::dspengine_update(bool float_gains, uint32_t comb_frac_bits)
+{
+	const audiortdsp_tap_t *p_tap = NULL;
+	uint8_t *p_currin_mirror = NULL;
+
+	size_t n_tap = 0u;
+	size_t n_part = 0u;
+	size_t n_part_prev = 0u;
+	size_t n_partitions = 0u;
+	size_t ir_frames = 0u;
+	size_t n_blocks = 0u;
+	size_t n_block = 0u;
+	size_t sample_size = 0u;
+	bool use_fft = false;
+
+	if(this->fftconv_serial == this->taptable_serial) return;
+
+	this->fftconv_serial = this->taptable_serial;
+
+	/*
+	 * Feedback delay mode. The ring is kept if it already holds this delay time (feedback gain or polarity change only),
+	 * the echoes in flight just carry on with the new gain.
+	 */
+
+	if(this->taptable_fx_params.feedback_iir)
+	{
+		this->comb_active = false;
+		this->fftconv_active = false;
+
+		this->fbdelay_gain = ((float) this->taptable_fx_params.feedback_gain)/100.0f;
+		if(this->taptable_fx_params.feedback_altpol) this->fbdelay_gain = -(this->fbdelay_gain);
+
+		if(!this->fbdelay_active || (this->fbdelay_delay != ((size_t) this->taptable_fx_params.n_delay)))
+		{
+			this->fbdelay_delay = (size_t) this->taptable_fx_params.n_delay;
+			if(this->fbdelay_delay) this->fbdelay_prime();
+		}
+
+		this->fbdelay_active = (this->fbdelay_delay > 0u); /*Zero delay: nothing to feed back*/
+		this->dspengine_curr.store(DSPENGINE_FEEDBACK, std::memory_order_relaxed);
+		return;
+	}
+
+	this->fbdelay_active = false;
+
+	/*
+	 * Exponential divider mode (preset taps): taps k = 1...K at k*n_delay, gains (pol/2)^k. The recursive comb is the cheapest engine, if the input buffer
+	 * holds x[n - (K + 1)*n_delay]. In the fast mode, tap k has gain pol^k and shift k (gain_f = pol^k/2^k).
+	 */
+
+	this->comb_active = false;
+
+	if(this->COMB_READY && this->taptable_n_taps && !this->taptable_fx_params.custom_taps && !this->taptable_fx_params.cyclediv_incone && (this->DSPENGINE_MODE != DSPENGINE_FFT))
+	{
+		this->comb_delay = this->p_taptable[0].n_delay;
+		this->comb_delay_old = (this->taptable_n_taps + 1u)*(this->comb_delay);
+
+		if(this->comb_delay && (this->comb_delay_old <= (this->BUFFERIN_SIZE_FRAMES - this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES)))
+		{
+			this->comb_pol = this->p_taptable[0].gain;
+			this->comb_pol_old = (this->p_taptable[this->taptable_n_taps - 1u].gain)*(this->comb_pol);
+			this->comb_shift_old = (uint32_t) (this->taptable_n_taps + 1u);
+			this->comb_gain = this->p_taptable[0].gain_f;
+			this->comb_gain_old = (this->p_taptable[this->taptable_n_taps - 1u].gain_f)*(this->comb_gain);
+
+			this->comb_prime(float_gains, comb_frac_bits);
+
+			this->comb_active = true;
+			this->fftconv_active = false;
+			this->dspengine_curr.store(DSPENGINE_COMB, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	/*The impulse response is the same for every channel: routed taps need the direct form*/
+
+	if(this->FFTCONV_READY && this->taptable_n_taps && !this->taptable_n_routed)
+	{
+		if(this->DSPENGINE_MODE == DSPENGINE_FFT) use_fft = true;
+		else
+		{
+			/*
+			 * Direct form cost: one tap on one sample per tap per segment sample.
+			 * FFT cost depends on the number of impulse response partitions holding at least one tap (taps are in increasing delay order).
+			 */
+
+			for(n_tap = 0u; n_tap < this->taptable_n_taps; n_tap++)
+			{
+				n_part = (this->p_taptable[n_tap].n_delay)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+
+				if(!n_partitions || (n_part != n_part_prev)) n_partitions++;
+				n_part_prev = n_part;
+			}
+
+			use_fft = (this->fftconv.estimateCost(n_partitions) < ((double) this->taptable_n_taps)*((double) this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES));
+		}
+	}
+
+	if(!use_fft)
+	{
+		this->fftconv_active = false;
+		this->dspengine_curr.store(DSPENGINE_DIRECT, std::memory_order_relaxed);
+		return;
+	}
+
+	/*Impulse response: the tap gains at their delay times (zero at n = 0, the dry signal is not part of it)*/
+
+	ir_frames = this->p_taptable[this->taptable_n_taps - 1u].n_delay + 1u;
+	memset(this->p_fftconv_ir, 0, ir_frames*sizeof(double));
+
+	for(n_tap = 0u; n_tap < this->taptable_n_taps; n_tap++)
+	{
+		p_tap = &(this->p_taptable[n_tap]);
+
+		if(float_gains) this->p_fftconv_ir[p_tap->n_delay] += (double) p_tap->gain_f;
+		else this->p_fftconv_ir[p_tap->n_delay] += ldexp((double) p_tap->gain, -((int) p_tap->shift));
+	}
+
+	this->fftconv.setImpulseResponse(this->p_fftconv_ir, ir_frames);
+
+	if(this->fftconv_active && (this->fftconv.getHistoryFrames() <= this->fftconv_history_frames))
+	{
+		this->dspengine_curr.store(DSPENGINE_FFT, std::memory_order_relaxed);
+		return;
+	}
+
+	/*
+	 * Prime the input history from the input buffer (the segments before the current one).
+	 * This costs one transform per segment of history, only when the FFT engine is (re)engaged.
+	 * Segments older than the input buffer are pushed as silence, the impulse response is zero that far back.
+	 */
+
+	sample_size = (this->AUDIOBUFFER_SEGMENT_SIZE_BYTES)/(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	p_currin_mirror = (uint8_t*) (((size_t) this->pp_bufferinput_segments[this->bufferin_nseg_curr]) + this->BUFFERIN_SIZE_BYTES);
+
+	n_blocks = (this->fftconv.getHistoryFrames() + this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - 1u)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+
+	this->fftconv.reset();
+
+	for(n_block = n_blocks; n_block > 0u; n_block--)
+	{
+		if(n_block*(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) > this->BUFFERIN_SIZE_FRAMES) memset(this->p_fftconv_in, 0, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(double));
+		else this->bufferin_load_f64(this->p_fftconv_in, p_currin_mirror - n_block*(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES)*sample_size, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+
+		this->fftconv.push(this->p_fftconv_in);
+	}
+
+	this->fftconv_history_frames = n_blocks*(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+	this->fftconv_active = true;
+	this->dspengine_curr.store(DSPENGINE_FFT, std::memory_order_relaxed);
+
+	return;
+}
+
+void AudioRTDSP::comb_prime(bool float_gains, uint32_t comb_frac_bits)
+{
+	const audiortdsp_tap_t *p_tap = NULL;
+	uint8_t *p_currin_mirror = NULL;
+	double *p_acc = NULL;
+	double *p_in = NULL;
+	int32_t *p_state_i32 = NULL;
+	float *p_state_f32 = NULL;
+
+	size_t sample_size = 0u;
+	size_t n_frame = 0u;
+	size_t n_frames = 0u;
+	size_t n_samples = 0u;
+	size_t n_sample = 0u;
+	size_t n_tap = 0u;
+	double gain = 0.0;
+
+	/*
+	 * State slot j holds w[n0 - D + j] (n0: first frame of the current segment) = sum(k = 1...K) a^k*x[n0 - D + j - k*D].
+	 * Computed with the direct form, in double, a segment at a time.
+	 */
+
+	sample_size = (this->AUDIOBUFFER_SEGMENT_SIZE_BYTES)/(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	p_currin_mirror = (uint8_t*) (((size_t) this->pp_bufferinput_segments[this->bufferin_nseg_curr]) + this->BUFFERIN_SIZE_BYTES);
+
+	p_acc = this->p_comb_prime;
+	p_in = &(this->p_comb_prime[this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES]);
+	p_state_i32 = (int32_t*) this->p_comb_state;
+	p_state_f32 = (float*) this->p_comb_state;
+
+	for(n_frame = 0u; n_frame < this->comb_delay; n_frame += n_frames)
+	{
+		n_frames = this->comb_delay - n_frame;
+		if(n_frames > this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES;
+
+		n_samples = n_frames*(this->N_CHANNELS);
+
+		memset(p_acc, 0, n_samples*sizeof(double));
+
+		for(n_tap = 0u; n_tap < this->taptable_n_taps; n_tap++)
+		{
+			p_tap = &(this->p_taptable[n_tap]);
+
+			this->bufferin_load_f64(p_in, p_currin_mirror - (this->comb_delay + p_tap->n_delay - n_frame)*(this->N_CHANNELS)*sample_size, n_samples);
+
+			if(float_gains) gain = (double) p_tap->gain_f;
+			else gain = ldexp((double) p_tap->gain, -((int) p_tap->shift));
+
+			for(n_sample = 0u; n_sample < n_samples; n_sample++) p_acc[n_sample] += gain*p_in[n_sample];
+		}
+
+		if(float_gains) for(n_sample = 0u; n_sample < n_samples; n_sample++) p_state_f32[n_frame*(this->N_CHANNELS) + n_sample] = (float) p_acc[n_sample];
+		else for(n_sample = 0u; n_sample < n_samples; n_sample++) p_state_i32[n_frame*(this->N_CHANNELS) + n_sample] = (int32_t) llrint(ldexp(p_acc[n_sample], (int) comb_frac_bits));
+	}
+
+	this->comb_pos = 0u;
+	return;
+}
+
+void AudioRTDSP::fbdelay_prime(void)
+{
+	uint8_t *p_currin_mirror = NULL;
+	float *p_ring = NULL;
+
+	size_t sample_size = 0u;
+	size_t history_frames = 0u;
+	size_t n_frame = 0u;
+	size_t n_frames = 0u;
+	size_t n_subframe = 0u;
+	size_t n_channel = 0u;
+	double gain = 0.0;
+
+	/*
+	 * Runs the feedback loop over the input buffer (every frame before the current segment), starting from silence,
+	 * so that slot fbdelay_pos = 0 ends up holding v[n0 - D] (n0: first frame of the current segment).
+	 */
+
+	sample_size = (this->AUDIOBUFFER_SEGMENT_SIZE_BYTES)/(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	p_currin_mirror = (uint8_t*) (((size_t) this->pp_bufferinput_segments[this->bufferin_nseg_curr]) + this->BUFFERIN_SIZE_BYTES);
+
+	history_frames = this->BUFFERIN_SIZE_FRAMES - this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES;
+	gain = (double) this->fbdelay_gain;
+
+	memset(this->p_fbdelay, 0, (this->fbdelay_delay)*(this->N_CHANNELS)*sizeof(float));
+
+	this->fbdelay_pos = (this->fbdelay_delay - (history_frames % this->fbdelay_delay)) % this->fbdelay_delay;
+
+	for(n_frame = 0u; n_frame < history_frames; n_frame += n_frames)
+	{
+		n_frames = history_frames - n_frame;
+		if(n_frames > this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES;
+
+		this->bufferin_load_f64(this->p_fbdelay_prime, p_currin_mirror - (history_frames - n_frame)*(this->N_CHANNELS)*sample_size, n_frames*(this->N_CHANNELS));
+
+		for(n_subframe = 0u; n_subframe < n_frames; n_subframe++)
+		{
+			p_ring = &(this->p_fbdelay[(this->fbdelay_pos)*(this->N_CHANNELS)]);
+
+			for(n_channel = 0u; n_channel < this->N_CHANNELS; n_channel++)
+				p_ring[n_channel] = (float) (this->p_fbdelay_prime[n_subframe*(this->N_CHANNELS) + n_channel] + gain*((double) p_ring[n_channel]));
+
+			this->fbdelay_pos++;
+			if(this->fbdelay_pos == this->fbdelay_delay) this->fbdelay_pos = 0u;
+		}
+	}
+
+	return;
+}
+
+void AudioRTDSP::fftconv_proc(const void *p_currin_seg)
+{
+	this->bufferin_load_f64(this->p_fftconv_in, p_currin_seg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	this->fftconv.process(this->p_fftconv_in, this->p_fftconv_out);
+
+	if(this->fftconv_history_frames < this->BUFFERIN_SIZE_FRAMES) this->fftconv_history_frames += this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES;
+
+	return;
+}
+
+bool AudioRTDSP::buffer_render(void)
+{
+	/*Load and process one output buffer segment (bufferout_nseg_load). Returns false if playback should stop.*/
+
+	this->buffer_load();
+
+	if(this->stop_playback) return false;
+
+	this->bufferin_mirror_update();
+
+	this->p_bufferout_load = this->pp_bufferoutput_segments[this->bufferout_nseg_load];
+	this->dsp_proc();
+
+	this->segqueue_play.push(this->bufferout_nseg_load);
+	this->buffer_segment_update();
+
+	return true;
+}
+
+void AudioRTDSP::buffer_prerender(void)
+{
+	/*Fill the whole output ring before playback starts*/
+
+	while(this->segqueue_load.pop(&(this->bufferout_nseg_load)))
+	{
+		if(!this->buffer_render()) break;
+	}
+
+	return;
+}
+
+bool AudioRTDSP::segqueue_init(void)
+{
+	/*Each queue must fit every output buffer segment, plus the end of stream marker*/
+
+	if(!this->segqueue_load.initialize(this->BUFFEROUT_N_SEGMENTS + 1u)) return false;
+
+	if(!this->segqueue_play.initialize(this->BUFFEROUT_N_SEGMENTS + 1u))
+	{
+		this->segqueue_load.deinitialize();
+		return false;
+	}
+
+	return true;
+}
+
+void AudioRTDSP::segqueue_deinit(void)
+{
+	this->segqueue_load.deinitialize();
+	this->segqueue_play.deinitialize();
+	return;
+}
+
+bool AudioRTDSP::prefetch_alloc(void)
+{
+	size_t n_seg = 0u;
+
+	this->prefetch_free(); /*Clear any previous allocations*/
+
+	if(!this->FILEIN_SEGMENT_SIZE_BYTES) return false;
+
+	/*Whole segments per chunk: a chunk never leaves a partial segment behind (except at the end of the file)*/
+
+	this->PREFETCH_CHUNK_SIZE_BYTES = ((this->PREFETCH_CHUNK_SIZE_BYTES + this->FILEIN_SEGMENT_SIZE_BYTES - 1u)/(this->FILEIN_SEGMENT_SIZE_BYTES))*(this->FILEIN_SEGMENT_SIZE_BYTES);
+
+	/*The ring holds 2 chunks worth of decoded segments: one being played, one being read*/
+
+	this->PREFETCH_N_SEGMENTS = 2u*((this->PREFETCH_CHUNK_SIZE_BYTES + this->FILEIN_SEGMENT_SIZE_BYTES - 1u)/(this->FILEIN_SEGMENT_SIZE_BYTES));
+	if(this->PREFETCH_N_SEGMENTS < 4u) this->PREFETCH_N_SEGMENTS = 4u;
+
+	this->p_prefetchbuffer = malloc((this->PREFETCH_N_SEGMENTS)*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
+	this->pp_prefetch_segments = (void**) malloc((this->PREFETCH_N_SEGMENTS)*sizeof(void*));
+
+	if((this->p_prefetchbuffer == NULL) || (this->pp_prefetch_segments == NULL))
+	{
+		this->prefetch_free();
+		return false;
+	}
+
+	/*Mapped access decodes straight from the mapping, io_uring access has its own chunk buffers*/
+
+	if((this->FILEIN_ACCESS == FILEIN_ACCESS_URING) && !this->FILEIN_MAPPED) this->prefetch_uring_init();
+
+	if(!this->FILEIN_MAPPED && !this->FILEIN_URING) this->p_prefetch_chunk = (uint8_t*) malloc(this->PREFETCH_CHUNK_SIZE_BYTES + this->FILEIN_SEGMENT_SIZE_BYTES);
+
+	if(!this->FILEIN_MAPPED && !this->FILEIN_URING && (this->p_prefetch_chunk == NULL))
+	{
+		this->prefetch_free();
+		return false;
+	}
+
+	if(this->FILEIN_STREAM)
+	{
+		this->h_prefetch_stop_event = eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK);
+		if(this->h_prefetch_stop_event < 0)
+		{
+			this->h_prefetch_stop_event = -1;
+			this->prefetch_free();
+			return false;
+		}
+	}
+
+	/*Each queue must fit every prefetch segment, plus the end of stream marker*/
+
+	if(!this->prefetchqueue_free.initialize(this->PREFETCH_N_SEGMENTS + 1u))
+	{
+		this->prefetch_free();
+		return false;
+	}
+
+	if(!this->prefetchqueue_ready.initialize(this->PREFETCH_N_SEGMENTS + 1u))
+	{
+		this->prefetch_free();
+		return false;
+	}
+
+	for(n_seg = 0u; n_seg < this->PREFETCH_N_SEGMENTS; n_seg++) this->pp_prefetch_segments[n_seg] = (void*) (((size_t) this->p_prefetchbuffer) + n_seg*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
+
+	return true;
+}
+
+void AudioRTDSP::prefetch_free(void)
+{
+	this->prefetch_uring_deinit();
+
+	this->prefetchqueue_free.deinitialize();
+	this->prefetchqueue_ready.deinitialize();
+
+	if(this->h_prefetch_stop_event >= 0)
+	{
+		close(this->h_prefetch_stop_event);
+		this->h_prefetch_stop_event = -1;
+	}
+
+	if(this->p_prefetch_chunk != NULL)
+	{
+		free(this->p_prefetch_chunk);
+		this->p_prefetch_chunk = NULL;
+	}
+
+	if(this->p_prefetchbuffer != NULL)
+	{
+		free(this->p_prefetchbuffer);
+		this->p_prefetchbuffer = NULL;
+	}
+
+	if(this->pp_prefetch_segments != NULL)
+	{
+		free(this->pp_prefetch_segments);
+		this->pp_prefetch_segments = NULL;
+	}
+
+	this->PREFETCH_N_SEGMENTS = 0u;
+	return;
+}
+
+void AudioRTDSP::prefetch_start(void)
+{
+	/*The prefetch thread does file I/O only, it keeps the default scheduling class (even in real time mode)*/
+
+	uint64_t event_value = 0u;
+
+	/*Clear a stop event left over from a previous playback*/
+
+	if(this->h_prefetch_stop_event >= 0) read(this->h_prefetch_stop_event, &event_value, sizeof(uint64_t));
+
+	this->prefetchthread = std::thread(&AudioRTDSP::prefetchthread_proc, this);
+	return;
+}
+
+void AudioRTDSP::prefetch_stop(void)
+{
+	/*
+	 * The load thread is done with the prefetch ring. If the prefetch thread is still waiting for a free segment,
+	 * the end of stream marker in prefetchqueue_free tells it to quit.
+	 */
+
+	this->prefetchqueue_free.push(SEGMENTQUEUE_EOS);
+	this->prefetch_interrupt();
+	cppthread_wait(&(this->prefetchthread));
+
+	return;
+}
+
+void AudioRTDSP::prefetch_interrupt(void)
+{
+	uint64_t event_value = 1u;
+
+	if(this->h_prefetch_stop_event < 0) return;
+
+	write(this->h_prefetch_stop_event, &event_value, sizeof(uint64_t));
+	return;
+}
+
+void AudioRTDSP::prefetch_stats_reset(void)
+{
+	this->prefetch_primed.store(false, std::memory_order_relaxed);
+	this->prefetch_read_error.store(false, std::memory_order_relaxed);
+
+	this->prefetch_n_reads.store(0u, std::memory_order_relaxed);
+	this->prefetch_n_bytes.store(0u, std::memory_order_relaxed);
+	this->prefetch_refill_max_ns.store(0, std::memory_order_relaxed);
+	this->prefetch_refill_sum_ns.store(0, std::memory_order_relaxed);
+	this->prefetch_ready_min.store(this->PREFETCH_N_SEGMENTS, std::memory_order_relaxed);
+	this->prefetch_n_starved.store(0u, std::memory_order_relaxed);
+
+	return;
+}
+
+ssize_t AudioRTDSP::prefetch_read(uint8_t *p_dst, size_t n_bytes)
+{
+	struct pollfd poll_fds[2];
+	size_t n_total = 0u;
+	ssize_t n_ret = 0;
+
+	if(this->FILEIN_STREAM)
+	{
+		/*Wait for data or for prefetch_interrupt(). The event is not consumed: every later call returns 0 as well.*/
+
+		memset(poll_fds, 0, 2u*sizeof(struct pollfd));
+
+		poll_fds[0].fd = this->h_filein;
+		poll_fds[0].events = POLLIN;
+
+		poll_fds[1].fd = this->h_prefetch_stop_event;
+		poll_fds[1].events = POLLIN;
+
+		do n_ret = poll(poll_fds, 2, -1);
+		while((n_ret < 0) && (errno == EINTR));
+
+		if(n_ret < 0) return -1;
+		if(poll_fds[1].revents) return 0;
+
+		do n_ret = read(this->h_filein, p_dst, n_bytes);
+		while((n_ret < 0) && (errno == EINTR));
+
+		if(n_ret < 0) return -1;
+
+		this->filein_pos += (__offset) n_ret;
+		return n_ret;
+	}
+
+	while(n_total < n_bytes)
+	{
+		n_ret = __PREAD(this->h_filein, &p_dst[n_total], n_bytes - n_total, this->filein_pos);
+
+		if(n_ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+
+		if(!n_ret) break; /*End of file*/
+
+		n_total += (size_t) n_ret;
+		this->filein_pos += (__offset) n_ret;
+	}
+
+	return (ssize_t) n_total;
+}
+
+ssize_t AudioRTDSP::prefetch_map(size_t n_bytes)
+{
+	volatile uint8_t *p_byte = NULL;
+	__offset avail_end = 0;
+	__offset advise_end = 0;
+	size_t advise_begin = 0u;
+	size_t map_begin = 0u;
+	size_t n_byte = 0u;
+	struct timespec poll_time = {0, this->FILEIN_GROW_POLL_MS*1000000};
+	long wait_ms = 0;
+
+	/*Only touch the mapping below the current file size*/
+
+	while(true)
+	{
+		avail_end = __LSEEK(this->h_filein, 0, SEEK_END);
+		if(avail_end < 0) return -1;
+
+		if(avail_end > this->AUDIO_DATA_END) avail_end = this->AUDIO_DATA_END;
+		if(avail_end > this->filein_pos) break;
+
+		/*Nothing new. The file might still be growing.*/
+
+		if(this->stop_playback || (wait_ms >= this->FILEIN_GROW_TIMEOUT_MS)) return 0;
+
+		nanosleep(&poll_time, NULL); /*delay_ms() busy waits*/
+		wait_ms += this->FILEIN_GROW_POLL_MS;
+	}
+
+	if(((__offset) n_bytes) > (avail_end - this->filein_pos)) n_bytes = (size_t) (avail_end - this->filein_pos);
+
+	map_begin = (size_t) (this->filein_pos - this->FILEIN_MAP_OFFSET);
+
+	/*Read ahead: this chunk and the next one. madvise() wants a page aligned address.*/
+
+	advise_begin = map_begin - (map_begin%(this->FILEIN_PAGE_SIZE));
+	advise_end = this->filein_pos + ((__offset) (2u*n_bytes));
+	if(advise_end > avail_end) advise_end = avail_end;
+
+	madvise(&(this->p_filein_map[advise_begin]), ((size_t) (advise_end - this->FILEIN_MAP_OFFSET)) - advise_begin, MADV_WILLNEED);
+
+	/*Fault the new pages in here (one read per page), so the wait is taken by the prefetch thread*/
+
+	p_byte = (volatile uint8_t*) &(this->p_filein_map[map_begin]);
+
+	for(n_byte = 0u; n_byte < n_bytes; n_byte += this->FILEIN_PAGE_SIZE) (void) p_byte[n_byte];
+	(void) p_byte[n_bytes - 1u];
+
+	this->filein_pos += (__offset) n_bytes;
+	return (ssize_t) n_bytes;
+}
+
+bool AudioRTDSP::prefetch_uring_init(void)
+{
+	size_t n_buf = 0u;
+
+	this->prefetch_uring_deinit(); /*Clear any previous instances*/
+
+	/*Page aligned buffers, in one block*/
+
+	this->p_prefetch_uringbuf = (uint8_t*) aligned_alloc(4096u, (this->PREFETCH_URING_DEPTH)*(this->PREFETCH_CHUNK_SIZE_BYTES));
+	if(this->p_prefetch_uringbuf == NULL) return false;
+
+	for(n_buf = 0u; n_buf < this->PREFETCH_URING_DEPTH; n_buf++) this->pp_prefetch_uringbufs[n_buf] = &(this->p_prefetch_uringbuf[n_buf*(this->PREFETCH_CHUNK_SIZE_BYTES)]);
+
+	if(!this->prefetch_uring.initialize(this->h_filein, this->pp_prefetch_uringbufs, this->PREFETCH_URING_DEPTH, this->PREFETCH_CHUNK_SIZE_BYTES))
+	{
+		this->prefetch_uring_deinit();
+		return false;
+	}
+
+	this->FILEIN_URING = true;
+	return true;
+}
+
+void AudioRTDSP::prefetch_uring_deinit(void)
+{
+	/*If the reads in flight could not be reaped, the buffers are leaked rather than freed while the kernel may still write to them*/
+
+	if(this->prefetch_uring.deinitialize() && (this->p_prefetch_uringbuf != NULL)) free(this->p_prefetch_uringbuf);
+	this->p_prefetch_uringbuf = NULL;
+
+	this->FILEIN_URING = false;
+	return;
+}
+
+bool AudioRTDSP::prefetch_uring_submit(size_t n_buf)
+{
+	size_t n_bytes = 0u;
+
+	/*Chunk reads follow the same sequence as in read access: PREFETCH_CHUNK_SIZE_BYTES at a time, up to AUDIO_DATA_END*/
+
+	if(this->prefetch_uring_submit_pos >= this->AUDIO_DATA_END) return true; /*Nothing left to read*/
+
+	n_bytes = this->PREFETCH_CHUNK_SIZE_BYTES;
+	if(((__offset) n_bytes) > (this->AUDIO_DATA_END - this->prefetch_uring_submit_pos)) n_bytes = (size_t) (this->AUDIO_DATA_END - this->prefetch_uring_submit_pos);
+
+	if(!this->prefetch_uring.submit(n_buf, this->prefetch_uring_submit_pos, n_bytes)) return false;
+
+	this->prefetch_uring_sizes[n_buf] = n_bytes;
+	this->prefetch_uring_submit_pos += (__offset) n_bytes;
+
+	return true;
+}
+
+bool AudioRTDSP::prefetch_uring_start(void)
+{
+	size_t n_buf = 0u;
+
+	this->prefetch_uring_submit_pos = this->filein_pos;
+	this->prefetch_uring_nbuf_next = 0u;
+	this->prefetch_uring_nbuf_prev = this->PREFETCH_URING_DEPTH; /*None*/
+
+	for(n_buf = 0u; n_buf < this->PREFETCH_URING_DEPTH; n_buf++)
+	{
+		this->prefetch_uring_done[n_buf] = false;
+		this->prefetch_uring_sizes[n_buf] = 0u;
+		this->prefetch_uring_results[n_buf] = 0;
+	}
+
+	for(n_buf = 0u; n_buf < this->PREFETCH_URING_DEPTH; n_buf++)
+		if(!this->prefetch_uring_submit(n_buf)) return false;
+
+	return true;
+}
+
+void AudioRTDSP::prefetch_uring_drain(void)
+{
+	size_t n_buf = 0u;
+	ssize_t n_result = 0;
+
+	while(this->prefetch_uring.wait(&n_buf, &n_result));
+	return;
+}
+
+ssize_t AudioRTDSP::prefetch_uring_read(const uint8_t **pp_data)
+{
+	size_t n_buf = 0u;
+	ssize_t n_result = 0;
+	ssize_t n_rest = 0;
+
+	/*The chunk handed over last has been decoded. Its buffer is free for the next read.*/
+
+	if(this->prefetch_uring_nbuf_prev < this->PREFETCH_URING_DEPTH)
+	{
+		if(!this->prefetch_uring_submit(this->prefetch_uring_nbuf_prev)) return -1;
+		this->prefetch_uring_nbuf_prev = this->PREFETCH_URING_DEPTH;
+	}
+
+	/*Wait for the next chunk in file order. Chunks completing earlier are kept for later.*/
+
+	while(!this->prefetch_uring_done[this->prefetch_uring_nbuf_next])
+	{
+		if(!this->prefetch_uring.wait(&n_buf, &n_result)) return -1;
+
+		this->prefetch_uring_done[n_buf] = true;
+		this->prefetch_uring_results[n_buf] = n_result;
+	}
+
+	n_buf = this->prefetch_uring_nbuf_next;
+	n_result = this->prefetch_uring_results[n_buf];
+
+	this->prefetch_uring_done[n_buf] = false;
+
+	if(n_result < 0)
+	{
+		if((n_result != -EINTR) && (n_result != -EAGAIN)) return -1;
+		n_result = 0; /*Read the whole chunk with pread()*/
+	}
+
+	this->filein_pos += (__offset) n_result;
+
+	/*Short read: end of file, or the read was cut short. pread() finds out which.*/
+
+	if(((size_t) n_result) < this->prefetch_uring_sizes[n_buf])
+	{
+		n_rest = this->prefetch_read(&(this->pp_prefetch_uringbufs[n_buf][n_result]), this->prefetch_uring_sizes[n_buf] - ((size_t) n_result));
+		if(n_rest < 0) return -1;
+
+		n_result += n_rest;
+	}
+
+	*pp_data = this->pp_prefetch_uringbufs[n_buf];
+
+	this->prefetch_uring_nbuf_prev = n_buf;
+	this->prefetch_uring_nbuf_next = (n_buf + 1u)%(this->PREFETCH_URING_DEPTH);
+
+	return n_result;
+}
+
+void AudioRTDSP::prefetch_map_release(__offset pos)
+{
+	size_t release_end = 0u;
+
+	release_end = (size_t) (pos - this->FILEIN_MAP_OFFSET);
+	release_end -= release_end%(this->FILEIN_PAGE_SIZE); /*Whole pages only*/
+
+	if(release_end <= this->filein_map_released) return;
+
+	madvise(&(this->p_filein_map[this->filein_map_released]), release_end - this->filein_map_released, MADV_DONTNEED);
+	this->filein_map_released = release_end;
+
+	return;
+}
+
+void AudioRTDSP::buffer_load(void)
+{
+	/*Takes the next decoded segment from the prefetch ring. No file access here.*/
+
+	size_t n_seg = 0u;
+	size_t n_ready = 0u;
+
+	if(this->prefetch_primed.load(std::memory_order_acquire))
+	{
+		n_ready = this->prefetchqueue_ready.getCount();
+
+		if(n_ready < this->prefetch_ready_min.load(std::memory_order_relaxed)) this->prefetch_ready_min.store(n_ready, std::memory_order_relaxed);
+		if(!n_ready) this->prefetch_n_starved.fetch_add(1u, std::memory_order_relaxed);
+	}
+
+	if(!this->prefetchqueue_ready.wait_pop(&n_seg) || (n_seg == SEGMENTQUEUE_EOS))
+	{
+		this->stop_playback = true;
+		return;
+	}
+
+	memcpy(this->pp_bufferinput_segments[this->bufferin_nseg_curr], this->pp_prefetch_segments[n_seg], this->AUDIOBUFFER_SEGMENT_SIZE_BYTES);
+	this->prefetchqueue_free.push(n_seg);
+
+	return;
+}
+
+void AudioRTDSP::buffer_segment_update(void)
+{
+	this->bufferin_nseg_curr++;
+	this->bufferin_nseg_curr %= this->BUFFERIN_N_SEGMENTS;
+
+	return;
+}
+
+bool AudioRTDSP::audio_hw_recover(int error_code)
+{
+	/*Returns true if the device could be recovered from error_code (xrun), false otherwise*/
+
+	if(error_code != -EPIPE) return false;
+
+	if(snd_pcm_prepare(this->p_audiodev) < 0) return false;
+
+	return true;
+}
+
+bool AudioRTDSP::buffer_render_mmap(void)
+{
+	const snd_pcm_channel_area_t *p_areas = NULL;
+	snd_pcm_uframes_t offset = 0u;
+	snd_pcm_uframes_t n_frames = 0u;
+	snd_pcm_sframes_t n_avail = 0;
+	snd_pcm_sframes_t n_ret = 0;
+
+	size_t frame_size_bytes = 0u;
+	size_t n_frames_done = 0u;
+	bool rendered = false;
+
+	frame_size_bytes = (this->BUFFEROUT_SEGMENT_SIZE_BYTES)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+
+	/*
+	 * The segment is processed only once (dsp_proc() has state: delay lines, FFT history, dither), then committed to the device.
+	 * After an xrun the device is recovered and the same segment is committed again (from the scratch segment), so no input is dropped.
+	 */
+
+	while(true)
+	{
+		/*WAIT FOR ROOM IN DEVICE BUFFER*/
+
+		while(true)
+		{
+			n_avail = snd_pcm_avail_update(this->p_audiodev);
+			if(n_avail < 0)
+			{
+				if(!this->audio_hw_recover((int) n_avail)) app_exit(1, "AudioRTDSP::buffer_render_mmap: Error: snd_pcm_avail_update failed.");
+				continue;
+			}
+
+			if(((size_t) n_avail) >= this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) break;
+
+			/*Device buffer is full. If the stream is not running yet, it's time to start it.*/
+			if(snd_pcm_state(this->p_audiodev) == SND_PCM_STATE_PREPARED) snd_pcm_start(this->p_audiodev);
+
+			snd_pcm_wait(this->p_audiodev, -1);
+			this->playthread_timing_update();
+		}
+
+		/*MAP DEVICE BUFFER AREA*/
+
+		n_frames = (snd_pcm_uframes_t) this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES;
+
+		n_ret = (snd_pcm_sframes_t) snd_pcm_mmap_begin(this->p_audiodev, &p_areas, &offset, &n_frames);
+		if(n_ret < 0)
+		{
+			if(!this->audio_hw_recover((int) n_ret)) app_exit(1, "AudioRTDSP::buffer_render_mmap: Error: snd_pcm_mmap_begin failed.");
+			continue;
+		}
+
+		if(!rendered && (((size_t) n_frames) >= this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES))
+		{
+			/*Whole segment fits in the mapped area: process straight into the device buffer*/
+
+			this->p_bufferout_load = (void*) (((size_t) p_areas[0].addr) + ((size_t) (p_areas[0].first/8u)) + ((size_t) offset)*((size_t) (p_areas[0].step/8u)));
+			this->dsp_proc();
+
+			n_ret = snd_pcm_mmap_commit(this->p_audiodev, offset, n_frames);
+			if((n_ret >= 0) && (((snd_pcm_uframes_t) n_ret) == n_frames)) return true;
+
+			/*Keep the processed segment for the next attempt, the device area is reused after recovery*/
+
+			memcpy(this->pp_bufferoutput_segments[0], this->p_bufferout_load, this->BUFFEROUT_SEGMENT_SIZE_BYTES);
+			this->p_bufferout_load = this->pp_bufferoutput_segments[0];
+			rendered = true;
+
+			if(n_ret >= 0) n_ret = -EPIPE;
+			if(!this->audio_hw_recover((int) n_ret)) app_exit(1, "AudioRTDSP::buffer_render_mmap: Error: snd_pcm_mmap_commit failed.");
+			continue;
+		}
+
+		/*
+		 * Mapped area wraps around the end of the device buffer (or this is another attempt).
+		 * Process into the scratch segment, then copy it in two (or more) parts.
+		 */
 
-	this->stop_playback = false;
-	this->filein_pos = this->AUDIO_DATA_BEGIN;
+		if(!rendered)
+		{
+			this->p_bufferout_load = this->pp_bufferoutput_segments[0];
+			this->dsp_proc();
+			rendered = true;
+		}
 
-	return;
-}
+		n_frames_done = 0u;
 
-void AudioRTDSP::playback_loop(void)
-{
-	while(!this->stop_playback)
-	{
-		this->playthread = std::thread(&AudioRTDSP::playthread_proc, this);
-		loadthread_proc();
+		while(true)
+		{
+			memcpy((void*) (((size_t) p_areas[0].addr) + ((size_t) (p_areas[0].first/8u)) + ((size_t) offset)*((size_t) (p_areas[0].step/8u))), (const void*) (((size_t) this->p_bufferout_load) + n_frames_done*frame_size_bytes), ((size_t) n_frames)*frame_size_bytes);
 
-		cppthread_wait(&(this->playthread));
+			n_ret = snd_pcm_mmap_commit(this->p_audiodev, offset, n_frames);
+			if((n_ret < 0) || (((snd_pcm_uframes_t) n_ret) != n_frames)) break;
 
-		this->buffer_segment_update();
-	}
+			n_frames_done += (size_t) n_frames;
+			if(n_frames_done >= this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) return true;
 
-	return;
-}
+			n_frames = (snd_pcm_uframes_t) (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frames_done);
 
-void AudioRTDSP::buffer_segment_update(void)
-{
-	this->bufferin_nseg_curr++;
-	this->bufferin_nseg_curr %= this->BUFFERIN_N_SEGMENTS;
+			n_ret = (snd_pcm_sframes_t) snd_pcm_mmap_begin(this->p_audiodev, &p_areas, &offset, &n_frames);
+			if((n_ret < 0) || !n_frames) break;
+		}
 
-	this->bufferout_nseg_load++;
-	this->bufferout_nseg_load %= this->BUFFEROUT_N_SEGMENTS;
+		/*Recovery drops whatever part of the segment was already committed: it goes again as a whole*/
 
-	this->bufferout_nseg_play++;
-	this->bufferout_nseg_play %= this->BUFFEROUT_N_SEGMENTS;
+		if(n_ret >= 0) n_ret = -EPIPE;
+		if(!this->audio_hw_recover((int) n_ret)) app_exit(1, "AudioRTDSP::buffer_render_mmap: Error: snd_pcm_mmap_begin/snd_pcm_mmap_commit failed.");
+	}
 
-	return;
+	return true;
 }
 
 void AudioRTDSP::buffer_play(void)
@@ -245,44 +2329,60 @@ void AudioRTDSP::buffer_play(void)
 	return;
 }
 
-bool AudioRTDSP::retrieve_previn_nframe(size_t curr_buf_nframe, size_t n_delay, size_t *p_prev_buf_nframe, size_t *p_prev_nseg, size_t *p_prev_seg_nframe)
+void AudioRTDSP::playthread_timing_reset(void)
 {
-	size_t prev_buf_nframe = 0u;
-	size_t prev_nseg = 0u;
-	size_t prev_seg_nframe = 0u;
+	this->playthread_prev_wake.tv_sec = 0;
+	this->playthread_prev_wake.tv_nsec = 0;
 
-	if(curr_buf_nframe >= this->BUFFERIN_SIZE_FRAMES) return false;
-	if(n_delay >= this->BUFFERIN_SIZE_FRAMES) return false;
+	if(this->SAMPLE_RATE) this->PERIOD_TIME_NS = (int64_t) ((this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES*1000000000ul)/(this->SAMPLE_RATE));
+	else this->PERIOD_TIME_NS = 0;
 
-	if(n_delay > curr_buf_nframe) prev_buf_nframe = this->BUFFERIN_SIZE_FRAMES - (n_delay - curr_buf_nframe);
-	else prev_buf_nframe = curr_buf_nframe - n_delay;
+	/*Skip the periods used to fill the device buffer, plus the first wake up (no previous reference)*/
+	if(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) this->timing_n_skip = (this->AUDIOBUFFER_SIZE_FRAMES)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) + 1u;
+	else this->timing_n_skip = 1u;
 
-	prev_nseg = prev_buf_nframe/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
-	prev_seg_nframe = prev_buf_nframe%(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+	this->timing_n_periods.store(0u, std::memory_order_relaxed);
+	this->timing_jitter_max_ns.store(0, std::memory_order_relaxed);
+	this->timing_jitter_sum_ns.store(0, std::memory_order_relaxed);
+	this->timing_renderahead_min.store(this->BUFFEROUT_N_SEGMENTS, std::memory_order_relaxed);
 
-	if(p_prev_buf_nframe != NULL) *p_prev_buf_nframe = prev_buf_nframe;
-	if(p_prev_nseg != NULL) *p_prev_nseg = prev_nseg;
-	if(p_prev_seg_nframe != NULL) *p_prev_seg_nframe = prev_seg_nframe;
-
-	return true;
+	return;
 }
 
-bool AudioRTDSP::retrieve_previn_nframe(size_t curr_nseg, size_t curr_seg_nframe, size_t n_delay, size_t *p_prev_buf_nframe, size_t *p_prev_nseg, size_t *p_prev_seg_nframe)
+void AudioRTDSP::playthread_timing_update(void)
 {
-	size_t curr_buf_nframe = 0u;
+	struct timespec curr_wake;
+	int64_t interval_ns = 0;
+	int64_t jitter_ns = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &curr_wake);
 
-	if(curr_nseg >= this->BUFFERIN_N_SEGMENTS) return false;
-	if(curr_seg_nframe >= this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) return false;
+	interval_ns = ((int64_t) (curr_wake.tv_sec - this->playthread_prev_wake.tv_sec))*1000000000 + ((int64_t) (curr_wake.tv_nsec - this->playthread_prev_wake.tv_nsec));
+	this->playthread_prev_wake = curr_wake;
 
-	curr_buf_nframe = curr_nseg*(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) + curr_seg_nframe;
+	if(this->timing_n_skip)
+	{
+		this->timing_n_skip--;
+		return;
+	}
+
+	jitter_ns = interval_ns - this->PERIOD_TIME_NS;
+	if(jitter_ns < 0) jitter_ns = -jitter_ns;
 
-	return this->retrieve_previn_nframe(curr_buf_nframe, n_delay, p_prev_buf_nframe, p_prev_nseg, p_prev_seg_nframe);
+	if(jitter_ns > this->timing_jitter_max_ns.load(std::memory_order_relaxed)) this->timing_jitter_max_ns.store(jitter_ns, std::memory_order_relaxed);
+
+	this->timing_jitter_sum_ns.fetch_add(jitter_ns, std::memory_order_relaxed);
+	this->timing_n_periods.fetch_add(1u, std::memory_order_relaxed);
+
+	return;
 }
 
 void AudioRTDSP::cmdui_cmd_decode(void)
 {
 	const char *cmd = NULL;
 	const char *numtext = NULL;
+	const char *parse_error = NULL;
+	audiortdsp_custom_tap_t custom_tap;
 
 	this->usr_cmd = str_tolower(this->usr_cmd);
 
@@ -291,6 +2391,7 @@ void AudioRTDSP::cmdui_cmd_decode(void)
 	if(cstr_compare("stop", cmd))
 	{
 		this->stop_playback = true;
+		this->prefetch_interrupt(); /*The load thread may be waiting for stream input that isn't coming*/
 		return;
 	}
 
@@ -300,6 +2401,13 @@ void AudioRTDSP::cmdui_cmd_decode(void)
 		return;
 	}
 
+	if(cstr_compare("stats", cmd))
+	{
+		this->cmdui_print_timing_stats();
+		this->cmdui_print_prefetch_stats();
+		return;
+	}
+
 	if(cstr_compare("help", cmd) || cstr_compare("--help", cmd))
 	{
 		this->cmdui_print_help_text();
@@ -334,6 +2442,82 @@ void AudioRTDSP::cmdui_cmd_decode(void)
 		return;
 	}
 
+	if(this->cmdui_cmd_compare("setfbm:", cmd, 7u))
+	{
+		numtext = &cmd[7];
+		this->cmdui_attempt_updatevar(numtext, this->UPDATEVAR_FEEDBACKIIR);
+		return;
+	}
+
+	if(this->cmdui_cmd_compare("setfbg:", cmd, 7u))
+	{
+		numtext = &cmd[7];
+		this->cmdui_attempt_updatevar(numtext, this->UPDATEVAR_FEEDBACKGAIN);
+		return;
+	}
+
+	if(this->cmdui_cmd_compare("settm:", cmd, 6u))
+	{
+		numtext = &cmd[6];
+		this->cmdui_attempt_updatevar(numtext, this->UPDATEVAR_CUSTOMTAPS);
+		return;
+	}
+
+	if(cstr_compare("taps", cmd))
+	{
+		this->cmdui_print_custom_taps();
+		return;
+	}
+
+	if(this->cmdui_cmd_compare("tapadd:", cmd, 7u))
+	{
+		parse_error = this->customtap_parse(&cmd[7], &custom_tap);
+
+		if(parse_error != NULL)
+		{
+			std::cout << "Error: invalid tap: " << parse_error << "\nTap format is \"<delay>,<gain>\" or \"<delay>,<gain>,<source channel>,<destination channel>\"\n";
+			return;
+		}
+
+		if(!this->customtap_insert(&custom_tap))
+		{
+			std::cout << "Error: custom tap list is full (" << std::to_string(AUDIORTDSP_CUSTOMTAPS_MAX) << " taps)\n";
+			return;
+		}
+
+		this->fx_params.custom_taps = true;
+		this->fx_params_publish();
+
+		this->cmdui_print_current_params();
+		return;
+	}
+
+	if(this->cmdui_cmd_compare("tapdel:", cmd, 7u))
+	{
+		numtext = &cmd[7];
+		this->cmdui_attempt_updatevar(numtext, this->UPDATEVAR_TAPDELETE);
+		return;
+	}
+
+	if(cstr_compare("tapclear", cmd))
+	{
+		this->fx_params.n_custom_taps = 0u;
+		this->fx_params_publish();
+
+		this->cmdui_print_current_params();
+		return;
+	}
+
+	if(cstr_compare("tappreset", cmd))
+	{
+		this->customtaps_preset();
+		this->fx_params.custom_taps = true;
+		this->fx_params_publish();
+
+		this->cmdui_print_current_params();
+		return;
+	}
+
 	std::cout << "Error: invalid command entered\n";
 	return;
 }
@@ -355,10 +2539,20 @@ void AudioRTDSP::cmdui_print_help_text(void)
 	std::cout << "User command list:\n\n";
 	std::cout << "\"help\" or \"--help\" : print this list\n";
 	std::cout << "\"params\" : print current parameters\n";
+	std::cout << "\"stats\" : print playback period timing and input prefetch statistics\n";
 	std::cout << "\"setnd:<number>\" : set delay time (in number of samples)\n";
 	std::cout << "\"setnf:<number>\" : set number of feedback loops\n";
 	std::cout << "\"setfpa:<number>\" : alternate feedback polarity (0 = disable | 1 = enable)\n";
 	std::cout << "\"setcdi:<number>\" : set cycle divider increment (0 = exponential | 1 = by one)\n";
+	std::cout << "\"setfbm:<number>\" : set feedback mode (0 = parallel delays | 1 = recirculating feedback delay)\n";
+	std::cout << "\"setfbg:<number>\" : set feedback gain of the recirculating feedback delay (percent, 0 to " << std::to_string(this->FBDELAY_GAIN_MAX) << ")\n";
+	std::cout << "\"settm:<number>\" : set tap mode (0 = preset, from the parameters above | 1 = custom taps)\n";
+	std::cout << "\"taps\" : print the custom tap list\n";
+	std::cout << "\"tapadd:<delay>,<gain>\" : add a custom tap (delay in number of samples, gain from -1 to 1) and use the custom taps\n";
+	std::cout << "\"tapadd:<delay>,<gain>,<source>,<destination>\" : add a custom tap from source channel into destination channel (channels from 1)\n";
+	std::cout << "\"tapdel:<number>\" : delete custom tap <number> (as in the custom tap list)\n";
+	std::cout << "\"tapclear\" : delete all custom taps\n";
+	std::cout << "\"tappreset\" : replace the custom tap list with the preset taps and use the custom taps\n";
 	std::cout << "\"stop\" : stop playback and quit application\n\n";
 
 	return;
@@ -377,8 +2571,139 @@ void AudioRTDSP::cmdui_print_current_params(void)
 
 	std::cout << "Cycle divider increment: ";
 
-	if(this->fx_params.cyclediv_incone) std::cout << "by one\n\n";
-	else std::cout << "exponential\n\n";
+	if(this->fx_params.cyclediv_incone) std::cout << "by one\n";
+	else std::cout << "exponential\n";
+
+	std::cout << "Feedback mode: ";
+
+	if(this->fx_params.feedback_iir) std::cout << "recirculating feedback delay (feedback loops and cycle divider are not used)\n";
+	else std::cout << "parallel delays\n";
+
+	std::cout << "Feedback gain (recirculating feedback delay): " << std::to_string(this->fx_params.feedback_gain) << "%\n";
+
+	std::cout << "Tap mode: ";
+
+	if(this->fx_params.custom_taps) std::cout << "custom taps (" << std::to_string(this->fx_params.n_custom_taps) << ")\n";
+	else std::cout << "preset\n";
+
+	std::cout << "DSP engine: ";
+
+	switch(this->dspengine_curr.load(std::memory_order_relaxed))
+	{
+		case DSPENGINE_FFT:
+			std::cout << "FFT\n\n";
+			break;
+
+		case DSPENGINE_COMB:
+			std::cout << "recursive comb\n\n";
+			break;
+
+		case DSPENGINE_FEEDBACK:
+			std::cout << "feedback delay line\n\n";
+			break;
+
+		default:
+			std::cout << "direct\n\n";
+			break;
+	}
+
+	return;
+}
+
+void AudioRTDSP::cmdui_print_custom_taps(void)
+{
+	const audiortdsp_custom_tap_t *p_tap = NULL;
+	uint32_t n_tap = 0u;
+
+	if(!this->fx_params.n_custom_taps)
+	{
+		std::cout << "Custom tap list is empty\n\n";
+		return;
+	}
+
+	std::cout << "Custom taps (" << std::to_string(this->fx_params.n_custom_taps) << " of " << std::to_string(AUDIORTDSP_CUSTOMTAPS_MAX) << "):\n\n";
+
+	for(n_tap = 0u; n_tap < this->fx_params.n_custom_taps; n_tap++)
+	{
+		p_tap = &(this->fx_params.custom_tap_list[n_tap]);
+
+		std::cout << std::to_string(n_tap + 1u) << ": delay " << std::to_string(p_tap->n_delay) << ", gain " << std::to_string(p_tap->gain);
+
+		if(p_tap->src_channel >= 0) std::cout << ", channel " << std::to_string(p_tap->src_channel + 1) << " into channel " << std::to_string(p_tap->dst_channel + 1);
+
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl;
+	return;
+}
+
+void AudioRTDSP::cmdui_print_timing_stats(void)
+{
+	uint64_t n_periods = 0u;
+	int64_t jitter_max_ns = 0;
+	int64_t jitter_avg_ns = 0;
+
+	n_periods = this->timing_n_periods.load(std::memory_order_relaxed);
+	jitter_max_ns = this->timing_jitter_max_ns.load(std::memory_order_relaxed);
+
+	if(n_periods) jitter_avg_ns = this->timing_jitter_sum_ns.load(std::memory_order_relaxed)/((int64_t) n_periods);
+
+	std::cout << "Playback timing statistics:\n\n";
+	std::cout << "Nominal period time (us): " << std::to_string(this->PERIOD_TIME_NS/1000) << std::endl;
+	std::cout << "Periods measured: " << std::to_string(n_periods) << std::endl;
+	std::cout << "Average period jitter (us): " << std::to_string(jitter_avg_ns/1000) << std::endl;
+	std::cout << "Maximum period jitter (us): " << std::to_string(jitter_max_ns/1000) << std::endl;
+
+	if(this->MMAP_ACCESS)
+	{
+		std::cout << "Output access: mmap (device buffer is the render-ahead ring)\n\n";
+		return;
+	}
+
+	std::cout << "Render-ahead ring size (segments): " << std::to_string(this->BUFFEROUT_N_SEGMENTS) << std::endl;
+	std::cout << "Minimum render-ahead (segments): " << std::to_string(this->timing_renderahead_min.load(std::memory_order_relaxed)) << "\n\n";
+
+	return;
+}
+
+void AudioRTDSP::cmdui_print_prefetch_stats(void)
+{
+	uint64_t n_reads = 0u;
+	uint64_t n_bytes = 0u;
+	int64_t refill_sum_ns = 0;
+	int64_t refill_avg_ns = 0;
+	int64_t refill_max_ns = 0;
+	uint64_t throughput = 0u;
+
+	n_reads = this->prefetch_n_reads.load(std::memory_order_relaxed);
+	n_bytes = this->prefetch_n_bytes.load(std::memory_order_relaxed);
+	refill_sum_ns = this->prefetch_refill_sum_ns.load(std::memory_order_relaxed);
+	refill_max_ns = this->prefetch_refill_max_ns.load(std::memory_order_relaxed);
+
+	if(n_reads) refill_avg_ns = refill_sum_ns/((int64_t) n_reads);
+	if(refill_sum_ns > 0) throughput = (n_bytes*1000u)/((uint64_t) refill_sum_ns); /*bytes/ns*1000 = MB/s*/
+
+	std::cout << "Input prefetch statistics:\n\n";
+	if(this->FILEIN_MAPPED) std::cout << "Input file access: mmap\n";
+	else if(this->FILEIN_URING)
+	{
+		std::cout << "Input file access: io_uring, " << std::to_string(this->PREFETCH_URING_DEPTH) << " reads in flight";
+		if(this->prefetch_uring.fixedBuffers()) std::cout << ", fixed buffers";
+		if(this->prefetch_uring.fixedFile()) std::cout << ", fixed file";
+		std::cout << std::endl;
+	}
+	else std::cout << "Input file access: read\n";
+
+	std::cout << "Chunk size (KiB): " << std::to_string(this->PREFETCH_CHUNK_SIZE_BYTES/1024u) << std::endl;
+	std::cout << "Prefetch ring size (segments): " << std::to_string(this->PREFETCH_N_SEGMENTS) << std::endl;
+	std::cout << "Prefetch ring length (ms): " << std::to_string((((int64_t) this->PREFETCH_N_SEGMENTS)*(this->PERIOD_TIME_NS))/1000000) << std::endl;
+	std::cout << "Chunks read: " << std::to_string(n_reads) << std::endl;
+	std::cout << "Average refill time (us): " << std::to_string(refill_avg_ns/1000) << std::endl;
+	std::cout << "Maximum refill time (us): " << std::to_string(refill_max_ns/1000) << std::endl;
+	std::cout << "Read throughput (MB/s): " << std::to_string(throughput) << std::endl;
+	std::cout << "Minimum prefetch ring fill (segments): " << std::to_string(this->prefetch_ready_min.load(std::memory_order_relaxed)) << std::endl;
+	std::cout << "Prefetch ring underruns: " << std::to_string(this->prefetch_n_starved.load(std::memory_order_relaxed)) << "\n\n";
 
 	return;
 }
@@ -407,7 +2732,17 @@ bool AudioRTDSP::cmdui_attempt_updatevar(const char *numtext, int updatevar_desc
 				std::cout << "Error: invalid value entered\n";
 				return false;
 			}
-			if(((size_t) (value*(this->fx_params.n_feedback + 1))) >= this->BUFFERIN_SIZE_FRAMES)
+			if(this->fx_params.feedback_iir)
+			{
+				/*Feedback delay mode: the history is the feedback delay line, n_delay frames long*/
+
+				if(((size_t) value) >= this->FBDELAY_SIZE_FRAMES)
+				{
+					std::cout << "Error: delay time value is too big\n";
+					return false;
+				}
+			}
+			else if((((uint64_t) value)*((uint64_t) this->fx_params.n_feedback + 1u)) >= ((uint64_t) this->BUFFERIN_SIZE_FRAMES))
 			{
 				std::cout << "Error: delay time value is too big\n";
 				return false;
@@ -422,7 +2757,12 @@ bool AudioRTDSP::cmdui_attempt_updatevar(const char *numtext, int updatevar_desc
 				std::cout << "Error: invalid value entered\n";
 				return false;
 			}
-			if(((size_t) ((value + 1)*(this->fx_params.n_delay))) >= this->BUFFERIN_SIZE_FRAMES)
+			if(((size_t) value) >= this->TAPTABLE_SIZE)
+			{
+				std::cout << "Error: number of feedback loops is too big\n";
+				return false;
+			}
+			if(!this->fx_params.feedback_iir && ((((uint64_t) value + 1u)*((uint64_t) this->fx_params.n_delay)) >= ((uint64_t) this->BUFFERIN_SIZE_FRAMES)))
 			{
 				std::cout << "Error: number of feedback loops is too big\n";
 				return false;
@@ -450,27 +2790,97 @@ bool AudioRTDSP::cmdui_attempt_updatevar(const char *numtext, int updatevar_desc
 
 			this->fx_params.cyclediv_incone = (bool) value;
 			break;
+
+		case this->UPDATEVAR_FEEDBACKIIR:
+			if((value < 0) || (value > 1))
+			{
+				std::cout << "Error: invalid value entered\nValid values are \"0\" and \"1\"\n";
+				return false;
+			}
+			if(!value && ((((uint64_t) this->fx_params.n_delay)*((uint64_t) this->fx_params.n_feedback + 1u)) >= ((uint64_t) this->BUFFERIN_SIZE_FRAMES)))
+			{
+				std::cout << "Error: delay time is too big for the parallel delays mode\n";
+				return false;
+			}
+
+			this->fx_params.feedback_iir = (bool) value;
+			break;
+
+		case this->UPDATEVAR_FEEDBACKGAIN:
+			if((value < 0) || (value > this->FBDELAY_GAIN_MAX))
+			{
+				std::cout << "Error: invalid value entered\nValid values are \"0\" to \"" << std::to_string(this->FBDELAY_GAIN_MAX) << "\"\n";
+				return false;
+			}
+
+			this->fx_params.feedback_gain = (int32_t) value;
+			break;
+
+		case this->UPDATEVAR_CUSTOMTAPS:
+			if((value < 0) || (value > 1))
+			{
+				std::cout << "Error: invalid value entered\nValid values are \"0\" and \"1\"\n";
+				return false;
+			}
+
+			this->fx_params.custom_taps = (bool) value;
+			break;
+
+		case this->UPDATEVAR_TAPDELETE:
+			if((value < 1) || (((uint32_t) value) > this->fx_params.n_custom_taps))
+			{
+				std::cout << "Error: there's no custom tap " << std::to_string(value) << std::endl;
+				return false;
+			}
+
+			/*Removing a tap keeps the list sorted*/
+
+			memmove(&(this->fx_params.custom_tap_list[value - 1]), &(this->fx_params.custom_tap_list[value]), (this->fx_params.n_custom_taps - ((uint32_t) value))*sizeof(audiortdsp_custom_tap_t));
+			this->fx_params.n_custom_taps--;
+			break;
 	}
 
+	this->fx_params_publish();
+
 	this->cmdui_print_current_params();
 	return true;
 }
 
 void AudioRTDSP::loadthread_proc(void)
 {
-	this->buffer_load();
-
-	if(this->stop_playback) return;
-
-	this->dsp_proc();
+	while(!this->stop_playback)
+	{
+		if(!this->segqueue_load.wait_pop(&(this->bufferout_nseg_load))) break;
+		if(!this->buffer_render()) break;
+	}
 
+	this->segqueue_play.push(SEGMENTQUEUE_EOS); /*Tell playthread there is nothing left to play*/
 	return;
 }
 
 void AudioRTDSP::playthread_proc(void)
 {
-	this->buffer_play();
-	snd_pcm_wait(this->p_audiodev, -1);
+	size_t n_ready = 0u;
+
+	while(true)
+	{
+		if(!this->timing_n_skip && !this->stop_playback)
+		{
+			n_ready = this->segqueue_play.getCount();
+			if(n_ready < this->timing_renderahead_min.load(std::memory_order_relaxed)) this->timing_renderahead_min.store(n_ready, std::memory_order_relaxed);
+		}
+
+		if(!this->segqueue_play.wait_pop(&(this->bufferout_nseg_play))) break;
+		if(this->bufferout_nseg_play == SEGMENTQUEUE_EOS) break;
+
+		this->buffer_play();
+
+		/*snd_pcm_writei() already copied the segment, it can be handed back to the load thread right away*/
+		this->segqueue_load.push(this->bufferout_nseg_play);
+
+		snd_pcm_wait(this->p_audiodev, -1);
+		this->playthread_timing_update();
+	}
 
 	return;
 }
@@ -478,24 +2888,54 @@ void AudioRTDSP::playthread_proc(void)
 void AudioRTDSP::userthread_proc(void)
 {
 	int n_ret = 0;
-	struct pollfd poll_userinput;
+	struct pollfd poll_fds[2];
 
-	memset(&poll_userinput, 0, sizeof(struct pollfd));
+	memset(poll_fds, 0, 2u*sizeof(struct pollfd));
 
-	poll_userinput.fd = STDIN_FILENO;
-	poll_userinput.events = POLLIN;
+	poll_fds[0].fd = STDIN_FILENO;
+	poll_fds[0].events = POLLIN;
+
+	poll_fds[1].fd = this->h_userthread_event;
+	poll_fds[1].events = POLLIN;
+
+	if(this->FILEIN_STREAM_STDIN)
+	{
+		/*stdin carries the audio data*/
+		poll_fds[0].fd = -1;
+		std::cout << "Input is read from stdin: user commands are not available. Playback ends with the stream (or Ctrl+C).\n";
+	}
+	else this->cmdui_print_help_text();
 
-	this->cmdui_print_help_text();
 	this->cmdui_print_current_params();
 
 	while(!this->stop_playback)
 	{
-		n_ret = poll(&poll_userinput, 1, 1);
+		/*
+		 * Sleep until there's user input or playback is over (userthread_event_signal()). No timeout.
+		 */
+
+		n_ret = poll(poll_fds, 2, -1);
+
+		if(n_ret < 0)
+		{
+			if(errno == EINTR) continue;
+			break;
+		}
+
+		if(poll_fds[1].revents) break;
 
-		if(n_ret > 0)
+		if(poll_fds[0].revents)
 		{
 			this->usr_cmd = "";
 			std::cin >> this->usr_cmd;
+
+			if(std::cin.fail())
+			{
+				/*stdin closed (or unreadable). Stop watching it, just wait for the end of playback.*/
+				poll_fds[0].fd = -1;
+				continue;
+			}
+
 			this->cmdui_cmd_decode();
 		}
 	}
@@ -503,3 +2943,111 @@ void AudioRTDSP::userthread_proc(void)
 	return;
 }
 
+
+void AudioRTDSP::prefetchthread_proc(void)
+{
+	struct timespec read_begin;
+	struct timespec read_end;
+
+	const uint8_t *p_data = NULL;
+	size_t n_bytes = 0u; /*Bytes read (or mapped) but not handed over yet. They end at filein_pos.*/
+	size_t n_offset = 0u;
+	size_t n_decode = 0u;
+	size_t n_read_size = 0u;
+	size_t n_seg = 0u;
+	ssize_t n_read = 0;
+	int64_t refill_ns = 0;
+
+	bool end_of_data = false;
+	bool quit = false;
+
+	if(this->FILEIN_URING)
+	{
+		if(!this->prefetch_uring_start())
+		{
+			this->prefetch_read_error = true;
+			quit = true;
+		}
+	}
+
+	while(!end_of_data && !quit)
+	{
+		if(this->filein_pos >= this->AUDIO_DATA_END) break;
+
+		n_read_size = this->PREFETCH_CHUNK_SIZE_BYTES;
+		if(((__offset) n_read_size) > (this->AUDIO_DATA_END - this->filein_pos)) n_read_size = (size_t) (this->AUDIO_DATA_END - this->filein_pos);
+
+		clock_gettime(CLOCK_MONOTONIC, &read_begin);
+
+		if(this->FILEIN_MAPPED) n_read = this->prefetch_map(n_read_size);
+		else if(this->FILEIN_URING) n_read = this->prefetch_uring_read(&p_data); /*Whole chunks: n_bytes is always 0 here*/
+		else n_read = this->prefetch_read(&(this->p_prefetch_chunk[n_bytes]), n_read_size);
+
+		clock_gettime(CLOCK_MONOTONIC, &read_end);
+
+		if(n_read < 0)
+		{
+			this->prefetch_read_error = true;
+			break;
+		}
+
+		refill_ns = ((int64_t) (read_end.tv_sec - read_begin.tv_sec))*1000000000 + ((int64_t) (read_end.tv_nsec - read_begin.tv_nsec));
+
+		if(refill_ns > this->prefetch_refill_max_ns.load(std::memory_order_relaxed)) this->prefetch_refill_max_ns.store(refill_ns, std::memory_order_relaxed);
+		this->prefetch_refill_sum_ns.fetch_add(refill_ns, std::memory_order_relaxed);
+		this->prefetch_n_bytes.fetch_add((uint64_t) n_read, std::memory_order_relaxed);
+		this->prefetch_n_reads.fetch_add(1u, std::memory_order_relaxed);
+
+		/*
+		 * A short read means the file is shorter than the header says.
+		 * A mapped file ends when it stops growing (prefetch_map() already waited for it). A stream ends when it's closed.
+		 */
+
+		if(this->FILEIN_MAPPED || this->FILEIN_STREAM) end_of_data = !n_read;
+		else end_of_data = (((size_t) n_read) < n_read_size);
+
+		if(this->filein_pos >= this->AUDIO_DATA_END) end_of_data = true;
+
+		n_bytes += (size_t) n_read;
+
+		if(this->FILEIN_MAPPED) p_data = &(this->p_filein_map[(size_t) (this->filein_pos - this->FILEIN_MAP_OFFSET) - n_bytes]);
+		else if(!this->FILEIN_URING) p_data = this->p_prefetch_chunk;
+
+		/*Hand over every whole segment. At the end of the audio data, the last (partial) segment as well.*/
+
+		n_offset = 0u;
+		while(n_offset < n_bytes)
+		{
+			n_decode = n_bytes - n_offset;
+
+			if(n_decode > this->FILEIN_SEGMENT_SIZE_BYTES) n_decode = this->FILEIN_SEGMENT_SIZE_BYTES;
+			else if((n_decode < this->FILEIN_SEGMENT_SIZE_BYTES) && !end_of_data) break; /*Partial segment: rest of it comes with the next chunk*/
+
+			if(!this->prefetchqueue_free.wait_pop(&n_seg) || (n_seg == SEGMENTQUEUE_EOS))
+			{
+				quit = true;
+				break;
+			}
+
+			this->prefetch_decode(this->pp_prefetch_segments[n_seg], &p_data[n_offset], n_decode);
+			this->prefetchqueue_ready.push(n_seg);
+
+			n_offset += n_decode;
+		}
+
+		n_bytes -= n_offset;
+
+		if(this->FILEIN_MAPPED) this->prefetch_map_release(this->filein_pos - ((__offset) n_bytes));
+		else if(!this->FILEIN_URING && n_bytes) memmove(this->p_prefetch_chunk, &(this->p_prefetch_chunk[n_offset]), n_bytes);
+
+		/*Ring is filled after the first chunk, stop taking stats once there's nothing left to refill it with*/
+		this->prefetch_primed.store(!end_of_data, std::memory_order_release);
+	}
+
+	this->prefetch_primed.store(false, std::memory_order_release);
+	this->prefetchqueue_ready.push(SEGMENTQUEUE_EOS); /*Tell the load thread there is nothing left to load*/
+
+	if(this->FILEIN_URING) this->prefetch_uring_drain(); /*Reads past the end of the file, or stopped early*/
+
+	return;
+}
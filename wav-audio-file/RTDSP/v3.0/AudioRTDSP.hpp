@@ -13,9 +13,19 @@
 #include "filedef.h"
 #include "strdef.hpp"
 #include "cppthread.hpp"
+#include "SegmentQueue.hpp"
+#include "UringReader.hpp"
+#include "dspkernel.hpp"
+#include "FFTConvolver.hpp"
+#include "pcm24.h"
 
 #include "shared.hpp"
 
+#include <atomic>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
 #include <alsa/asoundlib.h>
 
 /*
@@ -36,8 +46,53 @@
  * cycle divider increment one: in every loop iteration, the amplitude of the delayed sample is divided by a divider factor, which is calculated by the loop iteration.
  * If cycle divider increment is set to true, then the cycle divider will increment by one, following the iteration value.
  * If cycle divider increment is set to false, then the cycle divider will increment exponentially.
+ *
+ * Custom taps: instead of the taps generated from the 4 parameters (the preset), the delay taps may be given one by one (tap file or user commands).
+ * Each tap has a delay time, a gain (negative for reversed polarity) and optionally a routing (source channel into destination channel, e.g. ping-pong echoes).
+ * Whichever way they're given, taps end up in the same compiled tap table.
+ *
+ * Feedback delay mode (feedback mode = recirculating): a real feedback loop instead of the parallel feedforward delays.
+ * The delayed signal is fed back into a delay line of "delay" samples, scaled by the feedback gain (percent, negative if alternate feedback polarity is set)
+ * every time it goes around. Echo k comes out at k*delay samples with amplitude gain^k, with no end: the tail dies out on its own.
+ * Feedback loops and cycle divider increment are not used in this mode. Cost is one delay line read and write per sample, memory is "delay" samples.
+ */
+
+/*
+ * Input file access modes.
+ * FILEIN_ACCESS_READ: the audio data is read with pread().
+ * FILEIN_ACCESS_MMAP: the audio data region is memory mapped, and decoded straight from the mapping.
+ * FILEIN_ACCESS_URING: the audio data is read with io_uring, several reads in flight. Falls back to FILEIN_ACCESS_READ if io_uring is not available.
+ *
+ * Stream input (stdin, FIFO, socket): the audio data is read with read(), strictly in order, no seeks. The access mode is always FILEIN_ACCESS_READ.
+ * filein_stream_fd is the already open stream, positioned at audio_data_begin (the caller has read the header, if any). The audio object takes it over.
+ * If the stream length is unknown, audio_data_end is FILEIN_STREAM_END: the audio data goes on until the stream is closed.
  */
 
+#define FILEIN_STREAM_END ((__offset) ((((uint64_t) 1u) << (8u*sizeof(__offset) - 1u)) - 1u))
+
+enum FileinAccess {
+	FILEIN_ACCESS_READ = 0,
+	FILEIN_ACCESS_MMAP = 1,
+	FILEIN_ACCESS_URING = 2
+};
+
+/*
+ * Delay tap engines.
+ * DSPENGINE_DIRECT: every tap is added over the whole segment (direct form, cost grows with the number of taps).
+ * DSPENGINE_FFT: the tap table is turned into an impulse response and convolved by FFTConvolver (cost grows with the number of non zero impulse response partitions).
+ * DSPENGINE_COMB: exponential divider mode only (the direct form is used otherwise). The tap series is computed by a recursive comb, at a fixed cost per sample.
+ * DSPENGINE_AUTO: recursive comb in exponential divider mode, else whichever of direct form and FFT is cheaper. Decided every time the tap table is rebuilt.
+ * DSPENGINE_FEEDBACK: feedback delay mode (no taps). Not an option: it follows fx_params, whatever engine mode is set.
+ */
+
+enum DspEngine {
+	DSPENGINE_AUTO = 0,
+	DSPENGINE_DIRECT = 1,
+	DSPENGINE_FFT = 2,
+	DSPENGINE_COMB = 3,
+	DSPENGINE_FEEDBACK = 4
+};
+
 struct _audiortdsp_pb_params {
 	const char *audio_dev_desc;
 	const char *filein_dir;
@@ -45,23 +100,125 @@ struct _audiortdsp_pb_params {
 	__offset audio_data_end;
 	uint32_t sample_rate;
 	uint16_t n_channels;
+	uint32_t bufferout_n_segments; /*Output (render-ahead) ring size in number of segments. Set to 0 for default. Not used in mmap access mode.*/
+	bool mmap_access; /*If true, try to use ALSA mmap access (dsp_proc() writes directly into the device buffer).*/
+	bool dsp_bitexact; /*If true, delay taps reproduce the truncating integer division of previous versions exactly.*/
+	int dsp_kernel; /*DSP kernel set (see dspkernel.hpp). Set to 0 (DSPKERNEL_AUTO) to use the best one the CPU supports.*/
+	int dsp_engine; /*Delay tap engine (DspEngine). Set to 0 (DSPENGINE_AUTO) to use the cheaper one. Bit-exact mode always uses the direct form.*/
+	uint32_t prefetch_chunk_size; /*Input file read size of the prefetch thread, in bytes. Set to 0 for default. Not used in mmap access mode.*/
+	int filein_access; /*Input file access mode (FileinAccess). Set to 0 (FILEIN_ACCESS_READ) for default.*/
+	bool dither; /*If true, add TPDF dither when the float pipeline (AudioRTDSP_f32) converts to the device sample format.*/
+	bool filein_stream; /*If true, the input is a stream (filein_stream_fd). filein_dir is only used for messages.*/
+	int filein_stream_fd;
+	const char *taps_file; /*Custom tap file (see customtaps_load()), or NULL for none.*/
+};
+
+/*
+ * Real time mode parameters (optional).
+ *
+ * enable: if false, audio threads keep the default scheduling class and nothing else here is used.
+ * sched_policy: SCHED_FIFO or SCHED_RR.
+ * playthread_priority, loadthread_priority: real time priority for the play thread and the load (DSP) thread.
+ * playthread_cpu, loadthread_cpu: CPU core each thread is pinned to. Set to -1 to leave the thread unpinned.
+ * lock_memory: if true, all process memory is locked (mlockall) and the audio buffers are pre-faulted.
+ *
+ * Real time scheduling and memory locking usually require root privileges, CAP_SYS_NICE/CAP_IPC_LOCK or proper rlimits (RLIMIT_RTPRIO, RLIMIT_MEMLOCK).
+ * If a request can't be granted, playback still runs with whatever was granted, and a report is printed.
+ */
+
+struct _audiortdsp_rt_params {
+	bool enable;
+	int sched_policy;
+	int playthread_priority;
+	int loadthread_priority;
+	int playthread_cpu;
+	int loadthread_cpu;
+	bool lock_memory;
+};
+
+/*
+ * Custom tap (user tap list entry).
+ * n_delay: delay time in number of frames. gain: -1.0 to 1.0, negative for reversed polarity.
+ * src_channel, dst_channel: routing (0 based). Both -1: every channel feeds itself, like the preset taps.
+ * Otherwise only src_channel is delayed, into dst_channel.
+ */
+
+#define AUDIORTDSP_CUSTOMTAPS_MAX 128U
+
+struct _audiortdsp_custom_tap {
+	int32_t n_delay;
+	float gain;
+	int16_t src_channel;
+	int16_t dst_channel;
 };
 
+typedef struct _audiortdsp_custom_tap audiortdsp_custom_tap_t;
+
+/*
+ * custom_taps: if true, the tap table is compiled from custom_tap_list (n_custom_taps entries, sorted by delay time),
+ * else it's generated from n_delay, n_feedback, feedback_altpol and cyclediv_incone (preset).
+ * The tap list is ignored in feedback delay mode (feedback_iir).
+ */
+
 struct _audiortdsp_fx_params {
 	int32_t n_delay;
 	int32_t n_feedback;
 	bool feedback_altpol;
 	bool cyclediv_incone;
+	bool feedback_iir;
+	int32_t feedback_gain;
+	bool custom_taps;
+	uint32_t n_custom_taps;
+	audiortdsp_custom_tap_t custom_tap_list[AUDIORTDSP_CUSTOMTAPS_MAX];
 };
 
 typedef struct _audiortdsp_pb_params audiortdsp_pb_params_t;
+/*
+ * Delay tap table entry.
+ *
+ * The tap table is compiled from fx_params (taptable_update()) and used by dsp_proc(), so the per sample math
+ * needs no division and no polarity/divider calculation. Taps are sorted by delay time, whatever their source (preset or custom taps).
+ * An entry is 32 bytes: two per cache line.
+ *
+ * n_delay: tap delay time in number of frames.
+ * src_channel, dst_channel: -1 for taps applied to every channel (each one feeds itself), else the routing of a custom tap.
+ *
+ * Fast mode (default):
+ * gain: signed fixed point gain (polarity included). For the exponential divider mode, gain is the polarity only (1 or -1).
+ * shift: fixed point shift. For the exponential divider mode, shift is log2(cycle_div).
+ * Tap output = (sample*gain + rounding) >> shift
+ *
+ * Custom taps: gain is the tap gain in fixed point, with the largest shift (up to gain_q_bits) it fits in.
+ *
+ * Bit-exact mode (preset taps only, custom taps are always processed as in the fast mode, magic = 0):
+ * gain: polarity (1 or -1).
+ * magic, shift: magic number and shift for an exact truncating division by cycle_div.
+ * Tap output = sign(gain*sample)*((|gain*sample|*magic) >> shift), same as (gain*sample)/cycle_div
+ *
+ * Float pipeline (AudioRTDSP_f32):
+ * gain_f: polarity/cycle_div (custom taps: the tap gain). Tap output = sample*gain_f
+ */
+
+struct _audiortdsp_tap {
+	size_t n_delay;
+	int32_t gain;
+	uint32_t shift;
+	uint64_t magic;
+	float gain_f;
+	int16_t src_channel;
+	int16_t dst_channel;
+};
+
+typedef struct _audiortdsp_rt_params audiortdsp_rt_params_t;
 typedef struct _audiortdsp_fx_params audiortdsp_fx_params_t;
+typedef struct _audiortdsp_tap audiortdsp_tap_t;
 
 class AudioRTDSP {
 	public:
 		AudioRTDSP(const audiortdsp_pb_params_t *p_pbparams);
 
 		bool setPlaybackParameters(const audiortdsp_pb_params_t *p_pbparams);
+		bool setRealTimeParameters(const audiortdsp_rt_params_t *p_rtparams);
 		bool initialize(void);
 		bool runPlayback(void);
 
@@ -82,7 +239,11 @@ class AudioRTDSP {
 			UPDATEVAR_NDELAY = 1,
 			UPDATEVAR_NFEEDBACK = 2,
 			UPDATEVAR_FEEDBACKALTPOL = 3,
-			UPDATEVAR_CYCLEDIVINCONE = 4
+			UPDATEVAR_CYCLEDIVINCONE = 4,
+			UPDATEVAR_FEEDBACKIIR = 5,
+			UPDATEVAR_FEEDBACKGAIN = 6,
+			UPDATEVAR_CUSTOMTAPS = 7,
+			UPDATEVAR_TAPDELETE = 8
 		};
 
 		/*
@@ -92,12 +253,26 @@ class AudioRTDSP {
 		 *
 		 * Segment size is defined by the audio device buffer segment size (period size).
 		 *
-		 * Output buffer is only two segments: currently loading and currently playing.
+		 * Output buffer is a render-ahead ring of BUFFEROUT_N_SEGMENTS segments (2 by default: currently loading and currently playing).
 		 * Input buffer will have multiple segments.
+		 *
+		 * Output buffer segments are handed between the load thread and the play thread through two segment queues:
+		 * segqueue_load holds the segments that are free to be loaded, segqueue_play holds the segments that are ready to be played.
+		 * Both threads are started once per playback and live until playback is finished.
+		 *
+		 * The effect output depends only on the input file data, so the load thread may render as many segments ahead as the ring allows.
+		 * A bigger ring absorbs slow file reads and slow dsp_proc() calls, at the cost of a longer delay when changing settings
+		 * (new settings are heard only after the segments already rendered are played).
 		 */
 
 		static constexpr size_t BUFFERIN_SIZE_FRAMES = 65536u;
-		static constexpr size_t BUFFEROUT_N_SEGMENTS = 2u;
+
+		static constexpr size_t BUFFEROUT_N_SEGMENTS_DEFAULT = 2u;
+		static constexpr size_t BUFFEROUT_N_SEGMENTS_MIN = 2u;
+		static constexpr size_t BUFFEROUT_N_SEGMENTS_MAX = 256u;
+
+		size_t BUFFEROUT_N_SEGMENTS = BUFFEROUT_N_SEGMENTS_DEFAULT;
+		bool BUFFEROUT_N_SEGMENTS_REQUESTED = false; /*Ring size given by the caller (not the default). Ignored in mmap access mode.*/
 
 		size_t BUFFERIN_SIZE_SAMPLES = 0u;
 		size_t BUFFERIN_SIZE_BYTES = 0u;
@@ -115,17 +290,33 @@ class AudioRTDSP {
 		size_t AUDIOBUFFER_SEGMENT_SIZE_SAMPLES = 0u;
 		size_t AUDIOBUFFER_SEGMENT_SIZE_BYTES = 0u;
 
+		/*
+		 * AUDIOBUFFER_SEGMENT_SIZE_BYTES is the size of one segment in the internal sample format (input buffer, prefetch ring).
+		 * BUFFEROUT_SEGMENT_SIZE_BYTES is the size of one segment in the device sample format (output buffer, device buffer).
+		 * They only differ if the device sample format is not the internal one (e.g. S24_3LE: 3 bytes per sample, internal int32).
+		 */
+
+		size_t BUFFEROUT_SEGMENT_SIZE_BYTES = 0u;
+
 		/*
 		 * These are index variables to keep track of the current buffer segments in context.
 		 * bufferin_nseg_curr is the index for the current input buffer segment in context.
-		 * bufferout_nseg_load is the index for the output buffer segment to be loaded.
-		 * bufferout_nseg_play is the index for the output buffer segment to be played.
+		 * bufferout_nseg_load is the index for the output buffer segment to be loaded. Owned by the load thread.
+		 * bufferout_nseg_play is the index for the output buffer segment to be played. Owned by the play thread.
 		 */
 
 		size_t bufferout_nseg_load = 0u;
 		size_t bufferout_nseg_play = 0u;
 		size_t bufferin_nseg_curr = 0u;
 
+		/*
+		 * p_bufferout_load is where dsp_proc() writes the processed segment (AUDIOBUFFER_SEGMENT_SIZE_FRAMES frames, device sample format).
+		 * In RW access mode it points to the output buffer segment being loaded.
+		 * In mmap access mode it points straight into the device buffer (or to a scratch output segment, when the device area wraps around).
+		 */
+
+		void *p_bufferout_load = NULL;
+
 		/*
 		 * p_bufferinput and p_bufferoutput are the input and output buffers.
 		 * pp_bufferinput_segments and pp_bufferoutput_segments are pointer arrays, each pointer in the array points to
@@ -135,9 +326,78 @@ class AudioRTDSP {
 		void *p_bufferinput = NULL;
 		void *p_bufferoutput = NULL;
 
+		/*
+		 * The input buffer is a mirrored ring: p_bufferinput is 2*BUFFERIN_SIZE_BYTES long, and the upper half is always the same as the lower half.
+		 * Normally both halves are mappings of the same memory pages (BUFFERIN_MIRROR_MAPPED), so writing to one also writes to the other.
+		 * If that's not possible, bufferin_mirror_update() copies each newly loaded segment to the upper half (BUFFERIN_MIRROR_COPY).
+		 *
+		 * This way, any window of input frames that wraps around the end of the ring is still contiguous in memory:
+		 * frame (curr_buf_nframe - n_delay) is at (curr_buf_nframe + BUFFERIN_SIZE_FRAMES - n_delay), for any n_delay < BUFFERIN_SIZE_FRAMES.
+		 */
+
+		bool BUFFERIN_MIRROR_MAPPED = false;
+		bool BUFFERIN_MIRROR_COPY = false;
+
 		void **pp_bufferinput_segments = NULL;
 		void **pp_bufferoutput_segments = NULL;
 
+		SegmentQueue segqueue_load;
+		SegmentQueue segqueue_play;
+
+		/*
+		 * Prefetch stage.
+		 * The prefetch thread is the only thread that reads the input file. It reads PREFETCH_CHUNK_SIZE_BYTES at a time, ahead of the playhead,
+		 * decodes the audio data into segments (prefetch_decode()) and hands them to the load thread through a ring of PREFETCH_N_SEGMENTS decoded segments.
+		 * prefetchqueue_ready holds the decoded segments (plus SEGMENTQUEUE_EOS at the end of the audio data), prefetchqueue_free holds the segments buffer_load() is done with.
+		 * The load (DSP) thread never touches the file descriptor: a slow read only drains the prefetch ring.
+		 *
+		 * FILEIN_SEGMENT_SIZE_BYTES is the size of one segment in the file sample format (set by audio_hw_init()).
+		 * p_prefetch_chunk holds the chunk being read, plus the leftover bytes of the previous chunk (a chunk doesn't always end on a segment boundary).
+		 */
+
+		static constexpr size_t PREFETCH_CHUNK_SIZE_DEFAULT = 1048576u;
+		static constexpr size_t PREFETCH_CHUNK_SIZE_MIN = 4096u;
+		static constexpr size_t PREFETCH_CHUNK_SIZE_MAX = 67108864u;
+
+		size_t PREFETCH_CHUNK_SIZE_BYTES = PREFETCH_CHUNK_SIZE_DEFAULT;
+		size_t PREFETCH_N_SEGMENTS = 0u;
+		size_t FILEIN_SEGMENT_SIZE_BYTES = 0u;
+
+		uint8_t *p_prefetch_chunk = NULL;
+		void *p_prefetchbuffer = NULL;
+		void **pp_prefetch_segments = NULL;
+
+		SegmentQueue prefetchqueue_free;
+		SegmentQueue prefetchqueue_ready;
+
+		std::thread prefetchthread;
+
+		/*
+		 * io_uring access (FILEIN_URING is set by prefetch_uring_init(), it's only true if io_uring could be set up).
+		 * PREFETCH_URING_DEPTH chunk reads are kept in flight, each into its own (registered) chunk buffer, used round robin.
+		 * Chunks are handed over in file order, whatever order the reads complete in.
+		 *
+		 * prefetch_uring_submit_pos: file offset of the next chunk read to be submitted.
+		 * prefetch_uring_nbuf_next: chunk buffer to be handed over next.
+		 * prefetch_uring_nbuf_prev: chunk buffer handed over last (it's refilled on the next call to prefetch_uring_read()).
+		 */
+
+		static constexpr size_t PREFETCH_URING_DEPTH = 4u;
+
+		bool FILEIN_URING = false;
+
+		UringReader prefetch_uring;
+
+		uint8_t *p_prefetch_uringbuf = NULL;
+		uint8_t *pp_prefetch_uringbufs[PREFETCH_URING_DEPTH];
+		size_t prefetch_uring_sizes[PREFETCH_URING_DEPTH];
+		ssize_t prefetch_uring_results[PREFETCH_URING_DEPTH];
+		bool prefetch_uring_done[PREFETCH_URING_DEPTH];
+
+		__offset prefetch_uring_submit_pos = 0;
+		size_t prefetch_uring_nbuf_next = 0u;
+		size_t prefetch_uring_nbuf_prev = 0u;
+
 		snd_pcm_t *p_audiodev = NULL;
 
 		int h_filein = -1;
@@ -147,8 +407,70 @@ class AudioRTDSP {
 		__offset AUDIO_DATA_BEGIN = 0;
 		__offset AUDIO_DATA_END = 0;
 
+		/*
+		 * FILEIN_ACCESS is set by setPlaybackParameters().
+		 * FILEIN_MAPPED is set by filein_map(), it's only true if the audio data region could be mapped.
+		 *
+		 * Mapped access: the audio data region is mapped read only. p_filein_map starts at the page holding AUDIO_DATA_BEGIN
+		 * (FILEIN_MAP_OFFSET, the mapping offset must be page aligned), so the data offset doesn't need to be aligned.
+		 * The prefetch thread decodes straight from the mapping (no read() calls). It asks the kernel to read ahead (MADV_WILLNEED)
+		 * and drops the pages behind the playhead (MADV_DONTNEED, filein_map_released), so only about 2 chunks of the file stay mapped in memory.
+		 *
+		 * The mapping covers up to AUDIO_DATA_END, but only the part below the current file size is ever touched.
+		 * A file that is still being written is followed as it grows. Playback ends if it doesn't grow for FILEIN_GROW_TIMEOUT_MS.
+		 */
+
+		static constexpr long FILEIN_GROW_TIMEOUT_MS = 1000;
+		static constexpr long FILEIN_GROW_POLL_MS = 10;
+
+		int FILEIN_ACCESS = FILEIN_ACCESS_READ;
+		bool FILEIN_MAPPED = false;
+
+		uint8_t *p_filein_map = NULL;
+		size_t FILEIN_MAP_SIZE = 0u;
+		size_t FILEIN_PAGE_SIZE = 0u;
+		__offset FILEIN_MAP_OFFSET = 0;
+		size_t filein_map_released = 0u;
+
+		/*
+		 * FILEIN_STREAM and FILEIN_STREAM_FD are set by setPlaybackParameters(). filein_open() takes FILEIN_STREAM_FD over (it's set to -1 then).
+		 * Stream input is read with plain read() calls, in order. prefetch_read() hands over whatever has arrived, so a slow producer
+		 * (a live source) doesn't hold back a whole chunk. The audio data ends when the stream is closed (or at AUDIO_DATA_END).
+		 * If the stream is stdin, the user command thread doesn't read it.
+		 */
+
+		bool FILEIN_STREAM = false;
+		int FILEIN_STREAM_FD = -1;
+		bool FILEIN_STREAM_STDIN = false;
+
+		/*
+		 * h_prefetch_stop_event is an eventfd (stream input only). prefetch_read() waits on it together with the stream,
+		 * so an idle writer can't hold up the end of playback. It's signaled by prefetch_interrupt().
+		 */
+
+		int h_prefetch_stop_event = -1;
+
+		/*
+		 * MMAP_ACCESS_REQUESTED is set by setPlaybackParameters().
+		 * MMAP_ACCESS is set by audio_hw_init(), it's only true if the device accepted mmap access.
+		 *
+		 * In mmap access mode the play thread is not used. The load thread waits for room in the device buffer, then loads and processes
+		 * each segment directly into it. The device buffer is the render-ahead ring, the output buffer is then
+		 * a single scratch segment (BUFFEROUT_N_SEGMENTS is set to 1 by audio_hw_init()).
+		 */
+
+		bool MMAP_ACCESS_REQUESTED = false;
+		bool MMAP_ACCESS = false;
+
+		/*
+		 * AUDIODEV_FORMAT is the sample format negotiated with the audio device. Set by audio_hw_init().
+		 */
+
+		snd_pcm_format_t AUDIODEV_FORMAT = SND_PCM_FORMAT_UNKNOWN;
+
 		std::string AUDIODEV_DESC = "";
 		std::string FILEIN_DIR = "";
+		std::string TAPS_FILE = "";
 
 		size_t N_CHANNELS = 0u;
 		size_t SAMPLE_RATE = 0u;
@@ -159,71 +481,412 @@ class AudioRTDSP {
 		std::thread playthread;
 		std::thread userthread;
 
+		/*
+		 * h_userthread_event is an eventfd. The user thread sleeps on it (and on stdin), until it's signaled at the end of playback.
+		 */
+
+		int h_userthread_event = -1;
+
 		int status = this->STATUS_UNINITIALIZED;
 
+		audiortdsp_rt_params_t rt_params = {
+			.enable = false,
+			.sched_policy = SCHED_FIFO,
+			.playthread_priority = 80,
+			.loadthread_priority = 70,
+			.playthread_cpu = -1,
+			.loadthread_cpu = -1,
+			.lock_memory = true
+		};
+
+		bool rt_memory_locked = false;
+		int loadthread_prev_policy = SCHED_OTHER;
+		struct sched_param loadthread_prev_schedparam = {0};
+		cpu_set_t loadthread_prev_cpuset;
+
+		/*
+		 * fx_params belongs to the user thread (command UI), the load (DSP) thread never reads it.
+		 * Changes are published through a lock-free triple buffer (fx_params_publish()), the load thread picks up
+		 * the latest published snapshot at the beginning of each segment (fx_params_fetch(), called by taptable_update()).
+		 *
+		 * fx_params_slots: snapshot slots. The user thread owns slot fx_params_nslot_back, the load thread owns slot fx_params_nslot_front.
+		 * fx_params_nslot_mid is the slot in between, the only index shared by both threads. It's swapped atomically by either side.
+		 * FX_PARAMS_SLOT_NEW is set in fx_params_nslot_mid when the middle slot holds a snapshot the load thread hasn't picked up yet.
+		 */
+
 		audiortdsp_fx_params_t fx_params = {
 			.n_delay = 240,
 			.n_feedback = 20,
 			.feedback_altpol = true,
-			.cyclediv_incone = true
+			.cyclediv_incone = true,
+			.feedback_iir = false,
+			.feedback_gain = 50,
+			.custom_taps = false,
+			.n_custom_taps = 0u,
+			.custom_tap_list = {}
 		};
 
-		bool stop_playback = false;
+		static constexpr uint32_t FX_PARAMS_SLOT_NEW = 0x4u;
+
+		audiortdsp_fx_params_t fx_params_slots[3];
+		uint32_t fx_params_nslot_back = 0u;
+		uint32_t fx_params_nslot_front = 2u;
+		alignas(64) std::atomic<uint32_t> fx_params_nslot_mid{1u};
+
+		/*
+		 * Tap table. Rebuilt by taptable_update() at the beginning of a segment, whenever the published fx_params snapshot differs from taptable_fx_params.
+		 * TAPTABLE_SIZE is the maximum number of taps: n_feedback + 1 preset taps, or the custom tap list (at most AUDIORTDSP_CUSTOMTAPS_MAX taps).
+		 * It's BUFFERIN_SIZE_FRAMES: at one tap per frame of input history, no tap delay can reach further back than the input buffer.
+		 * TAPTABLE_MAGIC_BITS is the magnitude range (in bits) the bit-exact division is valid for (covers 16bit and 24bit samples).
+		 */
+
+		static constexpr size_t TAPTABLE_SIZE = BUFFERIN_SIZE_FRAMES;
+		static constexpr uint32_t TAPTABLE_MAGIC_BITS = 24u;
+
+		bool DSP_BITEXACT = false;
+		bool DITHER = false;
+
+		/*
+		 * DSP kernels. p_dspkernel is selected by initialize().
+		 * In bit-exact mode only the load/store kernels are used, taps are processed by a scalar loop.
+		 */
+
+		int DSPKERNEL_LEVEL = DSPKERNEL_AUTO;
+		const dspkernel_t *p_dspkernel = NULL;
+
+		/*
+		 * 24bit sample conversion routines (see pcm24.h). Selected by initialize(), scalar if the scalar DSP kernel was requested.
+		 */
+
+		const pcm24_t *p_pcm24 = NULL;
+
+		audiortdsp_tap_t *p_taptable = NULL;
+		size_t taptable_n_taps = 0u;
+		size_t taptable_n_routed = 0u; /*Taps with a channel routing (the FFT engine can't do them)*/
+		bool taptable_valid = false;
+		audiortdsp_fx_params_t taptable_fx_params;
+		uint64_t taptable_serial = 0u; /*Incremented on every tap table rebuild*/
+
+		/*
+		 * FFT engine. DSPENGINE_MODE is set by setPlaybackParameters().
+		 * FFTCONV_READY is set by fftconv_init(), it's only true if fftconv could be set up (never in bit-exact mode, or if the direct form was forced).
+		 *
+		 * fftconv block size is the period size, so it adds no latency. The impulse response covers the whole input buffer (BUFFERIN_SIZE_FRAMES frames).
+		 * p_fftconv_ir: impulse response built from the tap table. p_fftconv_in/p_fftconv_out: one segment of input/wet output, in double.
+		 *
+		 * fftconv_active: the load thread is using the FFT engine. fftconv_serial: tap table serial the engine was last chosen for.
+		 * fftconv_history_frames: how much input history fftconv holds since it was last primed (impulse responses up to that long are valid).
+		 * dspengine_curr: engine in use (DspEngine), for the command UI.
+		 */
+
+		int DSPENGINE_MODE = DSPENGINE_AUTO;
+		bool FFTCONV_READY = false;
+
+		FFTConvolver fftconv;
+
+		double *p_fftconv_ir = NULL;
+		double *p_fftconv_in = NULL;
+		double *p_fftconv_out = NULL;
+
+		bool fftconv_active = false;
+		uint64_t fftconv_serial = 0u;
+		size_t fftconv_history_frames = 0u;
+
+		std::atomic<int> dspengine_curr{DSPENGINE_DIRECT};
+
+		/*
+		 * Recursive comb engine (exponential divider mode).
+		 *
+		 * With a = pol/2 (pol = -1 if feedback polarity alternates, else 1), D = n_delay and K taps, the taps add up to
+		 * w[n] = sum(k = 1...K) a^k*x[n - k*D], which is also w[n] = a*(x[n - D] + w[n - D]) - a^(K + 1)*x[n - (K + 1)*D]
+		 * (one comb step, minus the term that falls off the end of the series). Cost per sample doesn't depend on K.
+		 *
+		 * p_comb_state is a ring of D frames, holding w[n - D] for the next D frames. It's updated in place, in chunks of up to D frames
+		 * (no sample of a chunk depends on another one of the same chunk). x[n - (K + 1)*D] must be in the input buffer, so the comb is only used
+		 * if (K + 1)*D <= BUFFERIN_SIZE_FRAMES - AUDIOBUFFER_SEGMENT_SIZE_FRAMES.
+		 * When the comb is engaged (or the tap table changes) the state is primed from the input buffer, with the direct form (once, in double).
+		 *
+		 * Integer pipelines: the state is fixed point (int32, COMB_FRAC_BITS fraction bits, set by each pipeline so that samples and state fit in 31 bits).
+		 * Error against the exact tap sum (in accumulator LSBs): the halving floors (less than 2^-F per step) and the rounding of the last term
+		 * (2^-(F + 1) per step) decay by half every D frames, so the state is within 3*2^-F of the exact value. The result is rounded once: error <= 1/2 + 3*2^-F.
+		 * The direct form rounds every tap: error <= K/2. So comb and direct form outputs differ by at most (K + 1)/2 + 3*2^-F accumulator LSBs
+		 * (about K/4 output LSBs, K <= 15 for 16bit and K <= 23 for 24bit samples), and the comb is the more accurate one.
+		 * Float pipeline: the state is float. Each step adds up to 3 float roundings, decaying the same way: error within about 12*2^-24 of full scale,
+		 * not growing with K (the direct form rounds once per tap).
+		 *
+		 * comb_delay: D. comb_delay_old: (K + 1)*D. comb_pol, comb_pol_old: pol and pol^(K + 1). comb_shift_old: K + 1.
+		 * comb_gain, comb_gain_old: a and a^(K + 1) (float pipeline). comb_pos: ring position of the next frame.
+		 */
+
+		bool COMB_READY = false;
+
+		void *p_comb_state = NULL; /*BUFFERIN_SIZE_SAMPLES int32_t or float*/
+		double *p_comb_prime = NULL; /*Priming scratch: 2 segments*/
+
+		bool comb_active = false;
+		size_t comb_delay = 0u;
+		size_t comb_delay_old = 0u;
+		int32_t comb_pol = 1;
+		int32_t comb_pol_old = 1;
+		uint32_t comb_shift_old = 0u;
+		float comb_gain = 0.0f;
+		float comb_gain_old = 0.0f;
+		size_t comb_pos = 0u;
+
+		/*
+		 * Feedback delay mode: v[n] = x[n] + g*v[n - D], wet output g*v[n - D] (g = feedback gain with polarity, D = n_delay).
+		 *
+		 * p_fbdelay is a ring of D frames (float, sample scale of the pipeline), slot fbdelay_pos holds v[n - D] and gets v[n]: one read and one write per sample.
+		 * It doesn't depend on the input buffer, so the delay time is only limited by FBDELAY_SIZE_FRAMES, and the number of echoes is unlimited.
+		 * The ring is allocated with the tap table. It's primed from the input buffer (fbdelay_prime()) when the mode is engaged or the delay time changes,
+		 * so v is what the loop would hold if it had been running all along (as far back as the input buffer goes). A feedback gain change keeps the ring:
+		 * echoes already in the loop fade out with the new gain.
+		 *
+		 * |g| <= FBDELAY_GAIN_MAX percent: |v| stays under 1/(1 - |g|) of full scale. Integer pipelines round the wet output once per sample.
+		 * The ring is float (24bit mantissa): every trip around the loop adds up to 2 roundings of 2^-24*|v|, which decay with the loop gain,
+		 * so the error stays under 2^-23*max(|v|)/(1 - |g|). For 16bit samples that is a small fraction of an LSB unless |g| gets close to 1.
+		 */
+
+		static constexpr size_t FBDELAY_SIZE_FRAMES = BUFFERIN_SIZE_FRAMES;
+		static constexpr int32_t FBDELAY_GAIN_MAX = 99;
+
+		float *p_fbdelay = NULL;
+		double *p_fbdelay_prime = NULL; /*Priming scratch: 1 segment*/
+
+		bool fbdelay_active = false;
+		size_t fbdelay_delay = 0u;
+		size_t fbdelay_pos = 0u;
+		float fbdelay_gain = 0.0f;
+
+		/*stop_playback is set by any thread (load thread at end of file, user thread on "stop") and read by all of them*/
+
+		std::atomic<bool> stop_playback{false};
+
+		/*
+		 * Play thread timing statistics.
+		 * Every time the play thread wakes up from snd_pcm_wait(), the time elapsed since the previous wake up is compared
+		 * with the nominal period time (AUDIOBUFFER_SEGMENT_SIZE_FRAMES/SAMPLE_RATE). The difference is the period jitter.
+		 * The first periods (while the device buffer is being filled) are not taken into account.
+		 * timing_renderahead_min is the lowest number of rendered segments found waiting in the output ring (0 means the play thread had to wait for the load thread).
+		 */
+
+		struct timespec playthread_prev_wake = {0, 0};
+		int64_t PERIOD_TIME_NS = 0;
+		size_t timing_n_skip = 0u;
+
+		std::atomic<uint64_t> timing_n_periods{0u};
+		std::atomic<int64_t> timing_jitter_max_ns{0};
+		std::atomic<int64_t> timing_jitter_sum_ns{0};
+		std::atomic<size_t> timing_renderahead_min{0u};
+
+		/*
+		 * Prefetch statistics.
+		 * Every chunk read is timed (refill time). prefetch_ready_min is the lowest number of decoded segments found waiting in the prefetch ring
+		 * by buffer_load(), prefetch_n_starved is how many times it found none (the load thread had to wait for the file).
+		 * The initial ring fill is not taken into account (prefetch_primed is set once the first chunk is decoded).
+		 */
+
+		std::atomic<bool> prefetch_primed{false};
+		std::atomic<bool> prefetch_read_error{false};
+
+		std::atomic<uint64_t> prefetch_n_reads{0u};
+		std::atomic<uint64_t> prefetch_n_bytes{0u};
+		std::atomic<int64_t> prefetch_refill_max_ns{0};
+		std::atomic<int64_t> prefetch_refill_sum_ns{0};
+		std::atomic<size_t> prefetch_ready_min{0u};
+		std::atomic<uint64_t> prefetch_n_starved{0u};
 
 		void wait_all_threads(void);
 		void stop_all_threads(void);
 
 		bool filein_open(void);
 		void filein_close(void);
+		bool filein_map(void);
+		void filein_unmap(void);
 
 		virtual bool audio_hw_init(void) = 0;
 		void audio_hw_deinit(void);
 
+		bool userthread_event_init(void);
+		void userthread_event_deinit(void);
+		void userthread_event_signal(void);
+
 		virtual bool buffer_alloc(void) = 0;
 		virtual void buffer_free(void) = 0;
+		virtual void buffer_prefault(void) = 0; /*rt_memory_prefault() on the buffers allocated by buffer_alloc()*/
+
+		/*
+		 * rt_memory_lock: locks all current and future process memory, and stops malloc from giving memory back to the system.
+		 * rt_memory_unlock: undo rt_memory_lock.
+		 * rt_memory_prefault: writes one byte per memory page, so the pages are mapped before the real time threads touch them.
+		 * rt_thread_setup: sets scheduling policy/priority and CPU affinity for a thread. Prints what was granted.
+		 * rt_loadthread_restore: sets the load thread (main thread) back to its original scheduling policy and CPU affinity.
+		 */
+
+		bool rt_memory_lock(void);
+		void rt_memory_unlock(void);
+		void rt_memory_prefault(void *p_mem, size_t size);
+		bool rt_thread_setup(pthread_t thread, int priority, int cpu, const char *thread_name);
+		void rt_loadthread_restore(void);
 
 		void playback_proc(void);
 		void playback_init(void);
 		void playback_loop(void);
+		void playback_loop_mmap(void);
+
+		bool bufferin_alloc(void);
+		void bufferin_free(void);
+		void bufferin_mirror_update(void);
+
+		void fx_params_reset(void);
+		void fx_params_publish(void);
+		const audiortdsp_fx_params_t *fx_params_fetch(void);
+
+		bool taptable_alloc(void);
+		void taptable_free(void);
+		void fbdelay_prime(void);
+
+		/*
+		 * taptable_update: rebuilds the tap table if fx_params changed since the last build.
+		 * gain_q_bits: fixed point format of the fast mode gain (15 = Q15, 31 = Q31).
+		 * sample_bits: input sample size in bits. Fast mode taps that would always output 0 (or -1) are dropped.
+		 */
+
+		void taptable_update(uint32_t gain_q_bits, uint32_t sample_bits);
+
+		/*
+		 * taptable_gen_preset: writes the taps of the preset (n_delay, n_feedback, feedback_altpol, cyclediv_incone) to the tap table. Returns the number of taps.
+		 * taptable_gen_custom: compiles the custom tap list into the tap table. Returns the number of taps.
+		 */
+
+		size_t taptable_gen_preset(const audiortdsp_fx_params_t *p_fx_params, uint32_t gain_q_bits, uint32_t sample_bits);
+		size_t taptable_gen_custom(const audiortdsp_fx_params_t *p_fx_params, uint32_t gain_q_bits);
+
+		/*
+		 * Custom tap list (user side, fx_params).
+		 * customtap_parse: reads a tap from text: "<delay> <gain>" or "<delay> <gain> <source channel> <destination channel>" (channels from 1),
+		 * separated by spaces or commas. Returns NULL if it's a valid tap, else a short description of what's wrong.
+		 * customtap_insert: inserts a tap into fx_params.custom_tap_list, in delay time order. Returns false if the list is full.
+		 * customtaps_load: reads a tap file, one tap per line as for customtap_parse(). Empty lines and anything after '#' are ignored.
+		 * customtaps_preset: replaces the custom tap list with the taps of the current preset.
+		 */
+
+		const char *customtap_parse(const char *text, audiortdsp_custom_tap_t *p_tap);
+		bool customtap_insert(const audiortdsp_custom_tap_t *p_tap);
+		bool customtaps_load(const char *file_dir);
+		void customtaps_preset(void);
+
+		bool fftconv_init(void);
+		void fftconv_deinit(void);
+		bool comb_init(void);
+		void comb_deinit(void);
+
+		/*
+		 * dspengine_update: picks the delay tap engine for the current tap table (call after taptable_update()). Only does something if the tap table was rebuilt.
+		 * If the FFT engine is picked, the impulse response is rebuilt from the tap table. If it wasn't in use already, its input history is primed from the input buffer.
+		 * If the recursive comb is picked, its state is primed from the input buffer (comb_prime()).
+		 * In feedback delay mode the feedback delay line is engaged instead (fbdelay_active), and primed if needed (fbdelay_prime()).
+		 * float_gains: if true, the impulse response uses the float gains (gain_f), else the fixed point gains (gain >> shift). The comb state is float as well.
+		 * comb_frac_bits: comb state fraction bits (integer pipelines).
+		 *
+		 * fftconv_proc: processes the current input segment with the FFT engine. The wet signal (delay taps only, no dry signal) is left in p_fftconv_out.
+		 * bufferin_load_f64: converts n_samples input buffer samples (internal sample format) to double.
+		 */
+
+		void dspengine_update(bool float_gains, uint32_t comb_frac_bits);
+		void comb_prime(bool float_gains, uint32_t comb_frac_bits);
+		void fftconv_proc(const void *p_currin_seg);
+		virtual void bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples) = 0;
+
+		bool buffer_render(void);
+		void buffer_prerender(void);
+
+		bool segqueue_init(void);
+		void segqueue_deinit(void);
+
+		bool prefetch_alloc(void);
+		void prefetch_free(void);
+		void prefetch_start(void);
+		void prefetch_stop(void);
+		void prefetch_interrupt(void); /*Wakes up the prefetch thread if it's waiting for stream input. The stream is then handled as ended.*/
+		void prefetch_stats_reset(void);
+
+		/*
+		 * prefetch_read: reads up to n_bytes from the input file at filein_pos. Retries interrupted and short reads.
+		 * Returns the number of bytes read (less than n_bytes only at the end of the file), or -1 on error.
+		 * Stream input: returns as soon as some data has arrived (0 at the end of the stream, or once prefetch_interrupt() is called).
+		 */
+
+		ssize_t prefetch_read(uint8_t *p_dst, size_t n_bytes);
+
+		/*
+		 * Mapped access counterparts of prefetch_read():
+		 * prefetch_map: makes up to n_bytes more of the mapping available at filein_pos (read ahead, then fault the pages in), waiting for the file to grow if needed.
+		 * Returns the number of bytes made available (0 at the end of the file), or -1 on error.
+		 * prefetch_map_release: drops the mapped pages below file offset pos.
+		 */
+
+		ssize_t prefetch_map(size_t n_bytes);
+		void prefetch_map_release(__offset pos);
+
+		/*
+		 * io_uring access counterparts of prefetch_read():
+		 * prefetch_uring_init/prefetch_uring_deinit: set up/tear down the io_uring reader and its chunk buffers.
+		 * prefetch_uring_start: submits the first PREFETCH_URING_DEPTH chunk reads. prefetch_uring_drain: waits for the reads still in flight.
+		 * prefetch_uring_read: returns the next chunk (*pp_data) and its size, like prefetch_read(). Short reads are completed with pread().
+		 */
+
+		bool prefetch_uring_init(void);
+		void prefetch_uring_deinit(void);
+		bool prefetch_uring_start(void);
+		void prefetch_uring_drain(void);
+		bool prefetch_uring_submit(size_t n_buf);
+		ssize_t prefetch_uring_read(const uint8_t **pp_data);
+
+		/*
+		 * prefetch_decode: converts n_bytes of audio data (file sample format, whole samples, up to FILEIN_SEGMENT_SIZE_BYTES) into one input segment.
+		 * The rest of the segment is zero filled.
+		 */
+
+		virtual void prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes) = 0;
 
 		void buffer_segment_update(void);
 		void buffer_play(void);
+		bool buffer_render_mmap(void);
+		bool audio_hw_recover(int error_code);
 
-		virtual void buffer_load(void) = 0;
-		virtual void dsp_proc(void) = 0;
+		void playthread_timing_reset(void);
+		void playthread_timing_update(void);
+
+		void buffer_load(void);
 
 		/*
-		 * retrieve_previn_nframe: this method is used to calculate the previous frame index from the current frame index and the delay time in number of frames
-		 *
-		 * Inputs:
-		 * curr_buf_nframe: current frame index (within the whole input buffer)
-		 * n_delay: delay time in number of frames
-		 *
-		 * alternative inputs:
-		 * curr_nseg: current index for input buffer segment in context.
-		 * curr_seg_nframe: current frame index (within the specified input buffer segment).
-		 *
-		 * Outputs:
-		 * p_prev_buf_nframe: pointer that receives the delayed frame index (within the whole input buffer). Set to NULL if unused.
-		 * p_prev_nseg: pointer that receives the delayed input buffer segment index. Set to NULL if unused. Set to NULL if unused.
-		 * p_prev_seg_nframe: pointer that receives the delayed frame index (within the delayed input buffer segment). Set to NULL if unused.
-		 *
-		 * returns true if successful, false otherwise.
+		 * dsp_proc: processes the current input segment into p_bufferout_load.
+		 * Taps are processed one at a time, each over the whole segment (tap outer loop, frame inner loop).
+		 * Thanks to the mirrored input buffer, the delayed frames of a tap are always one contiguous range, starting at
+		 * (current segment in the upper half) - n_delay. All input buffer reads are sequential, with no index wraparound math.
+		 * If the FFT engine is in use (fftconv_active), the taps are replaced by one fftconv_proc() call.
+		 * If the recursive comb is in use (comb_active), they're replaced by one comb kernel step per sample.
+		 * In feedback delay mode (fbdelay_active) there are no taps, the feedback delay kernel does the job.
+		 * Routed taps (custom taps from one channel into another) only touch their two channels, with dsp_tap_routed().
 		 */
 
-		bool retrieve_previn_nframe(size_t curr_buf_nframe, size_t n_delay, size_t *p_prev_buf_nframe, size_t *p_prev_nseg, size_t *p_prev_seg_nframe);
-		bool retrieve_previn_nframe(size_t curr_nseg, size_t curr_seg_nframe, size_t n_delay, size_t *p_prev_buf_nframe, size_t *p_prev_nseg, size_t *p_prev_seg_nframe);
+		virtual void dsp_proc(void) = 0;
 
 		void cmdui_cmd_decode(void);
 		bool cmdui_cmd_compare(const char *auth, const char *input, size_t stop_index);
 
 		void cmdui_print_help_text(void);
 		void cmdui_print_current_params(void);
+		void cmdui_print_timing_stats(void);
+		void cmdui_print_prefetch_stats(void);
 		bool cmdui_attempt_updatevar(const char *numtext, int updatevar_desc);
+		void cmdui_print_custom_taps(void);
 
-		void loadthread_proc(void); /*loadthread_proc will be run by main thread*/
-		void playthread_proc(void); /*playthread_proc will be run by playthread*/
+		void loadthread_proc(void); /*loadthread_proc will be run by main thread, for the whole playback*/
+		void playthread_proc(void); /*playthread_proc will be run by playthread, for the whole playback*/
 		void userthread_proc(void); /*userthread_proc will be run by userthread*/
+		void prefetchthread_proc(void); /*prefetchthread_proc will be run by prefetchthread, for the whole playback*/
 };
 
 #endif /*AUDIORTDSP_HPP*/
@@ -0,0 +1,533 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#include "AudioRTDSP_f32.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+AudioRTDSP_f32::AudioRTDSP_f32(const audiortdsp_pb_params_t *p_pbparams, bool filein_float) : AudioRTDSP(p_pbparams)
+{
+	this->FILEIN_FLOAT = filein_float;
+}
+
+AudioRTDSP_f32::~AudioRTDSP_f32(void)
+{
+	this->stop_playback = true;
+	this->userthread_event_signal();
+	this->stop_all_threads();
+
+	this->status = this->STATUS_UNINITIALIZED;
+
+	this->filein_close();
+	this->audio_hw_deinit();
+	this->buffer_free();
+	this->taptable_free();
+	this->fftconv_deinit();
+	this->comb_deinit();
+	this->prefetch_free();
+	this->userthread_event_deinit();
+	this->rt_memory_unlock();
+}
+
+bool AudioRTDSP_f32::audio_hw_init(void)
+{
+	snd_pcm_hw_params_t *p_hwparams = NULL;
+	snd_pcm_uframes_t n_frames = 0u;
+	size_t n_format = 0u;
+	int n_ret = 0;
+
+	this->audio_hw_deinit(); /*Clear any previous instances of the audio device*/
+
+	/*OPEN AUDIO DEVICE*/
+
+	n_ret = snd_pcm_open(&(this->p_audiodev), this->AUDIODEV_DESC.c_str(), SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+	if(n_ret < 0)
+	{
+		this->p_audiodev = NULL;
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_open failed.";
+		return false;
+	}
+
+	/*ALLOCATE DEVICE PARAMS OBJ*/
+
+	n_ret = snd_pcm_hw_params_malloc(&p_hwparams);
+	if((n_ret < 0) || (p_hwparams == NULL))
+	{
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_malloc failed.";
+		return false;
+	}
+
+	/*PRELOAD DEVICE PARAMS*/
+
+	n_ret = snd_pcm_hw_params_any(this->p_audiodev, p_hwparams);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_any failed.";
+		return false;
+	}
+
+	/*ENABLE/DISABLE RESAMPLING*/
+	/*
+	 * Disabled (0) = better performance
+	 * Enabled (1) = better compatibility
+	 */
+
+	n_ret = snd_pcm_hw_params_set_rate_resample(this->p_audiodev, p_hwparams, 1u);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_rate_resample failed.";
+		return false;
+	}
+
+	/*SET DEVICE ACCESS*/
+	/*
+	 * If mmap access was requested but the device doesn't support it, fall back to RW access.
+	 */
+
+	this->MMAP_ACCESS = false;
+
+	if(this->MMAP_ACCESS_REQUESTED)
+	{
+		n_ret = snd_pcm_hw_params_set_access(this->p_audiodev, p_hwparams, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if(n_ret >= 0) this->MMAP_ACCESS = true;
+	}
+
+	if(!this->MMAP_ACCESS) n_ret = snd_pcm_hw_params_set_access(this->p_audiodev, p_hwparams, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_access failed.";
+		return false;
+	}
+
+	/*SET DEVICE FORMAT*/
+
+	/*
+	 * Highest resolution first: S32_LE, then S24_3LE (packed), S24_LE and S16_LE.
+	 * Taking one the device supports natively avoids a format conversion inside alsa-lib (plug layer).
+	 */
+
+	for(n_format = 0u; n_format < N_DEVICE_FORMATS; n_format++)
+	{
+		if(snd_pcm_hw_params_test_format(this->p_audiodev, p_hwparams, DEVICE_FORMATS[n_format]) < 0) continue;
+
+		n_ret = snd_pcm_hw_params_set_format(this->p_audiodev, p_hwparams, DEVICE_FORMATS[n_format]);
+		if(n_ret >= 0) break;
+	}
+
+	if(n_format >= N_DEVICE_FORMATS)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_format failed.";
+		return false;
+	}
+
+	this->AUDIODEV_FORMAT = DEVICE_FORMATS[n_format];
+
+	switch(this->AUDIODEV_FORMAT)
+	{
+		case SND_PCM_FORMAT_S16_LE:
+			this->DEVICE_SAMPLE_SIZE_BYTES = 2u;
+			this->DEVICE_SAMPLE_BITS = 16u;
+			break;
+
+		case SND_PCM_FORMAT_S24_3LE:
+			this->DEVICE_SAMPLE_SIZE_BYTES = 3u;
+			this->DEVICE_SAMPLE_BITS = 24u;
+			break;
+
+		case SND_PCM_FORMAT_S24_LE:
+			this->DEVICE_SAMPLE_SIZE_BYTES = 4u;
+			this->DEVICE_SAMPLE_BITS = 24u;
+			break;
+
+		default:
+			this->DEVICE_SAMPLE_SIZE_BYTES = 4u;
+			this->DEVICE_SAMPLE_BITS = 32u;
+			break;
+	}
+
+	/*SET DEVICE CHANNELS*/
+
+	n_ret = snd_pcm_hw_params_set_channels(this->p_audiodev, p_hwparams, (unsigned int) this->N_CHANNELS);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_channels failed.";
+		return false;
+	}
+
+	/*SET DEVICE SAMPLING RATE*/
+
+	n_ret = snd_pcm_hw_params_set_rate(this->p_audiodev, p_hwparams, (unsigned int) this->SAMPLE_RATE, 0);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_rate failed.";
+		return false;
+	}
+
+	/*GET/SET DEVICE BUFFER SIZE*/
+
+	n_ret = snd_pcm_hw_params_get_buffer_size(p_hwparams, &n_frames);
+	if(n_ret < 0)
+	{
+		n_frames = (snd_pcm_uframes_t) _get_closest_power2_ceil(this->SAMPLE_RATE);
+		n_ret = snd_pcm_hw_params_set_buffer_size_near(this->p_audiodev, p_hwparams, &n_frames);
+
+		if(n_ret < 0)
+		{
+			snd_pcm_hw_params_free(p_hwparams);
+			this->audio_hw_deinit();
+			this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_buffer_size_near failed.";
+			return false;
+		}
+	}
+
+	this->AUDIOBUFFER_SIZE_FRAMES = (size_t) n_frames;
+	this->AUDIOBUFFER_SIZE_SAMPLES = (this->AUDIOBUFFER_SIZE_FRAMES)*(this->N_CHANNELS);
+	this->AUDIOBUFFER_SIZE_BYTES = this->AUDIOBUFFER_SIZE_SAMPLES*(this->DEVICE_SAMPLE_SIZE_BYTES);
+
+	/*SET DEVICE BUFFER SEGMENT SIZE (PERIOD SIZE)*/
+
+	this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES = _get_closest_power2_ceil(this->AUDIOBUFFER_SIZE_FRAMES/4u);
+
+	n_ret = snd_pcm_hw_params_set_period_size(this->p_audiodev, p_hwparams, (snd_pcm_uframes_t) this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES, 0);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params_set_period_size failed.";
+		return false;
+	}
+
+	/*APPLY SETTINGS TO DEVICE*/
+
+	n_ret = snd_pcm_hw_params(this->p_audiodev, p_hwparams);
+	if(n_ret < 0)
+	{
+		snd_pcm_hw_params_free(p_hwparams);
+		this->audio_hw_deinit();
+		this->err_msg = "AudioRTDSP_f32::audio_hw_init: Error: snd_pcm_hw_params failed.";
+		return false;
+	}
+
+	n_ret = snd_pcm_hw_params_get_period_size(p_hwparams, &n_frames, NULL);
+
+	if(n_ret >= 0) this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES = (size_t) n_frames; /*Not really necessary, but just to be safe.*/
+
+	this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES = (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES)*(this->N_CHANNELS);
+	this->AUDIOBUFFER_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*4u;
+	this->BUFFEROUT_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*(this->DEVICE_SAMPLE_SIZE_BYTES);
+
+	/*mmap access renders into the device buffer: only the scratch segment (used when the mapped area wraps) is needed*/
+	if(this->MMAP_ACCESS) this->BUFFEROUT_N_SEGMENTS = 1u;
+
+	this->BUFFEROUT_SIZE_FRAMES = (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES)*(this->BUFFEROUT_N_SEGMENTS);
+	this->BUFFEROUT_SIZE_SAMPLES = (this->BUFFEROUT_SIZE_FRAMES)*(this->N_CHANNELS);
+	this->BUFFEROUT_SIZE_BYTES = this->BUFFEROUT_SIZE_SAMPLES*(this->DEVICE_SAMPLE_SIZE_BYTES);
+
+	this->BUFFERIN_SIZE_SAMPLES = (this->BUFFERIN_SIZE_FRAMES)*(this->N_CHANNELS);
+	this->BUFFERIN_SIZE_BYTES = this->BUFFERIN_SIZE_SAMPLES*4u;
+	this->BUFFERIN_N_SEGMENTS = (this->BUFFERIN_SIZE_FRAMES)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
+
+	this->FILEIN_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*4u;
+
+	this->DSPSEG_SIZE_BYTES = (this->DSPSEG_SAMPLE_SIZE_BYTES)*(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	this->DSPSEG_SIZE_BYTES = ((this->DSPSEG_SIZE_BYTES + 63u)/64u)*64u; /*aligned_alloc() size must be a multiple of the alignment*/
+
+	snd_pcm_hw_params_free(p_hwparams);
+	return true;
+}
+
+bool AudioRTDSP_f32::buffer_alloc(void)
+{
+	size_t n_seg = 0u;
+
+	this->buffer_free(); /*Clear any previous allocations*/
+
+	this->p_bufferoutput = malloc(this->BUFFEROUT_SIZE_BYTES);
+
+	this->pp_bufferinput_segments = (void**) malloc(this->BUFFERIN_N_SEGMENTS*sizeof(void*));
+	this->pp_bufferoutput_segments = (void**) malloc(this->BUFFEROUT_N_SEGMENTS*sizeof(void*));
+
+	this->p_dspseg = (float*) aligned_alloc(64u, this->DSPSEG_SIZE_BYTES);
+	this->p_outseg = (int32_t*) aligned_alloc(64u, this->DSPSEG_SIZE_BYTES);
+
+	if(!this->bufferin_alloc())
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	if(this->p_bufferoutput == NULL)
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	if(this->pp_bufferinput_segments == NULL)
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	if(this->pp_bufferoutput_segments == NULL)
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	if(this->p_dspseg == NULL)
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	if(this->p_outseg == NULL)
+	{
+		this->buffer_free();
+		return false;
+	}
+
+	memset(this->p_bufferinput, 0, this->BUFFERIN_SIZE_BYTES); /*Also clears the upper (mirror) half*/
+	memset(this->p_bufferoutput, 0, this->BUFFEROUT_SIZE_BYTES);
+	memset(this->p_dspseg, 0, this->DSPSEG_SIZE_BYTES);
+	memset(this->p_outseg, 0, this->DSPSEG_SIZE_BYTES);
+
+	for(n_seg = 0u; n_seg < this->BUFFERIN_N_SEGMENTS; n_seg++) this->pp_bufferinput_segments[n_seg] = (void*) (((size_t) this->p_bufferinput) + n_seg*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
+	for(n_seg = 0u; n_seg < this->BUFFEROUT_N_SEGMENTS; n_seg++) this->pp_bufferoutput_segments[n_seg] = (void*) (((size_t) this->p_bufferoutput) + n_seg*(this->BUFFEROUT_SEGMENT_SIZE_BYTES));
+
+	return true;
+}
+
+void AudioRTDSP_f32::buffer_free(void)
+{
+	this->bufferin_free();
+
+	if(this->p_bufferoutput != NULL)
+	{
+		free(this->p_bufferoutput);
+		this->p_bufferoutput = NULL;
+	}
+
+	if(this->pp_bufferinput_segments != NULL)
+	{
+		free(this->pp_bufferinput_segments);
+		this->pp_bufferinput_segments = NULL;
+	}
+
+	if(this->pp_bufferoutput_segments != NULL)
+	{
+		free(this->pp_bufferoutput_segments);
+		this->pp_bufferoutput_segments = NULL;
+	}
+
+	if(this->p_dspseg != NULL)
+	{
+		free(this->p_dspseg);
+		this->p_dspseg = NULL;
+	}
+
+	if(this->p_outseg != NULL)
+	{
+		free(this->p_outseg);
+		this->p_outseg = NULL;
+	}
+
+	return;
+}
+
+void AudioRTDSP_f32::buffer_prefault(void)
+{
+	this->rt_memory_prefault(this->pp_bufferinput_segments, this->BUFFERIN_N_SEGMENTS*sizeof(void*));
+	this->rt_memory_prefault(this->pp_bufferoutput_segments, this->BUFFEROUT_N_SEGMENTS*sizeof(void*));
+	this->rt_memory_prefault(this->p_dspseg, this->DSPSEG_SIZE_BYTES);
+	this->rt_memory_prefault(this->p_outseg, this->DSPSEG_SIZE_BYTES);
+	return;
+}
+
+void AudioRTDSP_f32::prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes)
+{
+	size_t n_samples = 0u;
+	size_t n_sample = 0u;
+
+	float *p_seg = NULL;
+	int32_t *p_seg_i32 = NULL;
+
+	p_seg = (float*) p_dst;
+	p_seg_i32 = (int32_t*) p_dst;
+	n_samples = n_bytes/4u; /*Whole samples only*/
+
+	/*The source might not be aligned: copy first, then convert in place (32bit integer: full scale 2^31 becomes 1.0)*/
+
+	memcpy(p_dst, p_src, n_samples*4u);
+
+	if(!this->FILEIN_FLOAT)
+		for(n_sample = 0u; n_sample < n_samples; n_sample++) p_seg[n_sample] = ((float) p_seg_i32[n_sample])*(1.0f/2147483648.0f);
+
+	if(n_samples < this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES) memset(&p_seg[n_samples], 0, (this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES - n_samples)*4u);
+
+	return;
+}
+
+void AudioRTDSP_f32::dsp_proc(void)
+{
+	float *p_currin_seg = NULL;
+	float *p_bufferin = NULL;
+
+	const dspkernel_t *p_kernel = NULL;
+	const audiortdsp_tap_t *p_tap = NULL;
+
+	float *p_currin_mirror = NULL;
+	float *p_previn = NULL;
+	int16_t *p_loadout_i16 = NULL;
+	uint32_t *p_dither = NULL;
+
+	float *p_comb_state = NULL;
+	const float *p_comb_src = NULL;
+
+	size_t n_tap = 0u;
+	size_t n_sample = 0u;
+	size_t n_frame = 0u;
+	size_t n_frames = 0u;
+
+	this->taptable_update(31u, 24u); /*Only gain_f is used. Taps stop where float (24bit mantissa) can't resolve them anymore.*/
+	this->dspengine_update(true, 0u);
+
+	p_currin_seg = (float*) (this->pp_bufferinput_segments[this->bufferin_nseg_curr]);
+	p_bufferin = (float*) (this->p_bufferinput);
+
+	/*Current segment, in the upper half of the mirrored input buffer. Delayed frames are at (p_currin_mirror - n_delay).*/
+
+	p_currin_mirror = &p_bufferin[(this->bufferin_nseg_curr*(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) + this->BUFFERIN_SIZE_FRAMES)*(this->N_CHANNELS)];
+
+	p_kernel = this->p_dspkernel;
+
+	memcpy(this->p_dspseg, p_currin_seg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*sizeof(float));
+
+	if(this->fbdelay_active)
+	{
+		/*Feedback delay: one delay line read and write per sample. A chunk (up to fbdelay_delay frames) only depends on the chunks before it.*/
+
+		for(n_frame = 0u; n_frame < this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES; n_frame += n_frames)
+		{
+			n_frames = this->fbdelay_delay - this->fbdelay_pos;
+			if(n_frames > (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame)) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame;
+
+			p_kernel->fbdelay_f32(&(this->p_dspseg[n_frame*(this->N_CHANNELS)]), &(this->p_fbdelay[(this->fbdelay_pos)*(this->N_CHANNELS)]), &p_currin_seg[n_frame*(this->N_CHANNELS)], n_frames*(this->N_CHANNELS), this->fbdelay_gain);
+
+			this->fbdelay_pos += n_frames;
+			if(this->fbdelay_pos == this->fbdelay_delay) this->fbdelay_pos = 0u;
+		}
+	}
+	else if(this->comb_active)
+	{
+		/*Recursive comb: one step per sample, whatever the number of taps. A chunk (up to comb_delay frames) only depends on the chunks before it.*/
+
+		p_comb_state = (float*) this->p_comb_state;
+
+		for(n_frame = 0u; n_frame < this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES; n_frame += n_frames)
+		{
+			n_frames = this->comb_delay - this->comb_pos;
+			if(n_frames > (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame)) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame;
+
+			p_comb_src = &p_currin_mirror[n_frame*(this->N_CHANNELS)] - (this->comb_delay)*(this->N_CHANNELS);
+			p_kernel->comb_f32(&(this->p_dspseg[n_frame*(this->N_CHANNELS)]), &p_comb_state[(this->comb_pos)*(this->N_CHANNELS)], p_comb_src, p_comb_src - (this->comb_delay_old - this->comb_delay)*(this->N_CHANNELS), n_frames*(this->N_CHANNELS), this->comb_gain, this->comb_gain_old);
+
+			this->comb_pos += n_frames;
+			if(this->comb_pos == this->comb_delay) this->comb_pos = 0u;
+		}
+	}
+	else if(this->fftconv_active)
+	{
+		/*FFT engine: all taps at once*/
+
+		this->fftconv_proc(p_currin_seg);
+		for(n_sample = 0u; n_sample < this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES; n_sample++) this->p_dspseg[n_sample] += (float) this->p_fftconv_out[n_sample];
+	}
+	else for(n_tap = 0u; n_tap < this->taptable_n_taps; n_tap++)
+	{
+		p_tap = &(this->p_taptable[n_tap]);
+
+		p_previn = p_currin_mirror - (p_tap->n_delay)*(this->N_CHANNELS);
+
+		if(p_tap->src_channel >= 0) this->dsp_tap_routed(this->p_dspseg, p_previn, this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES, p_tap);
+		else p_kernel->tap_f32(this->p_dspseg, p_previn, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, p_tap->gain_f);
+	}
+
+	/*
+	 * Output stage: scale, dither (optional), round and clamp to the device format.
+	 * 32bit containers are written directly. Packed formats go through the int32 output segment first.
+	 */
+
+	if(this->DITHER) p_dither = this->dither_state;
+
+	switch(this->AUDIODEV_FORMAT)
+	{
+		case SND_PCM_FORMAT_S24_3LE:
+			p_kernel->store_f32(this->p_outseg, this->p_dspseg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, 24u, p_dither);
+			this->p_pcm24->pack_s24_3le((uint8_t*) this->p_bufferout_load, this->p_outseg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+			break;
+
+		case SND_PCM_FORMAT_S16_LE:
+			p_kernel->store_f32(this->p_outseg, this->p_dspseg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, 16u, p_dither);
+
+			p_loadout_i16 = (int16_t*) (this->p_bufferout_load);
+			for(n_sample = 0u; n_sample < this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES; n_sample++) p_loadout_i16[n_sample] = (int16_t) this->p_outseg[n_sample];
+			break;
+
+		default:
+			p_kernel->store_f32((int32_t*) this->p_bufferout_load, this->p_dspseg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, this->DEVICE_SAMPLE_BITS, p_dither);
+			break;
+	}
+
+	return;
+}
+
+void AudioRTDSP_f32::bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples)
+{
+	const float *p_src_f32 = NULL;
+	size_t n_sample = 0u;
+
+	p_src_f32 = (const float*) p_src;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_dst[n_sample] = (double) p_src_f32[n_sample];
+
+	return;
+}
+
+void AudioRTDSP_f32::dsp_tap_routed(float *p_acc, const float *p_src, size_t n_frames, const audiortdsp_tap_t *p_tap)
+{
+	size_t n_frame = 0u;
+	size_t src_channel = 0u;
+	size_t dst_channel = 0u;
+
+	float gain = 0.0f;
+
+	src_channel = (size_t) p_tap->src_channel;
+	dst_channel = (size_t) p_tap->dst_channel;
+	gain = p_tap->gain_f;
+
+	/*Same math as the tap kernel, on one channel of each frame*/
+
+	for(n_frame = 0u; n_frame < n_frames; n_frame++) p_acc[n_frame*(this->N_CHANNELS) + dst_channel] += p_src[n_frame*(this->N_CHANNELS) + src_channel]*gain;
+
+	return;
+}
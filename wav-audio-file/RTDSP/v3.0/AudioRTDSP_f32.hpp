@@ -0,0 +1,67 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef AUDIORTDSP_F32_HPP
+#define AUDIORTDSP_F32_HPP
+
+#include "AudioRTDSP.hpp"
+
+class AudioRTDSP_f32 : public AudioRTDSP {
+	public:
+		AudioRTDSP_f32(const audiortdsp_pb_params_t *p_pbparams, bool filein_float);
+		~AudioRTDSP_f32(void);
+
+	private:
+		/*
+		 * Float pipeline, for 32bit integer and 32bit float (IEEE 754) input files.
+		 * FILEIN_FLOAT: input file samples are float. Else they're 32bit integer, converted to float on decode (full scale = 1.0).
+		 *
+		 * Delay taps are accumulated in float, with no rounding at each tap. The result is rounded once, when converted to the device format.
+		 */
+
+		bool FILEIN_FLOAT = false;
+
+		/*
+		 * Device sample formats, in order of preference. DEVICE_SAMPLE_SIZE_BYTES and DEVICE_SAMPLE_BITS describe the format in use.
+		 */
+
+		static constexpr snd_pcm_format_t DEVICE_FORMATS[] = {SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S24_LE, SND_PCM_FORMAT_S16_LE};
+		static constexpr size_t N_DEVICE_FORMATS = 4u;
+
+		size_t DEVICE_SAMPLE_SIZE_BYTES = 4u;
+		uint32_t DEVICE_SAMPLE_BITS = 32u;
+
+		/*
+		 * dspseg is the accumulator buffer, it holds a whole segment of audio (AUDIOBUFFER_SEGMENT_SIZE_SAMPLES samples) in float.
+		 * outseg holds the segment converted to int32, for device formats that are not a 32bit container (S24_3LE, S16_LE).
+		 */
+
+		static constexpr size_t DSPSEG_SAMPLE_SIZE_BYTES = 4u;
+
+		size_t DSPSEG_SIZE_BYTES = 0u;
+
+		float *p_dspseg = NULL;
+		int32_t *p_outseg = NULL;
+
+		/*TPDF dither generator states (see dspkernel.hpp). Any non zero seeds will do.*/
+
+		uint32_t dither_state[DSPKERNEL_DITHER_LANES] = {0x9e3779b9u, 0x7f4a7c15u, 0x85ebca6bu, 0xc2b2ae35u, 0x27d4eb2fu, 0x165667b1u, 0xd3a2646cu, 0xfd7046c5u};
+
+		bool audio_hw_init(void) override;
+		bool buffer_alloc(void) override;
+		void buffer_free(void) override;
+		void buffer_prefault(void) override;
+		void prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes) override;
+		void dsp_proc(void) override;
+		void bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples) override;
+
+		void dsp_tap_routed(float *p_acc, const float *p_src, size_t n_frames, const audiortdsp_tap_t *p_tap);
+};
+
+#endif /*AUDIORTDSP_F32_HPP*/
+
@@ -10,6 +10,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 AudioRTDSP_i16::AudioRTDSP_i16(const audiortdsp_pb_params_t *p_pbparams) : AudioRTDSP(p_pbparams)
 {
@@ -18,6 +19,7 @@ AudioRTDSP_i16::AudioRTDSP_i16(const audiortdsp_pb_params_t *p_pbparams) : Audio
 AudioRTDSP_i16::~AudioRTDSP_i16(void)
 {
 	this->stop_playback = true;
+	this->userthread_event_signal();
 	this->stop_all_threads();
 
 	this->status = this->STATUS_UNINITIALIZED;
@@ -25,6 +27,12 @@ AudioRTDSP_i16::~AudioRTDSP_i16(void)
 	this->filein_close();
 	this->audio_hw_deinit();
 	this->buffer_free();
+	this->taptable_free();
+	this->fftconv_deinit();
+	this->comb_deinit();
+	this->prefetch_free();
+	this->userthread_event_deinit();
+	this->rt_memory_unlock();
 }
 
 bool AudioRTDSP_i16::audio_hw_init(void)
@@ -82,8 +90,20 @@ bool AudioRTDSP_i16::audio_hw_init(void)
 	}
 
 	/*SET DEVICE ACCESS*/
+	/*
+	 * If mmap access was requested but the device doesn't support it, fall back to RW access.
+	 */
+
+	this->MMAP_ACCESS = false;
+
+	if(this->MMAP_ACCESS_REQUESTED)
+	{
+		n_ret = snd_pcm_hw_params_set_access(this->p_audiodev, p_hwparams, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if(n_ret >= 0) this->MMAP_ACCESS = true;
+	}
+
+	if(!this->MMAP_ACCESS) n_ret = snd_pcm_hw_params_set_access(this->p_audiodev, p_hwparams, SND_PCM_ACCESS_RW_INTERLEAVED);
 
-	n_ret = snd_pcm_hw_params_set_access(this->p_audiodev, p_hwparams, SND_PCM_ACCESS_RW_INTERLEAVED);
 	if(n_ret < 0)
 	{
 		snd_pcm_hw_params_free(p_hwparams);
@@ -103,6 +123,8 @@ bool AudioRTDSP_i16::audio_hw_init(void)
 		return false;
 	}
 
+	this->AUDIODEV_FORMAT = SND_PCM_FORMAT_S16_LE;
+
 	/*SET DEVICE CHANNELS*/
 
 	n_ret = snd_pcm_hw_params_set_channels(this->p_audiodev, p_hwparams, (unsigned int) this->N_CHANNELS);
@@ -177,6 +199,12 @@ bool AudioRTDSP_i16::audio_hw_init(void)
 	this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES = (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES)*(this->N_CHANNELS);
 	this->AUDIOBUFFER_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES*2u;
 
+	this->BUFFEROUT_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_BYTES;
+	this->FILEIN_SEGMENT_SIZE_BYTES = this->AUDIOBUFFER_SEGMENT_SIZE_BYTES;
+
+	/*mmap access renders into the device buffer: only the scratch segment (used when the mapped area wraps) is needed*/
+	if(this->MMAP_ACCESS) this->BUFFEROUT_N_SEGMENTS = 1u;
+
 	this->BUFFEROUT_SIZE_FRAMES = (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES)*(this->BUFFEROUT_N_SEGMENTS);
 	this->BUFFEROUT_SIZE_SAMPLES = (this->BUFFEROUT_SIZE_FRAMES)*(this->N_CHANNELS);
 	this->BUFFEROUT_SIZE_BYTES = this->BUFFEROUT_SIZE_SAMPLES*2u;
@@ -185,7 +213,8 @@ bool AudioRTDSP_i16::audio_hw_init(void)
 	this->BUFFERIN_SIZE_BYTES = this->BUFFERIN_SIZE_SAMPLES*2u;
 	this->BUFFERIN_N_SEGMENTS = (this->BUFFERIN_SIZE_FRAMES)/(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES);
 
-	this->DSPFRAME_SIZE_BYTES = (this->DSPFRAME_SAMPLE_SIZE_BYTES)*(this->N_CHANNELS);
+	this->DSPSEG_SIZE_BYTES = (this->DSPSEG_SAMPLE_SIZE_BYTES)*(this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+	this->DSPSEG_SIZE_BYTES = ((this->DSPSEG_SIZE_BYTES + 63u)/64u)*64u; /*aligned_alloc() size must be a multiple of the alignment*/
 
 	snd_pcm_hw_params_free(p_hwparams);
 	return true;
@@ -197,15 +226,14 @@ bool AudioRTDSP_i16::buffer_alloc(void)
 
 	this->buffer_free(); /*Clear any previous allocations*/
 
-	this->p_bufferinput = malloc(this->BUFFERIN_SIZE_BYTES);
 	this->p_bufferoutput = malloc(this->BUFFEROUT_SIZE_BYTES);
 
 	this->pp_bufferinput_segments = (void**) malloc(this->BUFFERIN_N_SEGMENTS*sizeof(void*));
 	this->pp_bufferoutput_segments = (void**) malloc(this->BUFFEROUT_N_SEGMENTS*sizeof(void*));
 
-	this->p_dspframe = (int32_t*) malloc(this->DSPFRAME_SIZE_BYTES);
+	this->p_dspseg = (int32_t*) aligned_alloc(64u, this->DSPSEG_SIZE_BYTES);
 
-	if(this->p_bufferinput == NULL)
+	if(!this->bufferin_alloc())
 	{
 		this->buffer_free();
 		return false;
@@ -229,29 +257,25 @@ bool AudioRTDSP_i16::buffer_alloc(void)
 		return false;
 	}
 
-	if(this->p_dspframe == NULL)
+	if(this->p_dspseg == NULL)
 	{
 		this->buffer_free();
 		return false;
 	}
 
-	memset(this->p_bufferinput, 0, this->BUFFERIN_SIZE_BYTES);
+	memset(this->p_bufferinput, 0, this->BUFFERIN_SIZE_BYTES); /*Also clears the upper (mirror) half*/
 	memset(this->p_bufferoutput, 0, this->BUFFEROUT_SIZE_BYTES);
-	memset(this->p_dspframe, 0, this->DSPFRAME_SIZE_BYTES);
+	memset(this->p_dspseg, 0, this->DSPSEG_SIZE_BYTES);
 
 	for(n_seg = 0u; n_seg < this->BUFFERIN_N_SEGMENTS; n_seg++) this->pp_bufferinput_segments[n_seg] = (void*) (((size_t) this->p_bufferinput) + n_seg*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
-	for(n_seg = 0u; n_seg < this->BUFFEROUT_N_SEGMENTS; n_seg++) this->pp_bufferoutput_segments[n_seg] = (void*) (((size_t) this->p_bufferoutput) + n_seg*(this->AUDIOBUFFER_SEGMENT_SIZE_BYTES));
+	for(n_seg = 0u; n_seg < this->BUFFEROUT_N_SEGMENTS; n_seg++) this->pp_bufferoutput_segments[n_seg] = (void*) (((size_t) this->p_bufferoutput) + n_seg*(this->BUFFEROUT_SEGMENT_SIZE_BYTES));
 
 	return true;
 }
 
 void AudioRTDSP_i16::buffer_free(void)
 {
-	if(this->p_bufferinput != NULL)
-	{
-		free(this->p_bufferinput);
-		this->p_bufferinput = NULL;
-	}
+	this->bufferin_free();
 
 	if(this->p_bufferoutput != NULL)
 	{
@@ -271,28 +295,31 @@ void AudioRTDSP_i16::buffer_free(void)
 		this->pp_bufferoutput_segments = NULL;
 	}
 
-	if(this->p_dspframe != NULL)
+	if(this->p_dspseg != NULL)
 	{
-		free(this->p_dspframe);
-		this->p_dspframe = NULL;
+		free(this->p_dspseg);
+		this->p_dspseg = NULL;
 	}
 
 	return;
 }
 
-void AudioRTDSP_i16::buffer_load(void)
+void AudioRTDSP_i16::buffer_prefault(void)
 {
-	if(this->filein_pos >= this->AUDIO_DATA_END)
-	{
-		this->stop_playback = true;
-		return;
-	}
+	this->rt_memory_prefault(this->pp_bufferinput_segments, this->BUFFERIN_N_SEGMENTS*sizeof(void*));
+	this->rt_memory_prefault(this->pp_bufferoutput_segments, this->BUFFEROUT_N_SEGMENTS*sizeof(void*));
+	this->rt_memory_prefault(this->p_dspseg, this->DSPSEG_SIZE_BYTES);
+	return;
+}
+
+void AudioRTDSP_i16::prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes)
+{
+	/*File sample format is the same as the input buffer sample format*/
 
-	memset(this->pp_bufferinput_segments[this->bufferin_nseg_curr], 0, this->AUDIOBUFFER_SEGMENT_SIZE_BYTES);
+	n_bytes &= ~((size_t) 1u); /*Whole samples only*/
 
-	__LSEEK(this->h_filein, this->filein_pos, SEEK_SET);
-	read(this->h_filein, this->pp_bufferinput_segments[this->bufferin_nseg_curr], this->AUDIOBUFFER_SEGMENT_SIZE_BYTES);
-	this->filein_pos += (__offset) this->AUDIOBUFFER_SEGMENT_SIZE_BYTES;
+	memcpy(p_dst, p_src, n_bytes);
+	if(n_bytes < this->AUDIOBUFFER_SEGMENT_SIZE_BYTES) memset((void*) (((size_t) p_dst) + n_bytes), 0, this->AUDIOBUFFER_SEGMENT_SIZE_BYTES - n_bytes);
 
 	return;
 }
@@ -303,83 +330,158 @@ void AudioRTDSP_i16::dsp_proc(void)
 	int16_t *p_loadout_seg = NULL;
 	int16_t *p_bufferin = NULL;
 
-	size_t curr_seg_nframe = 0u;
-	size_t prev_buf_nframe = 0u;
+	const dspkernel_t *p_kernel = NULL;
+	const audiortdsp_tap_t *p_tap = NULL;
+
+	int16_t *p_currin_mirror = NULL;
+	int16_t *p_previn = NULL;
 
-	size_t n_currsample = 0u;
-	size_t n_prevsample = 0u;
-	size_t n_channel = 0u;
+	int32_t *p_comb_state = NULL;
+	const int16_t *p_comb_src = NULL;
 
-	int32_t n_cycles = 0;
-	int32_t n_cycle = 0;
-	int32_t n_reldelay = 0;
-	int32_t n_delay = 0;
-	int32_t cycle_div = 0;
-	int32_t pol = 0;
+	size_t n_tap = 0u;
+	size_t n_sample = 0u;
+	size_t n_frame = 0u;
+	size_t n_frames = 0u;
 
-	bool feedback_altpol = false;
-	bool cyclediv_incone = false;
+	this->taptable_update(15u, 16u); /*Q15 gains*/
+	this->dspengine_update(false, this->COMB_FRAC_BITS);
 
 	p_currin_seg = (int16_t*) (this->pp_bufferinput_segments[this->bufferin_nseg_curr]);
-	p_loadout_seg = (int16_t*) (this->pp_bufferoutput_segments[this->bufferout_nseg_load]);
+	p_loadout_seg = (int16_t*) (this->p_bufferout_load);
 	p_bufferin = (int16_t*) (this->p_bufferinput);
 
-	n_reldelay = this->fx_params.n_delay;
-	n_cycles = this->fx_params.n_feedback + 1;
+	/*Current segment, in the upper half of the mirrored input buffer. Delayed frames are at (p_currin_mirror - n_delay).*/
 
-	feedback_altpol = this->fx_params.feedback_altpol;
-	cyclediv_incone = this->fx_params.cyclediv_incone;
+	p_currin_mirror = &p_bufferin[(this->bufferin_nseg_curr*(this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES) + this->BUFFERIN_SIZE_FRAMES)*(this->N_CHANNELS)];
 
-	for(curr_seg_nframe = 0u; curr_seg_nframe < this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES; curr_seg_nframe++)
+	p_kernel = this->p_dspkernel;
+
+	p_kernel->load_i16(this->p_dspseg, p_currin_seg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
+
+	if(this->fbdelay_active)
 	{
-		n_currsample = curr_seg_nframe*(this->N_CHANNELS);
+		/*Feedback delay: one delay line read and write per sample. A chunk (up to fbdelay_delay frames) only depends on the chunks before it.*/
 
-		for(n_channel = 0u; n_channel < this->N_CHANNELS; n_channel++)
+		for(n_frame = 0u; n_frame < this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES; n_frame += n_frames)
 		{
-			this->p_dspframe[n_channel] = (int32_t) p_currin_seg[n_currsample];
-			n_currsample++;
+			n_frames = this->fbdelay_delay - this->fbdelay_pos;
+			if(n_frames > (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame)) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame;
+
+			p_kernel->fbdelay_i16(&(this->p_dspseg[n_frame*(this->N_CHANNELS)]), &(this->p_fbdelay[(this->fbdelay_pos)*(this->N_CHANNELS)]), &p_currin_seg[n_frame*(this->N_CHANNELS)], n_frames*(this->N_CHANNELS), this->fbdelay_gain);
+
+			this->fbdelay_pos += n_frames;
+			if(this->fbdelay_pos == this->fbdelay_delay) this->fbdelay_pos = 0u;
 		}
+	}
+	else if(this->comb_active)
+	{
+		/*Recursive comb: one step per sample, whatever the number of taps. A chunk (up to comb_delay frames) only depends on the chunks before it.*/
 
-		pol = 1;
-		n_cycle = 1;
+		p_comb_state = (int32_t*) this->p_comb_state;
 
-		while(n_cycle <= n_cycles)
+		for(n_frame = 0u; n_frame < this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES; n_frame += n_frames)
 		{
-			if(feedback_altpol) pol ^= 0xfffffffe; /*Toggle between -1 and 1*/
+			n_frames = this->comb_delay - this->comb_pos;
+			if(n_frames > (this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame)) n_frames = this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES - n_frame;
 
-			if(cyclediv_incone) cycle_div = n_cycle + 1;
-			else cycle_div = (1 << n_cycle);
+			p_comb_src = &p_currin_mirror[n_frame*(this->N_CHANNELS)] - (this->comb_delay)*(this->N_CHANNELS);
+			p_kernel->comb_i16(&(this->p_dspseg[n_frame*(this->N_CHANNELS)]), &p_comb_state[(this->comb_pos)*(this->N_CHANNELS)], p_comb_src, p_comb_src - (this->comb_delay_old - this->comb_delay)*(this->N_CHANNELS), n_frames*(this->N_CHANNELS), this->comb_pol, this->comb_pol_old, this->COMB_FRAC_BITS, this->comb_shift_old);
 
-			if(!cycle_div) break; /*Stop if cycle_div == 0*/
+			this->comb_pos += n_frames;
+			if(this->comb_pos == this->comb_delay) this->comb_pos = 0u;
+		}
+	}
+	else if(this->fftconv_active)
+	{
+		/*FFT engine: all taps at once, the wet signal is rounded once per sample*/
 
-			n_delay = n_cycle*n_reldelay;
+		this->fftconv_proc(p_currin_seg);
+		for(n_sample = 0u; n_sample < this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES; n_sample++) this->p_dspseg[n_sample] += (int32_t) lrint(this->p_fftconv_out[n_sample]);
+	}
+	else for(n_tap = 0u; n_tap < this->taptable_n_taps; n_tap++)
+	{
+		p_tap = &(this->p_taptable[n_tap]);
 
-			this->retrieve_previn_nframe(this->bufferin_nseg_curr, curr_seg_nframe, (size_t) n_delay, &prev_buf_nframe, NULL, NULL);
+		p_previn = p_currin_mirror - (p_tap->n_delay)*(this->N_CHANNELS);
 
-			n_prevsample = prev_buf_nframe*(this->N_CHANNELS);
+		if(p_tap->src_channel >= 0) this->dsp_tap_routed(this->p_dspseg, p_previn, this->AUDIOBUFFER_SEGMENT_SIZE_FRAMES, p_tap);
+		else if(this->DSP_BITEXACT && p_tap->magic) this->dsp_tap_bitexact(this->p_dspseg, p_previn, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, p_tap);
+		else p_kernel->tap_i16(this->p_dspseg, p_previn, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES, p_tap->gain, p_tap->shift);
+	}
 
-			for(n_channel = 0u; n_channel < this->N_CHANNELS; n_channel++)
-			{
-				this->p_dspframe[n_channel] += pol*((int32_t) p_bufferin[n_prevsample])/cycle_div;
-				n_prevsample++;
-			}
+	p_kernel->store_i16(p_loadout_seg, this->p_dspseg, this->AUDIOBUFFER_SEGMENT_SIZE_SAMPLES);
 
-			n_cycle++;
-		}
+	return;
+}
 
-		n_currsample = curr_seg_nframe*(this->N_CHANNELS);
-		for(n_channel = 0u; n_channel < this->N_CHANNELS; n_channel++)
-		{
-			this->p_dspframe[n_channel] /= 2;
+void AudioRTDSP_i16::bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples)
+{
+	const int16_t *p_src_i16 = NULL;
+	size_t n_sample = 0u;
 
-			if(this->p_dspframe[n_channel] > this->SAMPLE_MAX_VALUE) p_loadout_seg[n_currsample] = (int16_t) this->SAMPLE_MAX_VALUE;
-			else if(this->p_dspframe[n_channel] < this->SAMPLE_MIN_VALUE) p_loadout_seg[n_currsample] = (int16_t) this->SAMPLE_MIN_VALUE;
-			else p_loadout_seg[n_currsample] = (int16_t) this->p_dspframe[n_channel];
+	p_src_i16 = (const int16_t*) p_src;
 
-			n_currsample++;
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_dst[n_sample] = (double) p_src_i16[n_sample];
+
+	return;
+}
+
+void AudioRTDSP_i16::dsp_tap_bitexact(int32_t *p_acc, const int16_t *p_src, size_t n_samples, const audiortdsp_tap_t *p_tap)
+{
+	size_t n_sample = 0u;
+
+	int32_t gain = 0;
+	uint32_t shift = 0u;
+	uint64_t magic = 0u;
+	int32_t sample = 0;
+	int32_t quot = 0;
+
+	gain = p_tap->gain;
+	shift = p_tap->shift;
+	magic = p_tap->magic;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		sample = gain*((int32_t) p_src[n_sample]);
+
+		if(sample < 0)
+		{
+			quot = (int32_t) ((((uint64_t) -sample)*magic) >> shift);
+			p_acc[n_sample] -= quot;
+		}
+		else
+		{
+			quot = (int32_t) ((((uint64_t) sample)*magic) >> shift);
+			p_acc[n_sample] += quot;
 		}
 	}
 
 	return;
 }
 
+void AudioRTDSP_i16::dsp_tap_routed(int32_t *p_acc, const int16_t *p_src, size_t n_frames, const audiortdsp_tap_t *p_tap)
+{
+	size_t n_frame = 0u;
+	size_t src_channel = 0u;
+	size_t dst_channel = 0u;
+
+	int32_t gain = 0;
+	int32_t rounding = 0;
+	uint32_t shift = 0u;
+
+	src_channel = (size_t) p_tap->src_channel;
+	dst_channel = (size_t) p_tap->dst_channel;
+	gain = p_tap->gain;
+	shift = p_tap->shift;
+	rounding = (((int32_t) 1) << shift) >> 1;
+
+	/*Same math as the tap kernel, on one channel of each frame*/
+
+	for(n_frame = 0u; n_frame < n_frames; n_frame++)
+	{
+		p_acc[n_frame*(this->N_CHANNELS) + dst_channel] += (((int32_t) p_src[n_frame*(this->N_CHANNELS) + src_channel])*gain + rounding) >> shift;
+	}
+
+	return;
+}
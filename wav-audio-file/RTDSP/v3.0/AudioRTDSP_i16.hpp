@@ -21,23 +21,30 @@ class AudioRTDSP_i16 : public AudioRTDSP {
 		static constexpr int32_t SAMPLE_MIN_VALUE = -0x8000;
 
 		/*
-		 * dspframe is a buffer used to store a single frame of audio.
+		 * dspseg is the accumulator buffer, it holds a whole segment of audio (AUDIOBUFFER_SEGMENT_SIZE_SAMPLES samples).
 		 * It uses a sample size bigger than the normal I/O buffer sample size.
 		 * This is where all the signal processing happens.
 		 * The purpose of this buffer with bigger sample size is to prevent integer overflow/underflow from the signal processing math operations.
 		 */
 
-		static constexpr size_t DSPFRAME_SAMPLE_SIZE_BYTES = 4u;
+		static constexpr size_t DSPSEG_SAMPLE_SIZE_BYTES = 4u;
 
-		size_t DSPFRAME_SIZE_BYTES = 0u;
+		size_t DSPSEG_SIZE_BYTES = 0u;
 
-		int32_t *p_dspframe = NULL;
+		int32_t *p_dspseg = NULL;
+
+		static constexpr uint32_t COMB_FRAC_BITS = 14u; /*Recursive comb state fraction bits (16bit samples, state magnitude < 2^15: (x << 14) + state fits in 31 bits)*/
 
 		bool audio_hw_init(void) override;
 		bool buffer_alloc(void) override;
 		void buffer_free(void) override;
-		void buffer_load(void) override;
+		void buffer_prefault(void) override;
+		void prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes) override;
 		void dsp_proc(void) override;
+		void bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples) override;
+		void dsp_tap_routed(int32_t *p_acc, const int16_t *p_src, size_t n_frames, const audiortdsp_tap_t *p_tap);
+
+		void dsp_tap_bitexact(int32_t *p_acc, const int16_t *p_src, size_t n_samples, const audiortdsp_tap_t *p_tap);
 };
 
 #endif /*AUDIORTDSP_I16_HPP*/
@@ -20,15 +20,39 @@ class AudioRTDSP_i24 : public AudioRTDSP {
 		static constexpr int32_t SAMPLE_MAX_VALUE = 0x7fffff;
 		static constexpr int32_t SAMPLE_MIN_VALUE = -0x800000;
 
-		size_t BYTEBUF_SIZE = 0u;
+		/*
+		 * Device sample formats, in order of preference. DEVICE_SAMPLE_SIZE_BYTES is the sample size of the format in use.
+		 */
 
-		uint8_t *p_bytebuf = NULL;
+		static constexpr snd_pcm_format_t DEVICE_FORMATS[] = {SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_LE};
+		static constexpr size_t N_DEVICE_FORMATS = 3u;
+
+		size_t DEVICE_SAMPLE_SIZE_BYTES = 4u;
+
+		/*
+		 * dspseg is the accumulator buffer, it holds a whole segment of audio (AUDIOBUFFER_SEGMENT_SIZE_SAMPLES samples). This is where all the signal processing happens.
+		 * The output segment is only written once per sample, after processing. It might be the device buffer itself (mmap access),
+		 * which should not be used as a scratch buffer.
+		 */
+
+		static constexpr size_t DSPSEG_SAMPLE_SIZE_BYTES = 4u;
+
+		size_t DSPSEG_SIZE_BYTES = 0u;
+
+		int32_t *p_dspseg = NULL;
+
+		static constexpr uint32_t COMB_FRAC_BITS = 6u; /*Recursive comb state fraction bits (24bit samples, state magnitude < 2^23: (x << 6) + state fits in 31 bits)*/
 
 		bool audio_hw_init(void) override;
 		bool buffer_alloc(void) override;
 		void buffer_free(void) override;
-		void buffer_load(void) override;
+		void buffer_prefault(void) override;
+		void prefetch_decode(void *p_dst, const uint8_t *p_src, size_t n_bytes) override;
 		void dsp_proc(void) override;
+		void bufferin_load_f64(double *p_dst, const void *p_src, size_t n_samples) override;
+		void dsp_tap_routed(int32_t *p_acc, const int32_t *p_src, size_t n_frames, const audiortdsp_tap_t *p_tap);
+
+		void dsp_tap_bitexact(int32_t *p_acc, const int32_t *p_src, size_t n_samples, const audiortdsp_tap_t *p_tap);
 };
 
 #endif /*AUDIORTDSP_I24_HPP*/
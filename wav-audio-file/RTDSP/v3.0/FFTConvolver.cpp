@@ -0,0 +1,448 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#include "FFTConvolver.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Cost model constants, in units of one direct form tap on one sample (measured on x86, SIMD direct kernels vs this scalar double FFT).
+ * FFTCONVOLVER_COST_BUTTERFLY: one radix-2 butterfly. FFTCONVOLVER_COST_MAC: one complex multiply-add (spectrum product).
+ */
+
+#define FFTCONVOLVER_COST_BUTTERFLY 16.0
+#define FFTCONVOLVER_COST_MAC 16.0
+
+FFTConvolver::FFTConvolver(void)
+{
+}
+
+FFTConvolver::~FFTConvolver(void)
+{
+	this->deinitialize();
+}
+
+bool FFTConvolver::initialize(size_t block_frames, size_t n_channels, size_t max_ir_frames)
+{
+	size_t n = 0u;
+	size_t n_bit = 0u;
+	size_t rev = 0u;
+	size_t spectrum_size = 0u;
+
+	this->deinitialize(); /*Clear any previous allocations*/
+
+	if(!block_frames || !n_channels || !max_ir_frames) return false;
+
+	this->BLOCK_FRAMES = block_frames;
+	this->N_CHANNELS = n_channels;
+	this->N_PAIRS = (n_channels + 1u)/2u;
+
+	this->FFT_SIZE = 2u;
+	this->FFT_LOG2 = 1u;
+
+	while(this->FFT_SIZE < 2u*block_frames)
+	{
+		this->FFT_SIZE <<= 1;
+		this->FFT_LOG2++;
+	}
+
+	this->MAX_PARTITIONS = (max_ir_frames + block_frames - 1u)/block_frames;
+
+	spectrum_size = this->FFT_SIZE*sizeof(double);
+
+	this->p_active = (size_t*) malloc(this->MAX_PARTITIONS*sizeof(size_t));
+	this->p_twiddle_re = (double*) malloc(spectrum_size/2u);
+	this->p_twiddle_im = (double*) malloc(spectrum_size/2u);
+	this->p_bitrev = (size_t*) malloc(this->FFT_SIZE*sizeof(size_t));
+	this->p_ir_re = (double*) malloc(this->MAX_PARTITIONS*spectrum_size);
+	this->p_ir_im = (double*) malloc(this->MAX_PARTITIONS*spectrum_size);
+	this->p_fdl_re = (double*) malloc((this->N_PAIRS)*(this->MAX_PARTITIONS)*spectrum_size);
+	this->p_fdl_im = (double*) malloc((this->N_PAIRS)*(this->MAX_PARTITIONS)*spectrum_size);
+	this->p_window_re = (double*) malloc((this->N_PAIRS)*spectrum_size);
+	this->p_window_im = (double*) malloc((this->N_PAIRS)*spectrum_size);
+	this->p_acc_re = (double*) malloc(spectrum_size);
+	this->p_acc_im = (double*) malloc(spectrum_size);
+
+	if((this->p_active == NULL) || (this->p_twiddle_re == NULL) || (this->p_twiddle_im == NULL) || (this->p_bitrev == NULL)
+		|| (this->p_ir_re == NULL) || (this->p_ir_im == NULL) || (this->p_fdl_re == NULL) || (this->p_fdl_im == NULL)
+		|| (this->p_window_re == NULL) || (this->p_window_im == NULL) || (this->p_acc_re == NULL) || (this->p_acc_im == NULL))
+	{
+		this->deinitialize();
+		return false;
+	}
+
+	for(n = 0u; n < this->FFT_SIZE/2u; n++)
+	{
+		this->p_twiddle_re[n] = cos(-2.0*M_PI*((double) n)/((double) this->FFT_SIZE));
+		this->p_twiddle_im[n] = sin(-2.0*M_PI*((double) n)/((double) this->FFT_SIZE));
+	}
+
+	for(n = 0u; n < this->FFT_SIZE; n++)
+	{
+		rev = 0u;
+		for(n_bit = 0u; n_bit < this->FFT_LOG2; n_bit++) rev |= ((n >> n_bit) & 0x1) << (this->FFT_LOG2 - 1u - n_bit);
+
+		this->p_bitrev[n] = rev;
+	}
+
+	/*Every array gets written here, so its pages are in memory before a real time caller locks memory (reset() clears the rest)*/
+
+	memset(this->p_active, 0, this->MAX_PARTITIONS*sizeof(size_t));
+	memset(this->p_ir_re, 0, this->MAX_PARTITIONS*spectrum_size);
+	memset(this->p_ir_im, 0, this->MAX_PARTITIONS*spectrum_size);
+	memset(this->p_acc_re, 0, spectrum_size);
+	memset(this->p_acc_im, 0, spectrum_size);
+
+	this->n_partitions = 0u;
+	this->n_active = 0u;
+
+	this->reset();
+	return true;
+}
+
+void FFTConvolver::deinitialize(void)
+{
+	if(this->p_active != NULL) free(this->p_active);
+	if(this->p_twiddle_re != NULL) free(this->p_twiddle_re);
+	if(this->p_twiddle_im != NULL) free(this->p_twiddle_im);
+	if(this->p_bitrev != NULL) free(this->p_bitrev);
+	if(this->p_ir_re != NULL) free(this->p_ir_re);
+	if(this->p_ir_im != NULL) free(this->p_ir_im);
+	if(this->p_fdl_re != NULL) free(this->p_fdl_re);
+	if(this->p_fdl_im != NULL) free(this->p_fdl_im);
+	if(this->p_window_re != NULL) free(this->p_window_re);
+	if(this->p_window_im != NULL) free(this->p_window_im);
+	if(this->p_acc_re != NULL) free(this->p_acc_re);
+	if(this->p_acc_im != NULL) free(this->p_acc_im);
+
+	this->p_active = NULL;
+	this->p_twiddle_re = NULL;
+	this->p_twiddle_im = NULL;
+	this->p_bitrev = NULL;
+	this->p_ir_re = NULL;
+	this->p_ir_im = NULL;
+	this->p_fdl_re = NULL;
+	this->p_fdl_im = NULL;
+	this->p_window_re = NULL;
+	this->p_window_im = NULL;
+	this->p_acc_re = NULL;
+	this->p_acc_im = NULL;
+
+	this->MAX_PARTITIONS = 0u;
+	this->n_partitions = 0u;
+	this->n_active = 0u;
+
+	return;
+}
+
+size_t FFTConvolver::setImpulseResponse(const double *p_ir, size_t ir_frames)
+{
+	double *p_re = NULL;
+	double *p_im = NULL;
+	size_t n_part = 0u;
+	size_t n_frame = 0u;
+	size_t n_frames = 0u;
+	bool nonzero = false;
+
+	if(this->p_ir_re == NULL) return 0u;
+	if(ir_frames > (this->MAX_PARTITIONS)*(this->BLOCK_FRAMES)) ir_frames = (this->MAX_PARTITIONS)*(this->BLOCK_FRAMES);
+
+	this->n_partitions = (ir_frames + this->BLOCK_FRAMES - 1u)/(this->BLOCK_FRAMES);
+	this->n_active = 0u;
+
+	for(n_part = 0u; n_part < this->n_partitions; n_part++)
+	{
+		n_frames = ir_frames - n_part*(this->BLOCK_FRAMES);
+		if(n_frames > this->BLOCK_FRAMES) n_frames = this->BLOCK_FRAMES;
+
+		nonzero = false;
+		for(n_frame = 0u; n_frame < n_frames; n_frame++)
+		{
+			if(p_ir[n_part*(this->BLOCK_FRAMES) + n_frame] != 0.0)
+			{
+				nonzero = true;
+				break;
+			}
+		}
+
+		if(!nonzero) continue;
+
+		/*Partition at the start of the window, zero padded to FFT_SIZE*/
+
+		p_re = &(this->p_ir_re[(this->n_active)*(this->FFT_SIZE)]);
+		p_im = &(this->p_ir_im[(this->n_active)*(this->FFT_SIZE)]);
+
+		memset(p_re, 0, (this->FFT_SIZE)*sizeof(double));
+		memset(p_im, 0, (this->FFT_SIZE)*sizeof(double));
+		memcpy(p_re, &p_ir[n_part*(this->BLOCK_FRAMES)], n_frames*sizeof(double));
+
+		this->fft(p_re, p_im);
+
+		this->p_active[this->n_active] = n_part;
+		this->n_active++;
+	}
+
+	return this->n_active;
+}
+
+void FFTConvolver::reset(void)
+{
+	if(this->p_fdl_re == NULL) return;
+
+	memset(this->p_fdl_re, 0, (this->N_PAIRS)*(this->MAX_PARTITIONS)*(this->FFT_SIZE)*sizeof(double));
+	memset(this->p_fdl_im, 0, (this->N_PAIRS)*(this->MAX_PARTITIONS)*(this->FFT_SIZE)*sizeof(double));
+	memset(this->p_window_re, 0, (this->N_PAIRS)*(this->FFT_SIZE)*sizeof(double));
+	memset(this->p_window_im, 0, (this->N_PAIRS)*(this->FFT_SIZE)*sizeof(double));
+
+	this->fdl_pos = 0u;
+	return;
+}
+
+void FFTConvolver::push(const double *p_in)
+{
+	if(this->p_fdl_re == NULL) return;
+
+	this->block_input(p_in);
+	return;
+}
+
+void FFTConvolver::process(const double *p_in, double *p_out)
+{
+	const double *p_xre = NULL;
+	const double *p_xim = NULL;
+	const double *p_hre = NULL;
+	const double *p_him = NULL;
+	double *p_acc_re = NULL;
+	double *p_acc_im = NULL;
+	size_t fft_size = 0u;
+	size_t n_pair = 0u;
+	size_t n_active = 0u;
+	size_t n_slot = 0u;
+	size_t n_bin = 0u;
+	size_t n_frame = 0u;
+	size_t n_ch = 0u;
+	size_t offset = 0u;
+	double scale = 0.0;
+
+	if(this->p_fdl_re == NULL) return;
+
+	this->block_input(p_in);
+
+	p_acc_re = this->p_acc_re;
+	p_acc_im = this->p_acc_im;
+	fft_size = this->FFT_SIZE;
+
+	scale = 1.0/((double) fft_size);
+	offset = this->FFT_SIZE - this->BLOCK_FRAMES;
+
+	for(n_pair = 0u; n_pair < this->N_PAIRS; n_pair++)
+	{
+		memset(p_acc_re, 0, fft_size*sizeof(double));
+		memset(p_acc_im, 0, fft_size*sizeof(double));
+
+		/*Sum of (input spectrum, partition p blocks ago)*(partition p spectrum)*/
+
+		for(n_active = 0u; n_active < this->n_active; n_active++)
+		{
+			n_slot = (this->fdl_pos + this->MAX_PARTITIONS - this->p_active[n_active])%(this->MAX_PARTITIONS);
+
+			p_xre = &(this->p_fdl_re[(n_pair*(this->MAX_PARTITIONS) + n_slot)*fft_size]);
+			p_xim = &(this->p_fdl_im[(n_pair*(this->MAX_PARTITIONS) + n_slot)*fft_size]);
+			p_hre = &(this->p_ir_re[n_active*fft_size]);
+			p_him = &(this->p_ir_im[n_active*fft_size]);
+
+			for(n_bin = 0u; n_bin < fft_size; n_bin++)
+			{
+				p_acc_re[n_bin] += p_xre[n_bin]*p_hre[n_bin] - p_xim[n_bin]*p_him[n_bin];
+				p_acc_im[n_bin] += p_xre[n_bin]*p_him[n_bin] + p_xim[n_bin]*p_hre[n_bin];
+			}
+		}
+
+		/*Inverse transform: conj(fft(conj(X)))/FFT_SIZE. Only the last BLOCK_FRAMES frames are valid (the others are circular wraparound).*/
+
+		for(n_bin = 0u; n_bin < fft_size; n_bin++) p_acc_im[n_bin] = -p_acc_im[n_bin];
+
+		this->fft(p_acc_re, p_acc_im);
+
+		n_ch = 2u*n_pair;
+
+		for(n_frame = 0u; n_frame < this->BLOCK_FRAMES; n_frame++)
+		{
+			p_out[n_frame*(this->N_CHANNELS) + n_ch] = p_acc_re[offset + n_frame]*scale;
+			if((n_ch + 1u) < this->N_CHANNELS) p_out[n_frame*(this->N_CHANNELS) + n_ch + 1u] = -p_acc_im[offset + n_frame]*scale;
+		}
+	}
+
+	return;
+}
+
+size_t FFTConvolver::getHistoryFrames(void)
+{
+	if(!this->n_partitions) return 0u;
+
+	return (this->n_partitions - 1u)*(this->BLOCK_FRAMES) + this->FFT_SIZE - this->BLOCK_FRAMES;
+}
+
+size_t FFTConvolver::getBlockFrames(void)
+{
+	return this->BLOCK_FRAMES;
+}
+
+size_t FFTConvolver::getFFTSize(void)
+{
+	return this->FFT_SIZE;
+}
+
+size_t FFTConvolver::getActivePartitions(void)
+{
+	return this->n_active;
+}
+
+double FFTConvolver::estimateCost(size_t n_active)
+{
+	double n_butterflies = 0.0;
+
+	/*Per channel pair: one forward and one inverse transform, n_active spectrum products. Plus the sample conversions.*/
+
+	n_butterflies = ((double) this->FFT_SIZE)*((double) this->FFT_LOG2)/2.0;
+
+	return ((double) this->N_PAIRS)*(2.0*n_butterflies*FFTCONVOLVER_COST_BUTTERFLY + ((double) n_active)*((double) this->FFT_SIZE)*FFTCONVOLVER_COST_MAC)
+		+ 2.0*((double) this->BLOCK_FRAMES)*((double) this->N_CHANNELS);
+}
+
+void FFTConvolver::fft(double *p_re, double *p_im)
+{
+	const double *p_twre = NULL;
+	const double *p_twim = NULL;
+	const size_t *p_rev = NULL;
+	size_t fft_size = 0u;
+	size_t n = 0u;
+	size_t n_rev = 0u;
+	size_t len = 0u;
+	size_t half = 0u;
+	size_t step = 0u;
+	size_t n_group = 0u;
+	size_t n_bfly = 0u;
+	double *p_are = NULL;
+	double *p_aim = NULL;
+	double *p_bre = NULL;
+	double *p_bim = NULL;
+	double tmp = 0.0;
+	double t_re = 0.0;
+	double t_im = 0.0;
+
+	/*Members are copied to locals: the arrays may alias them as far as the compiler knows*/
+
+	p_twre = this->p_twiddle_re;
+	p_twim = this->p_twiddle_im;
+	p_rev = this->p_bitrev;
+	fft_size = this->FFT_SIZE;
+
+	/*In place radix-2 decimation in time: bit reversed order first, then log2(FFT_SIZE) butterfly stages*/
+
+	for(n = 0u; n < fft_size; n++)
+	{
+		n_rev = p_rev[n];
+		if(n_rev <= n) continue;
+
+		tmp = p_re[n];
+		p_re[n] = p_re[n_rev];
+		p_re[n_rev] = tmp;
+
+		tmp = p_im[n];
+		p_im[n] = p_im[n_rev];
+		p_im[n_rev] = tmp;
+	}
+
+	/*First stage: twiddle factor is 1*/
+
+	for(n_group = 0u; n_group < fft_size; n_group += 2u)
+	{
+		t_re = p_re[n_group + 1u];
+		t_im = p_im[n_group + 1u];
+
+		p_re[n_group + 1u] = p_re[n_group] - t_re;
+		p_im[n_group + 1u] = p_im[n_group] - t_im;
+		p_re[n_group] += t_re;
+		p_im[n_group] += t_im;
+	}
+
+	for(len = 4u; len <= fft_size; len <<= 1)
+	{
+		half = len/2u;
+		step = fft_size/len;
+
+		for(n_group = 0u; n_group < fft_size; n_group += len)
+		{
+			p_are = &p_re[n_group];
+			p_aim = &p_im[n_group];
+			p_bre = &p_re[n_group + half];
+			p_bim = &p_im[n_group + half];
+
+			for(n_bfly = 0u; n_bfly < half; n_bfly++)
+			{
+				t_re = p_bre[n_bfly]*p_twre[n_bfly*step] - p_bim[n_bfly]*p_twim[n_bfly*step];
+				t_im = p_bre[n_bfly]*p_twim[n_bfly*step] + p_bim[n_bfly]*p_twre[n_bfly*step];
+
+				p_bre[n_bfly] = p_are[n_bfly] - t_re;
+				p_bim[n_bfly] = p_aim[n_bfly] - t_im;
+				p_are[n_bfly] += t_re;
+				p_aim[n_bfly] += t_im;
+			}
+		}
+	}
+
+	return;
+}
+
+void FFTConvolver::block_input(const double *p_in)
+{
+	double *p_wre = NULL;
+	double *p_wim = NULL;
+	double *p_xre = NULL;
+	double *p_xim = NULL;
+	size_t n_pair = 0u;
+	size_t n_frame = 0u;
+	size_t n_ch = 0u;
+	size_t offset = 0u;
+
+	this->fdl_pos = (this->fdl_pos + 1u)%(this->MAX_PARTITIONS);
+
+	offset = this->FFT_SIZE - this->BLOCK_FRAMES;
+
+	for(n_pair = 0u; n_pair < this->N_PAIRS; n_pair++)
+	{
+		p_wre = &(this->p_window_re[n_pair*(this->FFT_SIZE)]);
+		p_wim = &(this->p_window_im[n_pair*(this->FFT_SIZE)]);
+
+		/*Slide the window by one block, the new block goes at the end*/
+
+		memmove(p_wre, &p_wre[this->BLOCK_FRAMES], offset*sizeof(double));
+		memmove(p_wim, &p_wim[this->BLOCK_FRAMES], offset*sizeof(double));
+
+		n_ch = 2u*n_pair;
+
+		for(n_frame = 0u; n_frame < this->BLOCK_FRAMES; n_frame++)
+		{
+			p_wre[offset + n_frame] = p_in[n_frame*(this->N_CHANNELS) + n_ch];
+			p_wim[offset + n_frame] = ((n_ch + 1u) < this->N_CHANNELS) ? p_in[n_frame*(this->N_CHANNELS) + n_ch + 1u] : 0.0;
+		}
+
+		p_xre = &(this->p_fdl_re[(n_pair*(this->MAX_PARTITIONS) + this->fdl_pos)*(this->FFT_SIZE)]);
+		p_xim = &(this->p_fdl_im[(n_pair*(this->MAX_PARTITIONS) + this->fdl_pos)*(this->FFT_SIZE)]);
+
+		memcpy(p_xre, p_wre, (this->FFT_SIZE)*sizeof(double));
+		memcpy(p_xim, p_wim, (this->FFT_SIZE)*sizeof(double));
+
+		this->fft(p_xre, p_xim);
+	}
+
+	return;
+}
@@ -0,0 +1,108 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef FFTCONVOLVER_HPP
+#define FFTCONVOLVER_HPP
+
+#include "globldef.h"
+
+/*
+ * FFTConvolver is a uniformly partitioned overlap-save FFT convolution engine (real impulse response, any number of channels).
+ *
+ * The impulse response is split into partitions of BLOCK_FRAMES frames, each one transformed once (setImpulseResponse()).
+ * Every block of input is transformed once as well (FFT_SIZE frames window: the newest BLOCK_FRAMES frames and the ones before them)
+ * and kept in a frequency domain delay line. The output block is the inverse transform of the sum of (input spectrum p blocks ago)*(partition p spectrum),
+ * last BLOCK_FRAMES frames of it. Partitions that are all zeros are skipped, so a sparse impulse response only costs as many
+ * spectrum products as it has non zero partitions. The cost per block doesn't depend on how many taps a partition holds.
+ *
+ * FFT_SIZE is the power of 2 at or above 2*BLOCK_FRAMES (any block size works, it doesn't need to be a power of 2).
+ * Channels are processed in pairs: one channel in the real part, the next one in the imaginary part of the same complex transform
+ * (the impulse response is real, so both come out of the same convolution without mixing). An odd last channel has a zero imaginary part.
+ *
+ * Samples are interleaved doubles (BLOCK_FRAMES*n_channels per block), in whatever scale the caller uses.
+ *
+ * initialize(): allocates everything for impulse responses up to max_ir_frames frames.
+ * setImpulseResponse(): transforms a new impulse response (ir_frames <= max_ir_frames). Returns the number of non zero partitions.
+ * The input history (delay line) is kept: if the new response is longer, reset() and push() the older input again.
+ * reset(): clears the input history (silence).
+ * push(): feeds one block of input, no output (priming the delay line).
+ * process(): feeds one block of input, writes one block of output (p_out may not be p_in).
+ * getHistoryFrames(): how many input frames before the current block the output depends on (delay line priming length).
+ *
+ * Only one thread may use a FFTConvolver object.
+ */
+
+class FFTConvolver {
+	public:
+		FFTConvolver(void);
+		~FFTConvolver(void);
+
+		bool initialize(size_t block_frames, size_t n_channels, size_t max_ir_frames);
+		void deinitialize(void);
+
+		size_t setImpulseResponse(const double *p_ir, size_t ir_frames);
+		void reset(void);
+		void push(const double *p_in);
+		void process(const double *p_in, double *p_out);
+
+		size_t getHistoryFrames(void);
+		size_t getBlockFrames(void);
+		size_t getFFTSize(void);
+		size_t getActivePartitions(void);
+
+		/*
+		 * estimateCost: rough cost of one block, in units of one direct form tap on one sample (SIMD integer kernels).
+		 * Used to decide whether the FFT engine is cheaper than the direct form. n_active: non zero partitions.
+		 */
+
+		double estimateCost(size_t n_active);
+
+	private:
+		size_t BLOCK_FRAMES = 0u;
+		size_t FFT_SIZE = 0u;
+		size_t FFT_LOG2 = 0u;
+		size_t N_CHANNELS = 0u;
+		size_t N_PAIRS = 0u;
+		size_t MAX_PARTITIONS = 0u;
+
+		size_t n_partitions = 0u;
+		size_t n_active = 0u;
+		size_t *p_active = NULL; /*Non zero partition indexes*/
+
+		/*
+		 * Twiddle factors: exp(-2*pi*i*k/FFT_SIZE), k < FFT_SIZE/2. p_bitrev: bit reversed index of each FFT_SIZE index.
+		 * Complex arrays are split: real parts and imaginary parts in separate arrays.
+		 */
+
+		double *p_twiddle_re = NULL;
+		double *p_twiddle_im = NULL;
+		size_t *p_bitrev = NULL;
+
+		double *p_ir_re = NULL; /*MAX_PARTITIONS spectra*/
+		double *p_ir_im = NULL;
+
+		/*
+		 * Frequency domain delay line: MAX_PARTITIONS input spectra per channel pair, used as a ring. fdl_pos is the newest one.
+		 * p_window: FFT_SIZE frames input window per channel pair (time domain), newest block at the end.
+		 */
+
+		double *p_fdl_re = NULL;
+		double *p_fdl_im = NULL;
+		size_t fdl_pos = 0u;
+
+		double *p_window_re = NULL;
+		double *p_window_im = NULL;
+
+		double *p_acc_re = NULL;
+		double *p_acc_im = NULL;
+
+		void fft(double *p_re, double *p_im);
+		void block_input(const double *p_in);
+};
+
+#endif /*FFTCONVOLVER_HPP*/
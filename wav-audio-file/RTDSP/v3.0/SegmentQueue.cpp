@@ -0,0 +1,154 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#include "SegmentQueue.hpp"
+
+#include <stdlib.h>
+#include <errno.h>
+
+SegmentQueue::SegmentQueue(void)
+{
+}
+
+SegmentQueue::~SegmentQueue(void)
+{
+	this->deinitialize();
+}
+
+bool SegmentQueue::initialize(size_t capacity)
+{
+	this->deinitialize(); /*Clear any previous allocations*/
+
+	if(!capacity) return false;
+
+	/*One ring slot is always left empty to tell a full queue apart from an empty one*/
+	this->RING_SIZE = capacity + 1u;
+
+	this->p_ring = (size_t*) malloc(this->RING_SIZE*sizeof(size_t));
+	if(this->p_ring == NULL)
+	{
+		this->RING_SIZE = 0u;
+		return false;
+	}
+
+	if(sem_init(&(this->sem_count), 0, 0u) < 0)
+	{
+		this->deinitialize();
+		return false;
+	}
+
+	this->sem_ready = true;
+
+	this->head.store(0u, std::memory_order_relaxed);
+	this->tail.store(0u, std::memory_order_relaxed);
+
+	return true;
+}
+
+void SegmentQueue::deinitialize(void)
+{
+	if(this->sem_ready)
+	{
+		sem_destroy(&(this->sem_count));
+		this->sem_ready = false;
+	}
+
+	if(this->p_ring != NULL)
+	{
+		free(this->p_ring);
+		this->p_ring = NULL;
+	}
+
+	this->RING_SIZE = 0u;
+	return;
+}
+
+void SegmentQueue::reset(void)
+{
+	/*Must not be called while producer or consumer threads are running*/
+
+	if(!this->sem_ready) return;
+
+	while(sem_trywait(&(this->sem_count)) == 0);
+
+	this->head.store(0u, std::memory_order_relaxed);
+	this->tail.store(0u, std::memory_order_relaxed);
+
+	return;
+}
+
+bool SegmentQueue::push(size_t n_seg)
+{
+	size_t head = 0u;
+	size_t next = 0u;
+
+	if(!this->sem_ready) return false;
+
+	head = this->head.load(std::memory_order_relaxed);
+	next = (head + 1u)%(this->RING_SIZE);
+
+	if(next == this->tail.load(std::memory_order_acquire)) return false; /*Queue is full*/
+
+	this->p_ring[head] = n_seg;
+	this->head.store(next, std::memory_order_release);
+
+	sem_post(&(this->sem_count));
+	return true;
+}
+
+bool SegmentQueue::pop(size_t *p_nseg)
+{
+	size_t tail = 0u;
+
+	if(!this->sem_ready) return false;
+	if(p_nseg == NULL) return false;
+
+	if(sem_trywait(&(this->sem_count)) < 0) return false; /*Queue is empty*/
+
+	tail = this->tail.load(std::memory_order_relaxed);
+
+	*p_nseg = this->p_ring[tail];
+	this->tail.store((tail + 1u)%(this->RING_SIZE), std::memory_order_release);
+
+	return true;
+}
+
+bool SegmentQueue::wait_pop(size_t *p_nseg)
+{
+	size_t tail = 0u;
+
+	if(!this->sem_ready) return false;
+	if(p_nseg == NULL) return false;
+
+	while(sem_wait(&(this->sem_count)) < 0) if(errno != EINTR) return false;
+
+	/*
+	 * The semaphore count is only raised after the producer has published the new head,
+	 * so there is always an element available at this point.
+	 */
+
+	tail = this->tail.load(std::memory_order_relaxed);
+
+	*p_nseg = this->p_ring[tail];
+	this->tail.store((tail + 1u)%(this->RING_SIZE), std::memory_order_release);
+
+	return true;
+}
+
+size_t SegmentQueue::getCount(void)
+{
+	size_t head = 0u;
+	size_t tail = 0u;
+
+	if(!this->RING_SIZE) return 0u;
+
+	head = this->head.load(std::memory_order_acquire);
+	tail = this->tail.load(std::memory_order_acquire);
+
+	return (head + this->RING_SIZE - tail)%(this->RING_SIZE);
+}
@@ -0,0 +1,56 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef SEGMENTQUEUE_HPP
+#define SEGMENTQUEUE_HPP
+
+#include "globldef.h"
+
+#include <atomic>
+#include <semaphore.h>
+
+/*
+ * SegmentQueue is a lock-free single producer/single consumer queue of buffer segment indexes.
+ * It is used to hand buffer segments between the long-lived load thread and the long-lived play thread.
+ *
+ * Only one thread may call push() and only one (other) thread may call pop()/wait_pop().
+ * The queue itself never locks. wait_pop() blocks on a semaphore only when the queue is empty,
+ * push() never blocks (it fails if the queue is full).
+ *
+ * SEGMENTQUEUE_EOS can be pushed by the producer to tell the consumer there are no more segments.
+ */
+
+#define SEGMENTQUEUE_EOS ((size_t) -1)
+
+class SegmentQueue {
+	public:
+		SegmentQueue(void);
+		~SegmentQueue(void);
+
+		bool initialize(size_t capacity);
+		void deinitialize(void);
+		void reset(void);
+
+		bool push(size_t n_seg);
+		bool pop(size_t *p_nseg);
+		bool wait_pop(size_t *p_nseg);
+
+		size_t getCount(void);
+
+	private:
+		size_t *p_ring = NULL;
+		size_t RING_SIZE = 0u;
+
+		alignas(64) std::atomic<size_t> head{0u}; /*Written by producer only*/
+		alignas(64) std::atomic<size_t> tail{0u}; /*Written by consumer only*/
+
+		sem_t sem_count;
+		bool sem_ready = false;
+};
+
+#endif /*SEGMENTQUEUE_HPP*/
@@ -0,0 +1,299 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#include "UringReader.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define URINGREADER_ENABLED
+#endif
+
+UringReader::UringReader(void)
+{
+}
+
+UringReader::~UringReader(void)
+{
+	this->deinitialize();
+}
+
+#ifdef URINGREADER_ENABLED
+
+/*
+ * The ring head/tail indexes are shared with the kernel.
+ * The kernel writes sq_head and cq_tail, we write sq_tail and cq_head.
+ */
+
+#define URING_LOAD_ACQUIRE(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define URING_STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+bool UringReader::initialize(int h_file, uint8_t **pp_buffers, size_t n_buffers, size_t buffer_size)
+{
+	struct io_uring_params params;
+	struct iovec *p_iovecs = NULL;
+	size_t n_buf = 0u;
+	int n_ret = 0;
+
+	this->deinitialize(); /*Clear any previous instances*/
+
+	if(h_file < 0) return false;
+	if(pp_buffers == NULL) return false;
+	if(!n_buffers || !buffer_size) return false;
+
+	memset(&params, 0, sizeof(struct io_uring_params));
+
+	n_ret = (int) syscall(__NR_io_uring_setup, (unsigned int) n_buffers, &params);
+	if(n_ret < 0) return false; /*ENOSYS: kernel without io_uring. EPERM: disabled by the system.*/
+
+	this->h_ring = n_ret;
+
+	/*MAP RINGS (submission queue, completion queue and submission queue entries)*/
+
+	this->SQRING_SIZE = params.sq_off.array + params.sq_entries*sizeof(uint32_t);
+	this->CQRING_SIZE = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+	this->SQES_SIZE = params.sq_entries*sizeof(struct io_uring_sqe);
+
+	this->p_sqring = mmap(NULL, this->SQRING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->h_ring, IORING_OFF_SQ_RING);
+	if(this->p_sqring == MAP_FAILED)
+	{
+		this->p_sqring = NULL;
+		this->deinitialize();
+		return false;
+	}
+
+	this->p_cqring = mmap(NULL, this->CQRING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->h_ring, IORING_OFF_CQ_RING);
+	if(this->p_cqring == MAP_FAILED)
+	{
+		this->p_cqring = NULL;
+		this->deinitialize();
+		return false;
+	}
+
+	this->p_sqes = mmap(NULL, this->SQES_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->h_ring, IORING_OFF_SQES);
+	if(this->p_sqes == MAP_FAILED)
+	{
+		this->p_sqes = NULL;
+		this->deinitialize();
+		return false;
+	}
+
+	this->p_sq_head = (uint32_t*) (((size_t) this->p_sqring) + params.sq_off.head);
+	this->p_sq_tail = (uint32_t*) (((size_t) this->p_sqring) + params.sq_off.tail);
+	this->p_sq_array = (uint32_t*) (((size_t) this->p_sqring) + params.sq_off.array);
+	this->SQ_MASK = *((uint32_t*) (((size_t) this->p_sqring) + params.sq_off.ring_mask));
+
+	this->p_cq_head = (uint32_t*) (((size_t) this->p_cqring) + params.cq_off.head);
+	this->p_cq_tail = (uint32_t*) (((size_t) this->p_cqring) + params.cq_off.tail);
+	this->p_cqes = (void*) (((size_t) this->p_cqring) + params.cq_off.cqes);
+	this->CQ_MASK = *((uint32_t*) (((size_t) this->p_cqring) + params.cq_off.ring_mask));
+
+	/*REGISTER BUFFERS AND FILE. Not fatal if refused.*/
+
+	p_iovecs = (struct iovec*) malloc(n_buffers*sizeof(struct iovec));
+	if(p_iovecs != NULL)
+	{
+		for(n_buf = 0u; n_buf < n_buffers; n_buf++)
+		{
+			p_iovecs[n_buf].iov_base = (void*) pp_buffers[n_buf];
+			p_iovecs[n_buf].iov_len = buffer_size;
+		}
+
+		this->FIXED_BUFFERS = (syscall(__NR_io_uring_register, this->h_ring, IORING_REGISTER_BUFFERS, p_iovecs, (unsigned int) n_buffers) == 0);
+
+		free(p_iovecs);
+	}
+
+	this->FIXED_FILE = (syscall(__NR_io_uring_register, this->h_ring, IORING_REGISTER_FILES, &h_file, 1u) == 0);
+
+	this->h_file = h_file;
+	this->pp_buffers = pp_buffers;
+	this->N_BUFFERS = n_buffers;
+	this->BUFFER_SIZE = buffer_size;
+	this->n_inflight = 0u;
+
+	return true;
+}
+
+bool UringReader::deinitialize(void)
+{
+	size_t n_buf = 0u;
+	ssize_t n_result = 0;
+	bool drained = true;
+
+	/*
+	 * Closing the ring unregisters buffers and file, but ring teardown is asynchronous: a read still in flight could land in a buffer
+	 * after it's been freed. Reap every completion first.
+	 */
+
+	while(this->n_inflight)
+	{
+		if(!this->wait(&n_buf, &n_result))
+		{
+			drained = false;
+			break;
+		}
+	}
+
+	if(this->p_sqes != NULL)
+	{
+		munmap(this->p_sqes, this->SQES_SIZE);
+		this->p_sqes = NULL;
+	}
+
+	if(this->p_cqring != NULL)
+	{
+		munmap(this->p_cqring, this->CQRING_SIZE);
+		this->p_cqring = NULL;
+	}
+
+	if(this->p_sqring != NULL)
+	{
+		munmap(this->p_sqring, this->SQRING_SIZE);
+		this->p_sqring = NULL;
+	}
+
+	if(this->h_ring >= 0)
+	{
+		close(this->h_ring);
+		this->h_ring = -1;
+	}
+
+	this->h_file = -1;
+	this->pp_buffers = NULL;
+	this->N_BUFFERS = 0u;
+	this->BUFFER_SIZE = 0u;
+	this->n_inflight = 0u;
+
+	this->FIXED_BUFFERS = false;
+	this->FIXED_FILE = false;
+
+	return drained;
+}
+
+bool UringReader::submit(size_t n_buf, __offset offset, size_t n_bytes)
+{
+	struct io_uring_sqe *p_sqe = NULL;
+	uint32_t tail = 0u;
+	uint32_t index = 0u;
+	int n_ret = 0;
+
+	if(this->h_ring < 0) return false;
+	if(n_buf >= this->N_BUFFERS) return false;
+	if(this->n_inflight >= this->N_BUFFERS) return false;
+
+	if(n_bytes > this->BUFFER_SIZE) n_bytes = this->BUFFER_SIZE;
+
+	tail = *(this->p_sq_tail);
+	index = tail & (this->SQ_MASK);
+
+	p_sqe = &(((struct io_uring_sqe*) this->p_sqes)[index]);
+	memset(p_sqe, 0, sizeof(struct io_uring_sqe));
+
+	if(this->FIXED_BUFFERS)
+	{
+		p_sqe->opcode = IORING_OP_READ_FIXED;
+		p_sqe->buf_index = (uint16_t) n_buf;
+	}
+	else p_sqe->opcode = IORING_OP_READ;
+
+	if(this->FIXED_FILE)
+	{
+		p_sqe->fd = 0; /*Index in the registered file table*/
+		p_sqe->flags = IOSQE_FIXED_FILE;
+	}
+	else p_sqe->fd = this->h_file;
+
+	p_sqe->off = (uint64_t) offset;
+	p_sqe->addr = (uint64_t) (size_t) this->pp_buffers[n_buf];
+	p_sqe->len = (uint32_t) n_bytes;
+	p_sqe->user_data = (uint64_t) n_buf;
+
+	this->p_sq_array[index] = index;
+	URING_STORE_RELEASE(this->p_sq_tail, tail + 1u);
+
+	do n_ret = (int) syscall(__NR_io_uring_enter, this->h_ring, 1u, 0u, 0u, NULL, 0u);
+	while((n_ret < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+	if(n_ret < 1) return false;
+
+	this->n_inflight++;
+	return true;
+}
+
+bool UringReader::wait(size_t *p_nbuf, ssize_t *p_result)
+{
+	struct io_uring_cqe *p_cqe = NULL;
+	uint32_t head = 0u;
+	int n_ret = 0;
+
+	if(this->h_ring < 0) return false;
+	if((p_nbuf == NULL) || (p_result == NULL)) return false;
+	if(!this->n_inflight) return false; /*Nothing to wait for*/
+
+	head = *(this->p_cq_head);
+
+	while(head == URING_LOAD_ACQUIRE(this->p_cq_tail))
+	{
+		n_ret = (int) syscall(__NR_io_uring_enter, this->h_ring, 0u, 1u, IORING_ENTER_GETEVENTS, NULL, 0u);
+		if((n_ret < 0) && (errno != EINTR)) return false;
+	}
+
+	p_cqe = &(((struct io_uring_cqe*) this->p_cqes)[head & (this->CQ_MASK)]);
+
+	*p_nbuf = (size_t) p_cqe->user_data;
+	*p_result = (ssize_t) p_cqe->res;
+
+	URING_STORE_RELEASE(this->p_cq_head, head + 1u);
+
+	this->n_inflight--;
+	return true;
+}
+
+#else /*URINGREADER_ENABLED*/
+
+/*Built without io_uring support: initialize() always fails, callers use pread()*/
+
+bool UringReader::initialize(int h_file, uint8_t **pp_buffers, size_t n_buffers, size_t buffer_size)
+{
+	return false;
+}
+
+bool UringReader::deinitialize(void)
+{
+	return true;
+}
+
+bool UringReader::submit(size_t n_buf, __offset offset, size_t n_bytes)
+{
+	return false;
+}
+
+bool UringReader::wait(size_t *p_nbuf, ssize_t *p_result)
+{
+	return false;
+}
+
+#endif /*URINGREADER_ENABLED*/
+
+bool UringReader::fixedBuffers(void)
+{
+	return this->FIXED_BUFFERS;
+}
+
+bool UringReader::fixedFile(void)
+{
+	return this->FIXED_FILE;
+}
@@ -0,0 +1,80 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef URINGREADER_HPP
+#define URINGREADER_HPP
+
+#include "globldef.h"
+#include "filedef.h"
+
+/*
+ * UringReader is a minimal io_uring file reader (raw system calls, no liburing needed).
+ * It keeps up to n_buffers reads in flight, one per buffer.
+ *
+ * The buffers are registered with the kernel (fixed buffers) and so is the file (fixed file), so the kernel doesn't need to
+ * map the buffers and look up the file for every read. If registration is refused (e.g. RLIMIT_MEMLOCK too low), plain io_uring reads are used instead.
+ *
+ * initialize() returns false if io_uring is not available (old kernel, disabled by the system, or built without io_uring headers).
+ * The caller should fall back to pread() in that case.
+ *
+ * submit(): queues a read of n_bytes at offset into buffer n_buf. The buffer must not have a read in flight already.
+ * wait(): waits for any read to complete. Returns the buffer index and the read result (bytes read, or -errno).
+ * deinitialize(): waits for the reads still in flight, then closes the ring. Returns false if some of them could not be reaped:
+ * the kernel may still write into those buffers, so they must not be freed.
+ * Reads may complete in any order, and may be short.
+ *
+ * Only one thread may use a UringReader object.
+ */
+
+class UringReader {
+	public:
+		UringReader(void);
+		~UringReader(void);
+
+		bool initialize(int h_file, uint8_t **pp_buffers, size_t n_buffers, size_t buffer_size);
+		bool deinitialize(void);
+
+		bool submit(size_t n_buf, __offset offset, size_t n_bytes);
+		bool wait(size_t *p_nbuf, ssize_t *p_result);
+
+		bool fixedBuffers(void);
+		bool fixedFile(void);
+
+	private:
+		int h_ring = -1;
+		int h_file = -1;
+
+		uint8_t **pp_buffers = NULL;
+		size_t N_BUFFERS = 0u;
+		size_t BUFFER_SIZE = 0u;
+
+		void *p_sqring = NULL;
+		void *p_cqring = NULL;
+		void *p_sqes = NULL;
+
+		size_t SQRING_SIZE = 0u;
+		size_t CQRING_SIZE = 0u;
+		size_t SQES_SIZE = 0u;
+
+		uint32_t *p_sq_head = NULL;
+		uint32_t *p_sq_tail = NULL;
+		uint32_t *p_sq_array = NULL;
+		uint32_t SQ_MASK = 0u;
+
+		uint32_t *p_cq_head = NULL;
+		uint32_t *p_cq_tail = NULL;
+		void *p_cqes = NULL;
+		uint32_t CQ_MASK = 0u;
+
+		size_t n_inflight = 0u;
+
+		bool FIXED_BUFFERS = false;
+		bool FIXED_FILE = false;
+};
+
+#endif /*URINGREADER_HPP*/
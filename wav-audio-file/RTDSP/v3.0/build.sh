@@ -6,9 +6,14 @@ g++ cstrdef.c -c -o cstrdef.o
 g++ strdef.cpp -c -o strdef.o
 g++ cppthread.cpp -c -o cppthread.o
 g++ main.cpp -c -o main.o
+g++ SegmentQueue.cpp -c -o SegmentQueue.o
+g++ UringReader.cpp -c -o UringReader.o
+g++ dspkernel.cpp -c -o dspkernel.o
+g++ FFTConvolver.cpp -c -o FFTConvolver.o
 g++ AudioRTDSP.cpp -c -o AudioRTDSP.o
 g++ AudioRTDSP_i16.cpp -c -o AudioRTDSP_i16.o
 g++ AudioRTDSP_i24.cpp -c -o AudioRTDSP_i24.o
+g++ AudioRTDSP_f32.cpp -c -o AudioRTDSP_f32.o
 
 g++ *.o -lpthread -lasound -o rtdsp.elf
 
@@ -0,0 +1,1527 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#include "dspkernel.hpp"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSPKERNEL_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Float kernels must give the same output at every level: no fused multiply-add contraction
+ * (the avx512f target implies FMA, the other levels would round each multiply separately).
+ */
+
+#pragma GCC optimize("fp-contract=off")
+
+#define DSPKERNEL_I24_MAX_VALUE 0x7fffff
+#define DSPKERNEL_I24_MIN_VALUE (-0x800000)
+
+/*SCALAR*/
+
+static void dspkernel_load_i16_scalar(int32_t *p_acc, const int16_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_acc[n_sample] = (int32_t) p_src[n_sample];
+
+	return;
+}
+
+static void dspkernel_tap_i16_scalar(int32_t *p_acc, const int16_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	int32_t rounding = 0;
+
+	rounding = (int32_t) ((((uint32_t) 1u) << shift) >> 1);
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_acc[n_sample] += (((int32_t) p_src[n_sample])*gain + rounding) >> shift;
+
+	return;
+}
+
+static void dspkernel_tap_i32_scalar(int32_t *p_acc, const int32_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	int64_t rounding = 0;
+
+	rounding = (int64_t) ((((uint64_t) 1u) << shift) >> 1);
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_acc[n_sample] += (int32_t) ((((int64_t) p_src[n_sample])*((int64_t) gain) + rounding) >> shift);
+
+	return;
+}
+
+static void dspkernel_store_i16_scalar(int16_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	int32_t sample = 0;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		sample = p_acc[n_sample]/2;
+
+		if(sample > 32767) p_dst[n_sample] = (int16_t) 32767;
+		else if(sample < -32768) p_dst[n_sample] = (int16_t) -32768;
+		else p_dst[n_sample] = (int16_t) sample;
+	}
+
+	return;
+}
+
+static void dspkernel_store_i24_scalar(int32_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	int32_t sample = 0;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		sample = p_acc[n_sample]/2;
+
+		if(sample > DSPKERNEL_I24_MAX_VALUE) p_dst[n_sample] = DSPKERNEL_I24_MAX_VALUE;
+		else if(sample < DSPKERNEL_I24_MIN_VALUE) p_dst[n_sample] = DSPKERNEL_I24_MIN_VALUE;
+		else p_dst[n_sample] = sample;
+	}
+
+	return;
+}
+
+/*
+ * Float output helpers.
+ * store_f32 output range: [-2^(bits - 1), 2^(bits - 1) - 1]. For bits = 32 the upper bound is not a float, the biggest float below it is used.
+ * TPDF dither: the difference of two uniform random values (16 bits each, from one xorshift32 step), in (-1, 1) LSB.
+ */
+
+static void dspkernel_f32_range(uint32_t bits, float *p_scale, float *p_min, float *p_max)
+{
+	float full_scale = 0.0f;
+
+	full_scale = ldexpf(1.0f, (int) bits - 1);
+
+	*p_scale = 0.5f*full_scale; /*Same "/2" as the integer store kernels*/
+	*p_min = -full_scale;
+	*p_max = full_scale - 1.0f;
+
+	if(*p_max >= full_scale) *p_max = nextafterf(full_scale, 0.0f);
+
+	return;
+}
+
+static inline float dspkernel_dither_tpdf(uint32_t *p_state)
+{
+	uint32_t x = 0u;
+
+	x = *p_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*p_state = x;
+
+	return ((float) (((int32_t) (x & 0xffffu)) - ((int32_t) (x >> 16))))*(1.0f/65536.0f);
+}
+
+static void dspkernel_tap_f32_scalar(float *p_acc, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_acc[n_sample] += p_src[n_sample]*gain;
+
+	return;
+}
+
+static void dspkernel_store_f32_scalar(int32_t *p_dst, const float *p_acc, size_t n_samples, uint32_t bits, uint32_t *p_dither)
+{
+	size_t n_sample = 0u;
+	float scale = 0.0f;
+	float min = 0.0f;
+	float max = 0.0f;
+	float sample = 0.0f;
+
+	dspkernel_f32_range(bits, &scale, &min, &max);
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		sample = p_acc[n_sample]*scale;
+		if(p_dither != NULL) sample += dspkernel_dither_tpdf(&p_dither[n_sample%DSPKERNEL_DITHER_LANES]);
+
+		/*Same operand order as maxps/minps, so NaN gives the same result as the SIMD kernels*/
+
+		sample = (sample > min) ? sample : min;
+		sample = (sample < max) ? sample : max;
+
+		p_dst[n_sample] = (int32_t) lrintf(sample); /*Round to nearest even, like cvtps2dq*/
+	}
+
+	return;
+}
+
+static void dspkernel_comb_i16_scalar(int32_t *p_acc, int32_t *p_state, const int16_t *p_src, const int16_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	int32_t scale = 0;
+	int32_t rounding = 0;
+	int32_t rounding_old = 0;
+	int32_t state = 0;
+
+	scale = (int32_t) (((uint32_t) 1u) << frac_bits);
+	rounding = (int32_t) ((((uint32_t) 1u) << frac_bits) >> 1);
+	rounding_old = (int32_t) ((((uint32_t) 1u) << shift_old) >> 1);
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		state = (pol*(((int32_t) p_src[n_sample])*scale + p_state[n_sample])) >> 1;
+		state -= pol_old*((((int32_t) p_src_old[n_sample])*scale + rounding_old) >> shift_old);
+
+		p_state[n_sample] = state;
+		p_acc[n_sample] += (state + rounding) >> frac_bits;
+	}
+
+	return;
+}
+
+static void dspkernel_comb_i32_scalar(int32_t *p_acc, int32_t *p_state, const int32_t *p_src, const int32_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	int32_t scale = 0;
+	int32_t rounding = 0;
+	int32_t rounding_old = 0;
+	int32_t state = 0;
+
+	scale = (int32_t) (((uint32_t) 1u) << frac_bits);
+	rounding = (int32_t) ((((uint32_t) 1u) << frac_bits) >> 1);
+	rounding_old = (int32_t) ((((uint32_t) 1u) << shift_old) >> 1);
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		state = (pol*(p_src[n_sample]*scale + p_state[n_sample])) >> 1;
+		state -= pol_old*((p_src_old[n_sample]*scale + rounding_old) >> shift_old);
+
+		p_state[n_sample] = state;
+		p_acc[n_sample] += (state + rounding) >> frac_bits;
+	}
+
+	return;
+}
+
+static void dspkernel_comb_f32_scalar(float *p_acc, float *p_state, const float *p_src, const float *p_src_old, size_t n_samples, float gain, float gain_old)
+{
+	size_t n_sample = 0u;
+	float state = 0.0f;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		state = (p_src[n_sample] + p_state[n_sample])*gain - p_src_old[n_sample]*gain_old;
+
+		p_state[n_sample] = state;
+		p_acc[n_sample] += state;
+	}
+
+	return;
+}
+
+static void dspkernel_fbdelay_i16_scalar(int32_t *p_acc, float *p_state, const int16_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	float wet = 0.0f;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		wet = p_state[n_sample]*gain;
+
+		p_state[n_sample] = ((float) p_src[n_sample]) + wet;
+		p_acc[n_sample] += (int32_t) lrintf(wet); /*Round to nearest even, like cvtps2dq*/
+	}
+
+	return;
+}
+
+static void dspkernel_fbdelay_i32_scalar(int32_t *p_acc, float *p_state, const int32_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	float wet = 0.0f;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		wet = p_state[n_sample]*gain;
+
+		p_state[n_sample] = ((float) p_src[n_sample]) + wet;
+		p_acc[n_sample] += (int32_t) lrintf(wet);
+	}
+
+	return;
+}
+
+static void dspkernel_fbdelay_f32_scalar(float *p_acc, float *p_state, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	float wet = 0.0f;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		wet = p_state[n_sample]*gain;
+
+		p_state[n_sample] = p_src[n_sample] + wet;
+		p_acc[n_sample] += wet;
+	}
+
+	return;
+}
+
+#ifdef DSPKERNEL_X86
+
+/*
+ * SIMD kernels are built with function level target attributes, so the rest of the application doesn't need any special compiler flags.
+ * They're only called if dspkernel_get_max_level() says the CPU supports them.
+ * Remaining samples (less than one vector) are handled by the scalar kernels.
+ *
+ * "/2" must truncate towards zero (same as C integer division): (x + (x < 0)) >> 1
+ */
+
+/*SSE2: 8 samples (16bit) or 4 samples (24bit) per instruction*/
+
+__attribute__((target("sse2"))) static void dspkernel_load_i16_sse2(int32_t *p_acc, const int16_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128i v_src;
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm_loadu_si128((const __m128i*) &p_src[n_sample]);
+
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_srai_epi32(_mm_unpacklo_epi16(v_src, v_src), 16));
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample + 4u], _mm_srai_epi32(_mm_unpackhi_epi16(v_src, v_src), 16));
+	}
+
+	dspkernel_load_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_tap_i16_sse2(int32_t *p_acc, const int16_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	int32_t rounding = 0;
+	__m128i v_src, v_lo, v_hi;
+	__m128i v_one, v_gainround, v_shift;
+
+	rounding = (int32_t) ((((uint32_t) 1u) << shift) >> 1);
+
+	/*
+	 * Each sample is interleaved with 1, and pmaddwd multiplies the pair by (gain, rounding):
+	 * sample*gain + 1*rounding, as a 32bit result.
+	 */
+
+	v_one = _mm_set1_epi16(1);
+	v_gainround = _mm_set1_epi32((int32_t) ((((uint32_t) ((uint16_t) rounding)) << 16) | ((uint32_t) ((uint16_t) gain))));
+	v_shift = _mm_cvtsi32_si128((int) shift);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm_loadu_si128((const __m128i*) &p_src[n_sample]);
+
+		v_lo = _mm_sra_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v_src, v_one), v_gainround), v_shift);
+		v_hi = _mm_sra_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(v_src, v_one), v_gainround), v_shift);
+
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), v_lo));
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample + 4u], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample + 4u]), v_hi));
+	}
+
+	dspkernel_tap_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_tap_i32_sse2(int32_t *p_acc, const int32_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	int64_t rounding = 0;
+	__m128i v_src, v_even, v_odd, v_corr;
+	__m128i v_gain, v_round, v_shift, v_mask_lo, v_mask_hi;
+
+	rounding = (int64_t) ((((uint64_t) 1u) << shift) >> 1);
+
+	v_gain = _mm_set1_epi32(gain);
+	v_round = _mm_set1_epi64x((long long) rounding);
+	v_shift = _mm_cvtsi32_si128((int) shift);
+	v_mask_lo = _mm_set1_epi64x((long long) 0x00000000ffffffffull);
+	v_mask_hi = _mm_set1_epi64x((long long) 0xffffffff00000000ull);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_src = _mm_loadu_si128((const __m128i*) &p_src[n_sample]);
+
+		/*
+		 * SSE2 only has an unsigned 32x32 -> 64 multiply (even lanes only).
+		 * Signed product (mod 2^64) = unsigned product - ((sample < 0 ? gain : 0) + (gain < 0 ? sample : 0)) << 32
+		 */
+
+		v_even = _mm_mul_epu32(v_src, v_gain);
+		v_odd = _mm_mul_epu32(_mm_srli_epi64(v_src, 32), v_gain);
+
+		v_corr = _mm_and_si128(_mm_srai_epi32(v_src, 31), v_gain);
+		if(gain < 0) v_corr = _mm_add_epi32(v_corr, v_src);
+
+		v_even = _mm_sub_epi64(v_even, _mm_slli_epi64(v_corr, 32));
+		v_odd = _mm_sub_epi64(v_odd, _mm_and_si128(v_corr, v_mask_hi));
+
+		/*
+		 * There's no 64bit arithmetic shift. Since shift <= 32, the low 32 bits of a logical shift are the same as
+		 * the low 32 bits of an arithmetic shift, and those are the only bits kept.
+		 */
+
+		v_even = _mm_srl_epi64(_mm_add_epi64(v_even, v_round), v_shift);
+		v_odd = _mm_srl_epi64(_mm_add_epi64(v_odd, v_round), v_shift);
+
+		v_even = _mm_or_si128(_mm_and_si128(v_even, v_mask_lo), _mm_slli_epi64(v_odd, 32));
+
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), v_even));
+	}
+
+	dspkernel_tap_i32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_store_i16_sse2(int16_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128i v_lo, v_hi;
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_lo = _mm_loadu_si128((const __m128i*) &p_acc[n_sample]);
+		v_hi = _mm_loadu_si128((const __m128i*) &p_acc[n_sample + 4u]);
+
+		v_lo = _mm_srai_epi32(_mm_add_epi32(v_lo, _mm_srli_epi32(v_lo, 31)), 1);
+		v_hi = _mm_srai_epi32(_mm_add_epi32(v_hi, _mm_srli_epi32(v_hi, 31)), 1);
+
+		_mm_storeu_si128((__m128i*) &p_dst[n_sample], _mm_packs_epi32(v_lo, v_hi)); /*Saturating pack does the clamp*/
+	}
+
+	dspkernel_store_i16_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_store_i24_sse2(int32_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128i v_sample, v_mask;
+	__m128i v_max, v_min;
+
+	v_max = _mm_set1_epi32(DSPKERNEL_I24_MAX_VALUE);
+	v_min = _mm_set1_epi32(DSPKERNEL_I24_MIN_VALUE);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_sample = _mm_loadu_si128((const __m128i*) &p_acc[n_sample]);
+		v_sample = _mm_srai_epi32(_mm_add_epi32(v_sample, _mm_srli_epi32(v_sample, 31)), 1);
+
+		/*No 32bit min/max in SSE2: compare and select*/
+
+		v_mask = _mm_cmpgt_epi32(v_sample, v_max);
+		v_sample = _mm_or_si128(_mm_and_si128(v_mask, v_max), _mm_andnot_si128(v_mask, v_sample));
+
+		v_mask = _mm_cmplt_epi32(v_sample, v_min);
+		v_sample = _mm_or_si128(_mm_and_si128(v_mask, v_min), _mm_andnot_si128(v_mask, v_sample));
+
+		_mm_storeu_si128((__m128i*) &p_dst[n_sample], v_sample);
+	}
+
+	dspkernel_store_i24_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_tap_f32_sse2(float *p_acc, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128 v_gain;
+
+	v_gain = _mm_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+		_mm_storeu_ps(&p_acc[n_sample], _mm_add_ps(_mm_loadu_ps(&p_acc[n_sample]), _mm_mul_ps(_mm_loadu_ps(&p_src[n_sample]), v_gain)));
+
+	dspkernel_tap_f32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_store_f32_sse2(int32_t *p_dst, const float *p_acc, size_t n_samples, uint32_t bits, uint32_t *p_dither)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	size_t n_half = 0u;
+	float scale = 0.0f;
+	float min = 0.0f;
+	float max = 0.0f;
+
+	__m128 v_sample;
+	__m128 v_scale, v_min, v_max, v_lsb;
+	__m128i v_state[2];
+	__m128i v_mask, v_noise;
+
+	dspkernel_f32_range(bits, &scale, &min, &max);
+
+	v_scale = _mm_set1_ps(scale);
+	v_min = _mm_set1_ps(min);
+	v_max = _mm_set1_ps(max);
+	v_lsb = _mm_set1_ps(1.0f/65536.0f);
+	v_mask = _mm_set1_epi32(0xffff);
+
+	v_state[0] = _mm_setzero_si128();
+	v_state[1] = _mm_setzero_si128();
+
+	if(p_dither != NULL)
+	{
+		v_state[0] = _mm_loadu_si128((const __m128i*) &p_dither[0]);
+		v_state[1] = _mm_loadu_si128((const __m128i*) &p_dither[4]);
+	}
+
+	/*8 samples (two vectors) per iteration: sample n always takes its noise from dither lane n%8, like the scalar kernel*/
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		for(n_half = 0u; n_half < 2u; n_half++)
+		{
+			v_sample = _mm_mul_ps(_mm_loadu_ps(&p_acc[n_sample + 4u*n_half]), v_scale);
+
+			if(p_dither != NULL)
+			{
+				v_state[n_half] = _mm_xor_si128(v_state[n_half], _mm_slli_epi32(v_state[n_half], 13));
+				v_state[n_half] = _mm_xor_si128(v_state[n_half], _mm_srli_epi32(v_state[n_half], 17));
+				v_state[n_half] = _mm_xor_si128(v_state[n_half], _mm_slli_epi32(v_state[n_half], 5));
+
+				v_noise = _mm_sub_epi32(_mm_and_si128(v_state[n_half], v_mask), _mm_srli_epi32(v_state[n_half], 16));
+				v_sample = _mm_add_ps(v_sample, _mm_mul_ps(_mm_cvtepi32_ps(v_noise), v_lsb));
+			}
+
+			v_sample = _mm_min_ps(_mm_max_ps(v_sample, v_min), v_max);
+
+			_mm_storeu_si128((__m128i*) &p_dst[n_sample + 4u*n_half], _mm_cvtps_epi32(v_sample));
+		}
+	}
+
+	if(p_dither != NULL)
+	{
+		_mm_storeu_si128((__m128i*) &p_dither[0], v_state[0]);
+		_mm_storeu_si128((__m128i*) &p_dither[4], v_state[1]);
+	}
+
+	dspkernel_store_f32_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample, bits, p_dither);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_comb_i16_sse2(int32_t *p_acc, int32_t *p_state, const int16_t *p_src, const int16_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128i v_src, v_old, v_state;
+	__m128i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_src = _mm_loadl_epi64((const __m128i*) &p_src[n_sample]);
+		v_src = _mm_srai_epi32(_mm_unpacklo_epi16(v_src, v_src), 16);
+		v_old = _mm_loadl_epi64((const __m128i*) &p_src_old[n_sample]);
+		v_old = _mm_srai_epi32(_mm_unpacklo_epi16(v_old, v_old), 16);
+
+		v_state = _mm_add_epi32(_mm_sll_epi32(v_src, v_frac), _mm_loadu_si128((const __m128i*) &p_state[n_sample]));
+		v_state = _mm_srai_epi32(_mm_sub_epi32(_mm_xor_si128(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm_sra_epi32(_mm_add_epi32(_mm_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm_sub_epi32(v_state, _mm_sub_epi32(_mm_xor_si128(v_old, v_pol_old), v_pol_old));
+
+		_mm_storeu_si128((__m128i*) &p_state[n_sample], v_state);
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), _mm_sra_epi32(_mm_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_comb_i32_sse2(int32_t *p_acc, int32_t *p_state, const int32_t *p_src, const int32_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128i v_src, v_old, v_state;
+	__m128i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_src = _mm_loadu_si128((const __m128i*) &p_src[n_sample]);
+		v_old = _mm_loadu_si128((const __m128i*) &p_src_old[n_sample]);
+
+		v_state = _mm_add_epi32(_mm_sll_epi32(v_src, v_frac), _mm_loadu_si128((const __m128i*) &p_state[n_sample]));
+		v_state = _mm_srai_epi32(_mm_sub_epi32(_mm_xor_si128(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm_sra_epi32(_mm_add_epi32(_mm_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm_sub_epi32(v_state, _mm_sub_epi32(_mm_xor_si128(v_old, v_pol_old), v_pol_old));
+
+		_mm_storeu_si128((__m128i*) &p_state[n_sample], v_state);
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), _mm_sra_epi32(_mm_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_comb_f32_sse2(float *p_acc, float *p_state, const float *p_src, const float *p_src_old, size_t n_samples, float gain, float gain_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128 v_state;
+	__m128 v_gain, v_gain_old;
+
+	v_gain = _mm_set1_ps(gain);
+	v_gain_old = _mm_set1_ps(gain_old);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_state = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&p_src[n_sample]), _mm_loadu_ps(&p_state[n_sample])), v_gain);
+		v_state = _mm_sub_ps(v_state, _mm_mul_ps(_mm_loadu_ps(&p_src_old[n_sample]), v_gain_old));
+
+		_mm_storeu_ps(&p_state[n_sample], v_state);
+		_mm_storeu_ps(&p_acc[n_sample], _mm_add_ps(_mm_loadu_ps(&p_acc[n_sample]), v_state));
+	}
+
+	dspkernel_comb_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, gain, gain_old);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_fbdelay_i16_sse2(int32_t *p_acc, float *p_state, const int16_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128 v_wet, v_gain;
+	__m128i v_src;
+
+	v_gain = _mm_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_src = _mm_loadl_epi64((const __m128i*) &p_src[n_sample]);
+		v_src = _mm_srai_epi32(_mm_unpacklo_epi16(v_src, v_src), 16);
+		v_wet = _mm_mul_ps(_mm_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm_storeu_ps(&p_state[n_sample], _mm_add_ps(_mm_cvtepi32_ps(v_src), v_wet));
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), _mm_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_fbdelay_i32_sse2(int32_t *p_acc, float *p_state, const int32_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128 v_wet, v_gain;
+	__m128i v_src;
+
+	v_gain = _mm_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_src = _mm_loadu_si128((const __m128i*) &p_src[n_sample]);
+		v_wet = _mm_mul_ps(_mm_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm_storeu_ps(&p_state[n_sample], _mm_add_ps(_mm_cvtepi32_ps(v_src), v_wet));
+		_mm_storeu_si128((__m128i*) &p_acc[n_sample], _mm_add_epi32(_mm_loadu_si128((const __m128i*) &p_acc[n_sample]), _mm_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("sse2"))) static void dspkernel_fbdelay_f32_sse2(float *p_acc, float *p_state, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m128 v_wet, v_gain;
+
+	v_gain = _mm_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_wet = _mm_mul_ps(_mm_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm_storeu_ps(&p_state[n_sample], _mm_add_ps(_mm_loadu_ps(&p_src[n_sample]), v_wet));
+		_mm_storeu_ps(&p_acc[n_sample], _mm_add_ps(_mm_loadu_ps(&p_acc[n_sample]), v_wet));
+	}
+
+	dspkernel_fbdelay_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+/*AVX2: 16 samples (16bit) or 8 samples (24bit) per instruction*/
+
+__attribute__((target("avx2"))) static void dspkernel_load_i16_avx2(int32_t *p_acc, const int16_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample])));
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample + 8u], _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample + 8u])));
+	}
+
+	dspkernel_load_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_tap_i16_avx2(int32_t *p_acc, const int16_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_lo, v_hi;
+	__m256i v_gain, v_round;
+	__m128i v_shift;
+
+	v_gain = _mm256_set1_epi32(gain);
+	v_round = _mm256_set1_epi32((int32_t) ((((uint32_t) 1u) << shift) >> 1));
+	v_shift = _mm_cvtsi32_si128((int) shift);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample]));
+		v_hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample + 8u]));
+
+		v_lo = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v_lo, v_gain), v_round), v_shift);
+		v_hi = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v_hi, v_gain), v_round), v_shift);
+
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), v_lo));
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample + 8u], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample + 8u]), v_hi));
+	}
+
+	dspkernel_tap_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_tap_i32_avx2(int32_t *p_acc, const int32_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	int64_t rounding = 0;
+	__m256i v_src, v_even, v_odd;
+	__m256i v_gain, v_round;
+	__m128i v_shift;
+
+	rounding = (int64_t) ((((uint64_t) 1u) << shift) >> 1);
+
+	v_gain = _mm256_set1_epi32(gain);
+	v_round = _mm256_set1_epi64x((long long) rounding);
+	v_shift = _mm_cvtsi32_si128((int) shift);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm256_loadu_si256((const __m256i*) &p_src[n_sample]);
+
+		/*Signed 32x32 -> 64 multiply, even lanes only. Shift <= 32, see dspkernel_tap_i32_sse2()*/
+
+		v_even = _mm256_mul_epi32(v_src, v_gain);
+		v_odd = _mm256_mul_epi32(_mm256_srli_epi64(v_src, 32), v_gain);
+
+		v_even = _mm256_srl_epi64(_mm256_add_epi64(v_even, v_round), v_shift);
+		v_odd = _mm256_srl_epi64(_mm256_add_epi64(v_odd, v_round), v_shift);
+
+		v_even = _mm256_blend_epi32(v_even, _mm256_slli_epi64(v_odd, 32), 0xaa);
+
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), v_even));
+	}
+
+	dspkernel_tap_i32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_store_i16_avx2(int16_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_lo, v_hi;
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_lo = _mm256_loadu_si256((const __m256i*) &p_acc[n_sample]);
+		v_hi = _mm256_loadu_si256((const __m256i*) &p_acc[n_sample + 8u]);
+
+		v_lo = _mm256_srai_epi32(_mm256_add_epi32(v_lo, _mm256_srli_epi32(v_lo, 31)), 1);
+		v_hi = _mm256_srai_epi32(_mm256_add_epi32(v_hi, _mm256_srli_epi32(v_hi, 31)), 1);
+
+		/*Saturating pack works within 128bit lanes, permute to get the samples back in order*/
+
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], _mm256_permute4x64_epi64(_mm256_packs_epi32(v_lo, v_hi), 0xd8));
+	}
+
+	dspkernel_store_i16_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_store_i24_avx2(int32_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_sample;
+	__m256i v_max, v_min;
+
+	v_max = _mm256_set1_epi32(DSPKERNEL_I24_MAX_VALUE);
+	v_min = _mm256_set1_epi32(DSPKERNEL_I24_MIN_VALUE);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_sample = _mm256_loadu_si256((const __m256i*) &p_acc[n_sample]);
+		v_sample = _mm256_srai_epi32(_mm256_add_epi32(v_sample, _mm256_srli_epi32(v_sample, 31)), 1);
+		v_sample = _mm256_min_epi32(_mm256_max_epi32(v_sample, v_min), v_max);
+
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], v_sample);
+	}
+
+	dspkernel_store_i24_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_tap_f32_avx2(float *p_acc, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256 v_gain;
+
+	v_gain = _mm256_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	/*No FMA: mul + add rounds the same way as the scalar kernel*/
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+		_mm256_storeu_ps(&p_acc[n_sample], _mm256_add_ps(_mm256_loadu_ps(&p_acc[n_sample]), _mm256_mul_ps(_mm256_loadu_ps(&p_src[n_sample]), v_gain)));
+
+	dspkernel_tap_f32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_store_f32_avx2(int32_t *p_dst, const float *p_acc, size_t n_samples, uint32_t bits, uint32_t *p_dither)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	float scale = 0.0f;
+	float min = 0.0f;
+	float max = 0.0f;
+
+	__m256 v_sample;
+	__m256 v_scale, v_min, v_max, v_lsb;
+	__m256i v_state, v_mask, v_noise;
+
+	dspkernel_f32_range(bits, &scale, &min, &max);
+
+	v_scale = _mm256_set1_ps(scale);
+	v_min = _mm256_set1_ps(min);
+	v_max = _mm256_set1_ps(max);
+	v_lsb = _mm256_set1_ps(1.0f/65536.0f);
+	v_mask = _mm256_set1_epi32(0xffff);
+
+	v_state = _mm256_setzero_si256();
+	if(p_dither != NULL) v_state = _mm256_loadu_si256((const __m256i*) p_dither);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_sample = _mm256_mul_ps(_mm256_loadu_ps(&p_acc[n_sample]), v_scale);
+
+		if(p_dither != NULL)
+		{
+			v_state = _mm256_xor_si256(v_state, _mm256_slli_epi32(v_state, 13));
+			v_state = _mm256_xor_si256(v_state, _mm256_srli_epi32(v_state, 17));
+			v_state = _mm256_xor_si256(v_state, _mm256_slli_epi32(v_state, 5));
+
+			v_noise = _mm256_sub_epi32(_mm256_and_si256(v_state, v_mask), _mm256_srli_epi32(v_state, 16));
+			v_sample = _mm256_add_ps(v_sample, _mm256_mul_ps(_mm256_cvtepi32_ps(v_noise), v_lsb));
+		}
+
+		v_sample = _mm256_min_ps(_mm256_max_ps(v_sample, v_min), v_max);
+
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], _mm256_cvtps_epi32(v_sample));
+	}
+
+	if(p_dither != NULL) _mm256_storeu_si256((__m256i*) p_dither, v_state);
+
+	dspkernel_store_f32_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample, bits, p_dither);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_comb_i16_avx2(int32_t *p_acc, int32_t *p_state, const int16_t *p_src, const int16_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_src, v_old, v_state;
+	__m256i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm256_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm256_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm256_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm256_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample]));
+		v_old = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src_old[n_sample]));
+
+		v_state = _mm256_add_epi32(_mm256_sll_epi32(v_src, v_frac), _mm256_loadu_si256((const __m256i*) &p_state[n_sample]));
+		v_state = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_xor_si256(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm256_sub_epi32(v_state, _mm256_sub_epi32(_mm256_xor_si256(v_old, v_pol_old), v_pol_old));
+
+		_mm256_storeu_si256((__m256i*) &p_state[n_sample], v_state);
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), _mm256_sra_epi32(_mm256_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_comb_i32_avx2(int32_t *p_acc, int32_t *p_state, const int32_t *p_src, const int32_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_src, v_old, v_state;
+	__m256i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm256_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm256_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm256_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm256_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm256_loadu_si256((const __m256i*) &p_src[n_sample]);
+		v_old = _mm256_loadu_si256((const __m256i*) &p_src_old[n_sample]);
+
+		v_state = _mm256_add_epi32(_mm256_sll_epi32(v_src, v_frac), _mm256_loadu_si256((const __m256i*) &p_state[n_sample]));
+		v_state = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_xor_si256(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm256_sub_epi32(v_state, _mm256_sub_epi32(_mm256_xor_si256(v_old, v_pol_old), v_pol_old));
+
+		_mm256_storeu_si256((__m256i*) &p_state[n_sample], v_state);
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), _mm256_sra_epi32(_mm256_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_comb_f32_avx2(float *p_acc, float *p_state, const float *p_src, const float *p_src_old, size_t n_samples, float gain, float gain_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256 v_state;
+	__m256 v_gain, v_gain_old;
+
+	v_gain = _mm256_set1_ps(gain);
+	v_gain_old = _mm256_set1_ps(gain_old);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_state = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(&p_src[n_sample]), _mm256_loadu_ps(&p_state[n_sample])), v_gain);
+		v_state = _mm256_sub_ps(v_state, _mm256_mul_ps(_mm256_loadu_ps(&p_src_old[n_sample]), v_gain_old));
+
+		_mm256_storeu_ps(&p_state[n_sample], v_state);
+		_mm256_storeu_ps(&p_acc[n_sample], _mm256_add_ps(_mm256_loadu_ps(&p_acc[n_sample]), v_state));
+	}
+
+	dspkernel_comb_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, gain, gain_old);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_fbdelay_i16_avx2(int32_t *p_acc, float *p_state, const int16_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256 v_wet, v_gain;
+	__m256i v_src;
+
+	v_gain = _mm256_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample]));
+		v_wet = _mm256_mul_ps(_mm256_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm256_storeu_ps(&p_state[n_sample], _mm256_add_ps(_mm256_cvtepi32_ps(v_src), v_wet));
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), _mm256_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_fbdelay_i32_avx2(int32_t *p_acc, float *p_state, const int32_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256 v_wet, v_gain;
+	__m256i v_src;
+
+	v_gain = _mm256_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_src = _mm256_loadu_si256((const __m256i*) &p_src[n_sample]);
+		v_wet = _mm256_mul_ps(_mm256_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm256_storeu_ps(&p_state[n_sample], _mm256_add_ps(_mm256_cvtepi32_ps(v_src), v_wet));
+		_mm256_storeu_si256((__m256i*) &p_acc[n_sample], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &p_acc[n_sample]), _mm256_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx2"))) static void dspkernel_fbdelay_f32_avx2(float *p_acc, float *p_state, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256 v_wet, v_gain;
+
+	v_gain = _mm256_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_wet = _mm256_mul_ps(_mm256_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm256_storeu_ps(&p_state[n_sample], _mm256_add_ps(_mm256_loadu_ps(&p_src[n_sample]), v_wet));
+		_mm256_storeu_ps(&p_acc[n_sample], _mm256_add_ps(_mm256_loadu_ps(&p_acc[n_sample]), v_wet));
+	}
+
+	dspkernel_fbdelay_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+/*AVX-512: 16 samples per instruction*/
+
+__attribute__((target("avx512f"))) static void dspkernel_load_i16_avx512(int32_t *p_acc, const int16_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample])));
+
+	dspkernel_load_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_tap_i16_avx512(int32_t *p_acc, const int16_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512i v_src;
+	__m512i v_gain, v_round;
+	__m128i v_shift;
+
+	v_gain = _mm512_set1_epi32(gain);
+	v_round = _mm512_set1_epi32((int32_t) ((((uint32_t) 1u) << shift) >> 1));
+	v_shift = _mm_cvtsi32_si128((int) shift);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]));
+		v_src = _mm512_sra_epi32(_mm512_add_epi32(_mm512_mullo_epi32(v_src, v_gain), v_round), v_shift);
+
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), v_src));
+	}
+
+	dspkernel_tap_i16_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_tap_i32_avx512(int32_t *p_acc, const int32_t *p_src, size_t n_samples, int32_t gain, uint32_t shift)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	int64_t rounding = 0;
+	__m512i v_src, v_even, v_odd;
+	__m512i v_gain, v_round;
+	__m128i v_shift;
+
+	rounding = (int64_t) ((((uint64_t) 1u) << shift) >> 1);
+
+	v_gain = _mm512_set1_epi32(gain);
+	v_round = _mm512_set1_epi64((long long) rounding);
+	v_shift = _mm_cvtsi32_si128((int) shift);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_loadu_si512((const void*) &p_src[n_sample]);
+
+		v_even = _mm512_mul_epi32(v_src, v_gain);
+		v_odd = _mm512_mul_epi32(_mm512_srli_epi64(v_src, 32), v_gain);
+
+		v_even = _mm512_srl_epi64(_mm512_add_epi64(v_even, v_round), v_shift);
+		v_odd = _mm512_srl_epi64(_mm512_add_epi64(v_odd, v_round), v_shift);
+
+		v_even = _mm512_mask_blend_epi32((__mmask16) 0xaaaa, v_even, _mm512_slli_epi64(v_odd, 32));
+
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), v_even));
+	}
+
+	dspkernel_tap_i32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain, shift);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_store_i16_avx512(int16_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512i v_sample;
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_sample = _mm512_loadu_si512((const void*) &p_acc[n_sample]);
+		v_sample = _mm512_srai_epi32(_mm512_add_epi32(v_sample, _mm512_srli_epi32(v_sample, 31)), 1);
+
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], _mm512_cvtsepi32_epi16(v_sample)); /*Saturating down convert does the clamp*/
+	}
+
+	dspkernel_store_i16_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_store_i24_avx512(int32_t *p_dst, const int32_t *p_acc, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512i v_sample;
+	__m512i v_max, v_min;
+
+	v_max = _mm512_set1_epi32(DSPKERNEL_I24_MAX_VALUE);
+	v_min = _mm512_set1_epi32(DSPKERNEL_I24_MIN_VALUE);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_sample = _mm512_loadu_si512((const void*) &p_acc[n_sample]);
+		v_sample = _mm512_srai_epi32(_mm512_add_epi32(v_sample, _mm512_srli_epi32(v_sample, 31)), 1);
+		v_sample = _mm512_min_epi32(_mm512_max_epi32(v_sample, v_min), v_max);
+
+		_mm512_storeu_si512((void*) &p_dst[n_sample], v_sample);
+	}
+
+	dspkernel_store_i24_scalar(&p_dst[n_sample], &p_acc[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_tap_f32_avx512(float *p_acc, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512 v_gain;
+
+	v_gain = _mm512_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+		_mm512_storeu_ps(&p_acc[n_sample], _mm512_add_ps(_mm512_loadu_ps(&p_acc[n_sample]), _mm512_mul_ps(_mm512_loadu_ps(&p_src[n_sample]), v_gain)));
+
+	dspkernel_tap_f32_scalar(&p_acc[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_comb_i16_avx512(int32_t *p_acc, int32_t *p_state, const int16_t *p_src, const int16_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512i v_src, v_old, v_state;
+	__m512i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm512_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm512_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm512_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm512_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]));
+		v_old = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) &p_src_old[n_sample]));
+
+		v_state = _mm512_add_epi32(_mm512_sll_epi32(v_src, v_frac), _mm512_loadu_si512((const void*) &p_state[n_sample]));
+		v_state = _mm512_srai_epi32(_mm512_sub_epi32(_mm512_xor_si512(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm512_sra_epi32(_mm512_add_epi32(_mm512_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm512_sub_epi32(v_state, _mm512_sub_epi32(_mm512_xor_si512(v_old, v_pol_old), v_pol_old));
+
+		_mm512_storeu_si512((void*) &p_state[n_sample], v_state);
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), _mm512_sra_epi32(_mm512_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_comb_i32_avx512(int32_t *p_acc, int32_t *p_state, const int32_t *p_src, const int32_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512i v_src, v_old, v_state;
+	__m512i v_pol, v_pol_old, v_round, v_round_old;
+	__m128i v_frac, v_shift_old;
+
+	/*Polarity as a sign mask: (x ^ mask) - mask is x*pol*/
+
+	v_pol = _mm512_set1_epi32((pol < 0) ? -1 : 0);
+	v_pol_old = _mm512_set1_epi32((pol_old < 0) ? -1 : 0);
+	v_round = _mm512_set1_epi32((int32_t) ((((uint32_t) 1u) << frac_bits) >> 1));
+	v_round_old = _mm512_set1_epi32((int32_t) ((((uint32_t) 1u) << shift_old) >> 1));
+	v_frac = _mm_cvtsi32_si128((int) frac_bits);
+	v_shift_old = _mm_cvtsi32_si128((int) shift_old);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_loadu_si512((const void*) &p_src[n_sample]);
+		v_old = _mm512_loadu_si512((const void*) &p_src_old[n_sample]);
+
+		v_state = _mm512_add_epi32(_mm512_sll_epi32(v_src, v_frac), _mm512_loadu_si512((const void*) &p_state[n_sample]));
+		v_state = _mm512_srai_epi32(_mm512_sub_epi32(_mm512_xor_si512(v_state, v_pol), v_pol), 1);
+
+		v_old = _mm512_sra_epi32(_mm512_add_epi32(_mm512_sll_epi32(v_old, v_frac), v_round_old), v_shift_old);
+		v_state = _mm512_sub_epi32(v_state, _mm512_sub_epi32(_mm512_xor_si512(v_old, v_pol_old), v_pol_old));
+
+		_mm512_storeu_si512((void*) &p_state[n_sample], v_state);
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), _mm512_sra_epi32(_mm512_add_epi32(v_state, v_round), v_frac)));
+	}
+
+	dspkernel_comb_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, pol, pol_old, frac_bits, shift_old);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_comb_f32_avx512(float *p_acc, float *p_state, const float *p_src, const float *p_src_old, size_t n_samples, float gain, float gain_old)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512 v_state;
+	__m512 v_gain, v_gain_old;
+
+	v_gain = _mm512_set1_ps(gain);
+	v_gain_old = _mm512_set1_ps(gain_old);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_state = _mm512_mul_ps(_mm512_add_ps(_mm512_loadu_ps(&p_src[n_sample]), _mm512_loadu_ps(&p_state[n_sample])), v_gain);
+		v_state = _mm512_sub_ps(v_state, _mm512_mul_ps(_mm512_loadu_ps(&p_src_old[n_sample]), v_gain_old));
+
+		_mm512_storeu_ps(&p_state[n_sample], v_state);
+		_mm512_storeu_ps(&p_acc[n_sample], _mm512_add_ps(_mm512_loadu_ps(&p_acc[n_sample]), v_state));
+	}
+
+	dspkernel_comb_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], &p_src_old[n_sample], n_samples - n_sample, gain, gain_old);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_fbdelay_i16_avx512(int32_t *p_acc, float *p_state, const int16_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512 v_wet, v_gain;
+	__m512i v_src;
+
+	v_gain = _mm512_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]));
+		v_wet = _mm512_mul_ps(_mm512_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm512_storeu_ps(&p_state[n_sample], _mm512_add_ps(_mm512_cvtepi32_ps(v_src), v_wet));
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), _mm512_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i16_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_fbdelay_i32_avx512(int32_t *p_acc, float *p_state, const int32_t *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512 v_wet, v_gain;
+	__m512i v_src;
+
+	v_gain = _mm512_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_src = _mm512_loadu_si512((const void*) &p_src[n_sample]);
+		v_wet = _mm512_mul_ps(_mm512_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm512_storeu_ps(&p_state[n_sample], _mm512_add_ps(_mm512_cvtepi32_ps(v_src), v_wet));
+		_mm512_storeu_si512((void*) &p_acc[n_sample], _mm512_add_epi32(_mm512_loadu_si512((const void*) &p_acc[n_sample]), _mm512_cvtps_epi32(v_wet)));
+	}
+
+	dspkernel_fbdelay_i32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+__attribute__((target("avx512f"))) static void dspkernel_fbdelay_f32_avx512(float *p_acc, float *p_state, const float *p_src, size_t n_samples, float gain)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m512 v_wet, v_gain;
+
+	v_gain = _mm512_set1_ps(gain);
+
+	n_vec = n_samples & ~((size_t) 15u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 16u)
+	{
+		v_wet = _mm512_mul_ps(_mm512_loadu_ps(&p_state[n_sample]), v_gain);
+
+		_mm512_storeu_ps(&p_state[n_sample], _mm512_add_ps(_mm512_loadu_ps(&p_src[n_sample]), v_wet));
+		_mm512_storeu_ps(&p_acc[n_sample], _mm512_add_ps(_mm512_loadu_ps(&p_acc[n_sample]), v_wet));
+	}
+
+	dspkernel_fbdelay_f32_scalar(&p_acc[n_sample], &p_state[n_sample], &p_src[n_sample], n_samples - n_sample, gain);
+	return;
+}
+
+#endif /*DSPKERNEL_X86*/
+
+static const dspkernel_t dspkernel_scalar = {
+	.level = DSPKERNEL_SCALAR,
+	.name = "scalar",
+	.load_i16 = dspkernel_load_i16_scalar,
+	.tap_i16 = dspkernel_tap_i16_scalar,
+	.tap_i32 = dspkernel_tap_i32_scalar,
+	.store_i16 = dspkernel_store_i16_scalar,
+	.store_i24 = dspkernel_store_i24_scalar,
+	.tap_f32 = dspkernel_tap_f32_scalar,
+	.store_f32 = dspkernel_store_f32_scalar,
+	.comb_i16 = dspkernel_comb_i16_scalar,
+	.comb_i32 = dspkernel_comb_i32_scalar,
+	.comb_f32 = dspkernel_comb_f32_scalar,
+	.fbdelay_i16 = dspkernel_fbdelay_i16_scalar,
+	.fbdelay_i32 = dspkernel_fbdelay_i32_scalar,
+	.fbdelay_f32 = dspkernel_fbdelay_f32_scalar
+};
+
+#ifdef DSPKERNEL_X86
+
+static const dspkernel_t dspkernel_sse2 = {
+	.level = DSPKERNEL_SSE2,
+	.name = "SSE2",
+	.load_i16 = dspkernel_load_i16_sse2,
+	.tap_i16 = dspkernel_tap_i16_sse2,
+	.tap_i32 = dspkernel_tap_i32_sse2,
+	.store_i16 = dspkernel_store_i16_sse2,
+	.store_i24 = dspkernel_store_i24_sse2,
+	.tap_f32 = dspkernel_tap_f32_sse2,
+	.store_f32 = dspkernel_store_f32_sse2,
+	.comb_i16 = dspkernel_comb_i16_sse2,
+	.comb_i32 = dspkernel_comb_i32_sse2,
+	.comb_f32 = dspkernel_comb_f32_sse2,
+	.fbdelay_i16 = dspkernel_fbdelay_i16_sse2,
+	.fbdelay_i32 = dspkernel_fbdelay_i32_sse2,
+	.fbdelay_f32 = dspkernel_fbdelay_f32_sse2
+};
+
+static const dspkernel_t dspkernel_avx2 = {
+	.level = DSPKERNEL_AVX2,
+	.name = "AVX2",
+	.load_i16 = dspkernel_load_i16_avx2,
+	.tap_i16 = dspkernel_tap_i16_avx2,
+	.tap_i32 = dspkernel_tap_i32_avx2,
+	.store_i16 = dspkernel_store_i16_avx2,
+	.store_i24 = dspkernel_store_i24_avx2,
+	.tap_f32 = dspkernel_tap_f32_avx2,
+	.store_f32 = dspkernel_store_f32_avx2,
+	.comb_i16 = dspkernel_comb_i16_avx2,
+	.comb_i32 = dspkernel_comb_i32_avx2,
+	.comb_f32 = dspkernel_comb_f32_avx2,
+	.fbdelay_i16 = dspkernel_fbdelay_i16_avx2,
+	.fbdelay_i32 = dspkernel_fbdelay_i32_avx2,
+	.fbdelay_f32 = dspkernel_fbdelay_f32_avx2
+};
+
+static const dspkernel_t dspkernel_avx512 = {
+	.level = DSPKERNEL_AVX512,
+	.name = "AVX-512",
+	.load_i16 = dspkernel_load_i16_avx512,
+	.tap_i16 = dspkernel_tap_i16_avx512,
+	.tap_i32 = dspkernel_tap_i32_avx512,
+	.store_i16 = dspkernel_store_i16_avx512,
+	.store_i24 = dspkernel_store_i24_avx512,
+	.tap_f32 = dspkernel_tap_f32_avx512,
+	.store_f32 = dspkernel_store_f32_avx2, /*Dither lanes are 8 wide, the AVX2 kernel is used*/
+	.comb_i16 = dspkernel_comb_i16_avx512,
+	.comb_i32 = dspkernel_comb_i32_avx512,
+	.comb_f32 = dspkernel_comb_f32_avx512,
+	.fbdelay_i16 = dspkernel_fbdelay_i16_avx512,
+	.fbdelay_i32 = dspkernel_fbdelay_i32_avx512,
+	.fbdelay_f32 = dspkernel_fbdelay_f32_avx512
+};
+
+#endif /*DSPKERNEL_X86*/
+
+int dspkernel_get_max_level(void)
+{
+#ifdef DSPKERNEL_X86
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx512f")) return DSPKERNEL_AVX512;
+	if(__builtin_cpu_supports("avx2")) return DSPKERNEL_AVX2;
+	if(__builtin_cpu_supports("sse2")) return DSPKERNEL_SSE2;
+#endif
+
+	return DSPKERNEL_SCALAR;
+}
+
+const dspkernel_t *dspkernel_select(int level)
+{
+	int max_level = 0;
+
+	max_level = dspkernel_get_max_level();
+
+	if((level <= DSPKERNEL_AUTO) || (level > max_level)) level = max_level;
+
+#ifdef DSPKERNEL_X86
+	switch(level)
+	{
+		case DSPKERNEL_AVX512:
+			return &dspkernel_avx512;
+
+		case DSPKERNEL_AVX2:
+			return &dspkernel_avx2;
+
+		case DSPKERNEL_SSE2:
+			return &dspkernel_sse2;
+	}
+#endif
+
+	return &dspkernel_scalar;
+}
+
+#ifdef DSPKERNEL_X86
+__attribute__((target("sse2"))) void dspkernel_denormals_off(void)
+{
+	_mm_setcsr(_mm_getcsr() | 0x8040u); /*FTZ (bit 15) and DAZ (bit 6)*/
+	return;
+}
+#else
+void dspkernel_denormals_off(void)
+{
+	return;
+}
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef DSPKERNEL_HPP
+#define DSPKERNEL_HPP
+
+#include "globldef.h"
+
+/*
+ * DSP kernels: the inner loops of dsp_proc(), working on runs of contiguous samples.
+ *
+ * Every kernel set (scalar, SSE2, AVX2, AVX-512) does exactly the same integer math, so the output doesn't depend on the kernel set used.
+ * The kernel set is chosen at runtime (dspkernel_select()), based on what the CPU supports. One binary runs on any x86 CPU.
+ * Non x86 builds only have the scalar kernel set.
+ *
+ * p_acc is the accumulator: one int32_t per sample.
+ *
+ * load_i16: p_acc[n] = p_src[n]
+ * tap_i16: p_acc[n] += (p_src[n]*gain + rounding) >> shift. gain and rounding must fit in 16 bits (Q15 gains, or polarity only), shift <= 15.
+ * tap_i32: p_acc[n] += (p_src[n]*gain + rounding) >> shift, 64 bit product. p_src must be 24 bit samples, shift <= 32.
+ * store_i16: p_dst[n] = clamp(p_acc[n]/2) to 16 bit range.
+ * store_i24: p_dst[n] = clamp(p_acc[n]/2) to 24 bit range.
+ * store_i24 may be used in place (p_dst == p_acc).
+ *
+ * Float kernels (p_acc: one float per sample, full scale = 1.0):
+ * tap_f32: p_acc[n] += p_src[n]*gain
+ * store_f32: p_dst[n] = clamp(round(p_acc[n]/2 scaled to bits + dither)) to bits range (bits = 16, 24 or 32).
+ * p_dither: DSPKERNEL_DITHER_LANES TPDF dither generator states (non zero), or NULL for no dither. Sample n uses lane n%DSPKERNEL_DITHER_LANES.
+ * Float kernel sets give the same output as well (no FMA contraction, same rounding and same dither sequence).
+ *
+ * rounding is always (1 << shift) >> 1: round to nearest, instead of flooring (prevents a DC bias that grows with the number of taps).
+ *
+ * Recursive comb kernels (one step of a geometric tap series per sample, see the recursive comb engine in AudioRTDSP.hpp).
+ * p_state: comb state, fixed point with frac_bits fraction bits (integer kernels) or float. Updated in place.
+ * comb_i16/comb_i32: s = (pol*((p_src[n] << frac_bits) + p_state[n])) >> 1
+ *                    s -= pol_old*(((p_src_old[n] << frac_bits) + rounding) >> shift_old)
+ *                    p_state[n] = s, p_acc[n] += (s + rounding) >> frac_bits
+ * pol and pol_old must be 1 or -1. (p_src[n] << frac_bits) + p_state[n] must fit in 31 bits.
+ * comb_f32: s = (p_src[n] + p_state[n])*gain - p_src_old[n]*gain_old, p_state[n] = s, p_acc[n] += s
+ *
+ * Feedback delay kernels (one step of a recirculating delay line per sample, see the feedback delay mode in AudioRTDSP.hpp).
+ * p_state: delay line (float, sample scale of the pipeline). Updated in place: one read and one write per sample.
+ * fbdelay_i16/fbdelay_i32: w = p_state[n]*gain, p_state[n] = p_src[n] + w, p_acc[n] += round(w) (to nearest even)
+ * fbdelay_f32: w = p_state[n]*gain, p_state[n] = p_src[n] + w, p_acc[n] += w
+ */
+
+#define DSPKERNEL_DITHER_LANES 8U
+
+enum DspKernelLevel {
+	DSPKERNEL_AUTO = 0,
+	DSPKERNEL_SCALAR = 1,
+	DSPKERNEL_SSE2 = 2,
+	DSPKERNEL_AVX2 = 3,
+	DSPKERNEL_AVX512 = 4
+};
+
+struct _dspkernel {
+	int level;
+	const char *name;
+
+	void (*load_i16)(int32_t *p_acc, const int16_t *p_src, size_t n_samples);
+	void (*tap_i16)(int32_t *p_acc, const int16_t *p_src, size_t n_samples, int32_t gain, uint32_t shift);
+	void (*tap_i32)(int32_t *p_acc, const int32_t *p_src, size_t n_samples, int32_t gain, uint32_t shift);
+	void (*store_i16)(int16_t *p_dst, const int32_t *p_acc, size_t n_samples);
+	void (*store_i24)(int32_t *p_dst, const int32_t *p_acc, size_t n_samples);
+	void (*tap_f32)(float *p_acc, const float *p_src, size_t n_samples, float gain);
+	void (*store_f32)(int32_t *p_dst, const float *p_acc, size_t n_samples, uint32_t bits, uint32_t *p_dither);
+	void (*comb_i16)(int32_t *p_acc, int32_t *p_state, const int16_t *p_src, const int16_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old);
+	void (*comb_i32)(int32_t *p_acc, int32_t *p_state, const int32_t *p_src, const int32_t *p_src_old, size_t n_samples, int32_t pol, int32_t pol_old, uint32_t frac_bits, uint32_t shift_old);
+	void (*comb_f32)(float *p_acc, float *p_state, const float *p_src, const float *p_src_old, size_t n_samples, float gain, float gain_old);
+	void (*fbdelay_i16)(int32_t *p_acc, float *p_state, const int16_t *p_src, size_t n_samples, float gain);
+	void (*fbdelay_i32)(int32_t *p_acc, float *p_state, const int32_t *p_src, size_t n_samples, float gain);
+	void (*fbdelay_f32)(float *p_acc, float *p_state, const float *p_src, size_t n_samples, float gain);
+};
+
+typedef struct _dspkernel dspkernel_t;
+
+/*
+ * dspkernel_get_max_level: returns the best kernel level supported by this CPU.
+ * dspkernel_select: returns the kernel set for the requested level (DSPKERNEL_AUTO = best supported).
+ * If the requested level is not supported, the best supported level below it is returned.
+ * dspkernel_denormals_off: flush denormal float results and inputs to zero on the calling thread (x86 FTZ/DAZ, no-op elsewhere).
+ * A decaying float state (recursive comb, feedback delay) ends up denormal in silence, and denormal math is very slow.
+ */
+
+extern int dspkernel_get_max_level(void);
+extern const dspkernel_t *dspkernel_select(int level);
+extern void dspkernel_denormals_off(void);
+
+#endif /*DSPKERNEL_HPP*/
@@ -22,9 +22,13 @@
 #ifdef __FILE64
 typedef off64_t __offset;
 #define __LSEEK(fd, offset, whence) lseek64(fd, offset, whence)
+#define __PREAD(fd, p_buf, size, offset) pread64(fd, p_buf, size, offset)
+#define __MMAP(p_addr, size, prot, flags, fd, offset) mmap64(p_addr, size, prot, flags, fd, offset)
 #else
 typedef off_t __offset;
 #define __LSEEK(fd, offset, whence) lseek(fd, offset, whence)
+#define __PREAD(fd, p_buf, size, offset) pread(fd, p_buf, size, offset)
+#define __MMAP(p_addr, size, prot, flags, fd, offset) mmap(p_addr, size, prot, flags, fd, offset)
 #endif
 
 #endif /*FILEDEF_H*/
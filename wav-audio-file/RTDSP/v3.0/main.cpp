@@ -15,6 +15,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <iostream>
 
@@ -23,22 +27,61 @@
 #include "AudioRTDSP.hpp"
 #include "AudioRTDSP_i16.hpp"
 #include "AudioRTDSP_i24.hpp"
+#include "AudioRTDSP_f32.hpp"
 
 #define PB_I16 1
 #define PB_I24 2
+#define PB_I32 3
+#define PB_F32 4
 
 AudioRTDSP *p_audio = NULL;
 audiortdsp_pb_params_t pb_params;
 
+audiortdsp_rt_params_t rt_params = {
+	.enable = false,
+	.sched_policy = SCHED_FIFO,
+	.playthread_priority = 80,
+	.loadthread_priority = 70,
+	.playthread_cpu = -1,
+	.loadthread_cpu = -1,
+	.lock_memory = true
+};
+
 int h_filein = -1;
 
+/*
+ * Stream input (stdin, FIFO, socket): the header is read in order, no seeks.
+ * filein_stream_pos is the number of bytes read so far. The first STREAM_HEADER_CACHE_SIZE bytes are kept,
+ * for the few lookups that go back (ds64 table).
+ */
+
+#define STREAM_HEADER_CACHE_SIZE 65536U
+
+bool filein_stream = false;
+__offset filein_stream_pos = 0;
+uint8_t stream_header_cache[STREAM_HEADER_CACHE_SIZE];
+
+/*Headerless PCM input (--raw): sample format (PB_I16, PB_I24, PB_I32, PB_F32), sampling rate and number of channels from the command line*/
+
+int raw_format = 0;
+int raw_sample_rate = 48000;
+int raw_n_channels = 2;
+
 extern void app_deinit(void);
 
 extern bool filein_ext_check(void);
 extern bool filein_open(void);
 extern void filein_close(void);
+extern int filein_socket_connect(void);
+
+extern bool parse_options(int argc, char **argv);
+extern bool option_compare(const char *auth, const char *input, const char **pp_value);
+extern bool option_get_int(const char *option_name, const char *value_text, int min_value, int *p_value);
 
+extern bool filein_read_at(__offset pos, void *p_buf, size_t n_bytes);
+extern bool filein_stream_read(void *p_buf, size_t n_bytes);
 extern int filein_get_params(void);
+extern int filein_get_raw_params(void);
 extern bool compare_signature(const char *auth, const uint8_t *buf);
 
 int main(int argc, char **argv)
@@ -48,28 +91,62 @@ int main(int argc, char **argv)
 	if(argc < 3)
 	{
 		std::cout << "Error: missing arguments\nThis executable requires 2 arguments: <output audio device id> <input audio file directory>\nThey must be in that order\n";
+		std::cout << "The input may be a FIFO or a unix socket, or \"-\" to read it from stdin (streaming input, read in order with no seeks)\n";
+		std::cout << "Optional arguments may follow:\n";
+		std::cout << "--renderahead=<number> : output render-ahead ring size, in number of periods (default = 2, not used with mmap access)\n";
+		std::cout << "--mmap : use mmap access to the audio device (if supported)\n";
+		std::cout << "--prefetch=<number> : input file read size of the prefetch thread, in KiB (default = 1024)\n";
+		std::cout << "--fileaccess=<read|mmap|uring> : input file access: read calls, memory mapping or io_uring (default = read)\n";
+		std::cout << "--raw=<s16|s24|s32|f32> : input is headerless PCM (little endian, interleaved) in the given sample format\n";
+		std::cout << "--rate=<number> : headerless PCM input sampling rate (default = 48000)\n";
+		std::cout << "--channels=<number> : headerless PCM input number of channels (default = 2)\n";
+		std::cout << "--bitexact : reproduce the integer division rounding of previous versions exactly (slower)\n";
+		std::cout << "--dither : add TPDF dither when converting 32bit/float input to the audio device format\n";
+		std::cout << "--dspkernel=<scalar|sse2|avx2|avx512> : force a DSP kernel set (default = best supported by the CPU)\n";
+		std::cout << "--dspengine=<auto|direct|fft|comb> : delay tap engine: direct form, FFT convolution, recursive comb (exponential divider), or automatic (default = auto)\n";
+		std::cout << "--taps=<file> : use the delay taps listed in <file> instead of the preset taps, one per line: <delay>,<gain>[,<source channel>,<destination channel>]\n";
+		std::cout << "--rt=<fifo|rr> : enable real time mode (real time scheduling + memory locking)\n";
+		std::cout << "--rtprio-play=<number> : play thread real time priority (default = 80)\n";
+		std::cout << "--rtprio-load=<number> : load (DSP) thread real time priority (default = 70)\n";
+		std::cout << "--cpu-play=<number> : pin play thread to CPU core (real time mode only)\n";
+		std::cout << "--cpu-load=<number> : pin load (DSP) thread to CPU core (real time mode only)\n";
+		std::cout << "--no-mlock : do not lock memory in real time mode\n";
 		return 1;
 	}
 
 	pb_params.audio_dev_desc = argv[1];
 	pb_params.filein_dir = argv[2];
 
-	if(!filein_ext_check())
+	if(!parse_options(argc, argv)) return 1;
+
+	if(!filein_open())
 	{
-		std::cout << "Error: bad file extension\n";
+		std::cout << "Error: could not open file\n";
 		goto _l_main_error;
 	}
 
-	if(!filein_open())
+	/*Streams and headerless PCM don't have a meaningful extension (and stdin can't be used for the prompt)*/
+
+	if(!filein_stream && !raw_format && !filein_ext_check())
 	{
-		std::cout << "Error: could not open file\n";
+		std::cout << "Error: bad file extension\n";
 		goto _l_main_error;
 	}
 
-	n_ret = filein_get_params();
+	if(raw_format) n_ret = filein_get_raw_params();
+	else n_ret = filein_get_params();
 
 	if(n_ret < 0) goto _l_main_error;
 
+	/*The stream stays open, read up to the audio data. The audio object takes it over.*/
+
+	if(filein_stream)
+	{
+		pb_params.filein_stream = true;
+		pb_params.filein_stream_fd = h_filein;
+		h_filein = -1;
+	}
+
 	switch(n_ret)
 	{
 		case PB_I16:
@@ -79,6 +156,17 @@ int main(int argc, char **argv)
 		case PB_I24:
 			p_audio = new AudioRTDSP_i24(&pb_params);
 			break;
+
+		case PB_I32:
+		case PB_F32:
+			if(pb_params.dsp_bitexact)
+			{
+				std::cout << "Warning: option \"--bitexact\" has no effect on 32bit/float input files (float pipeline)\n";
+				pb_params.dsp_bitexact = false;
+			}
+
+			p_audio = new AudioRTDSP_f32(&pb_params, (n_ret == PB_F32));
+			break;
 	}
 
 	if(p_audio == NULL)
@@ -87,6 +175,15 @@ int main(int argc, char **argv)
 		goto _l_main_error;
 	}
 
+	if(rt_params.enable)
+	{
+		if(!p_audio->setRealTimeParameters(&rt_params))
+		{
+			std::cout << p_audio->getLastErrorMessage() << std::endl;
+			goto _l_main_error;
+		}
+	}
+
 	if(!p_audio->initialize())
 	{
 		std::cout << p_audio->getLastErrorMessage() << std::endl;
@@ -130,6 +227,234 @@ void __attribute__((__noreturn__)) app_exit(int exit_code, const char *exit_msg)
 	while(true) delay_ms(10);
 }
 
+bool parse_options(int argc, char **argv)
+{
+	int n_arg = 0;
+	int value = 0;
+	const char *value_text = NULL;
+
+	for(n_arg = 3; n_arg < argc; n_arg++)
+	{
+		if(option_compare("--renderahead=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--renderahead", value_text, 0, &value)) return false;
+
+			pb_params.bufferout_n_segments = (uint32_t) value;
+			continue;
+		}
+
+		if(option_compare("--prefetch=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--prefetch", value_text, 1, &value)) return false;
+
+			if(value > 65536)
+			{
+				std::cout << "Error: value for option \"--prefetch\" is too big (maximum = 65536)\n";
+				return false;
+			}
+
+			pb_params.prefetch_chunk_size = ((uint32_t) value)*1024u;
+			continue;
+		}
+
+		if(option_compare("--fileaccess=", argv[n_arg], &value_text))
+		{
+			if(cstr_compare("read", value_text)) pb_params.filein_access = FILEIN_ACCESS_READ;
+			else if(cstr_compare("mmap", value_text)) pb_params.filein_access = FILEIN_ACCESS_MMAP;
+			else if(cstr_compare("uring", value_text)) pb_params.filein_access = FILEIN_ACCESS_URING;
+			else
+			{
+				std::cout << "Error: invalid value for option \"--fileaccess\"\nValid values are \"read\", \"mmap\" and \"uring\"\n";
+				return false;
+			}
+
+			continue;
+		}
+
+		if(cstr_compare("--mmap", argv[n_arg]))
+		{
+			pb_params.mmap_access = true;
+			continue;
+		}
+
+		if(option_compare("--raw=", argv[n_arg], &value_text))
+		{
+			if(cstr_compare("s16", value_text)) raw_format = PB_I16;
+			else if(cstr_compare("s24", value_text)) raw_format = PB_I24;
+			else if(cstr_compare("s32", value_text)) raw_format = PB_I32;
+			else if(cstr_compare("f32", value_text)) raw_format = PB_F32;
+			else
+			{
+				std::cout << "Error: invalid value for option \"--raw\"\nValid values are \"s16\", \"s24\", \"s32\" and \"f32\"\n";
+				return false;
+			}
+
+			continue;
+		}
+
+		if(option_compare("--rate=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--rate", value_text, 1, &raw_sample_rate)) return false;
+			continue;
+		}
+
+		if(option_compare("--channels=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--channels", value_text, 1, &raw_n_channels)) return false;
+			if(raw_n_channels > 0xffff)
+			{
+				std::cout << "Error: invalid value for option \"--channels\"\n";
+				return false;
+			}
+
+			continue;
+		}
+
+		if(cstr_compare("--bitexact", argv[n_arg]))
+		{
+			pb_params.dsp_bitexact = true;
+			continue;
+		}
+
+		if(cstr_compare("--dither", argv[n_arg]))
+		{
+			pb_params.dither = true;
+			continue;
+		}
+
+		if(option_compare("--dspkernel=", argv[n_arg], &value_text))
+		{
+			if(cstr_compare("scalar", value_text)) pb_params.dsp_kernel = DSPKERNEL_SCALAR;
+			else if(cstr_compare("sse2", value_text)) pb_params.dsp_kernel = DSPKERNEL_SSE2;
+			else if(cstr_compare("avx2", value_text)) pb_params.dsp_kernel = DSPKERNEL_AVX2;
+			else if(cstr_compare("avx512", value_text)) pb_params.dsp_kernel = DSPKERNEL_AVX512;
+			else
+			{
+				std::cout << "Error: invalid value for option \"--dspkernel\"\nValid values are \"scalar\", \"sse2\", \"avx2\" and \"avx512\"\n";
+				return false;
+			}
+
+			continue;
+		}
+
+		if(option_compare("--dspengine=", argv[n_arg], &value_text))
+		{
+			if(cstr_compare("auto", value_text)) pb_params.dsp_engine = DSPENGINE_AUTO;
+			else if(cstr_compare("direct", value_text)) pb_params.dsp_engine = DSPENGINE_DIRECT;
+			else if(cstr_compare("fft", value_text)) pb_params.dsp_engine = DSPENGINE_FFT;
+			else if(cstr_compare("comb", value_text)) pb_params.dsp_engine = DSPENGINE_COMB;
+			else
+			{
+				std::cout << "Error: invalid value for option \"--dspengine\"\nValid values are \"auto\", \"direct\", \"fft\" and \"comb\"\n";
+				return false;
+			}
+
+			continue;
+		}
+
+		if(option_compare("--taps=", argv[n_arg], &value_text))
+		{
+			if(!cstr_getlength(value_text))
+			{
+				std::cout << "Error: option \"--taps\" requires a file\n";
+				return false;
+			}
+
+			pb_params.taps_file = value_text;
+			continue;
+		}
+
+		if(option_compare("--rt=", argv[n_arg], &value_text))
+		{
+			if(cstr_compare("fifo", value_text)) rt_params.sched_policy = SCHED_FIFO;
+			else if(cstr_compare("rr", value_text)) rt_params.sched_policy = SCHED_RR;
+			else
+			{
+				std::cout << "Error: invalid value for option \"--rt\"\nValid values are \"fifo\" and \"rr\"\n";
+				return false;
+			}
+
+			rt_params.enable = true;
+			continue;
+		}
+
+		if(option_compare("--rtprio-play=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--rtprio-play", value_text, 1, &rt_params.playthread_priority)) return false;
+			continue;
+		}
+
+		if(option_compare("--rtprio-load=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--rtprio-load", value_text, 1, &rt_params.loadthread_priority)) return false;
+			continue;
+		}
+
+		if(option_compare("--cpu-play=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--cpu-play", value_text, 0, &rt_params.playthread_cpu)) return false;
+			continue;
+		}
+
+		if(option_compare("--cpu-load=", argv[n_arg], &value_text))
+		{
+			if(!option_get_int("--cpu-load", value_text, 0, &rt_params.loadthread_cpu)) return false;
+			continue;
+		}
+
+		if(cstr_compare("--no-mlock", argv[n_arg]))
+		{
+			rt_params.lock_memory = false;
+			continue;
+		}
+
+		std::cout << "Error: unknown option \"" << argv[n_arg] << "\"\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool option_compare(const char *auth, const char *input, const char **pp_value)
+{
+	size_t len = 0u;
+
+	if(auth == NULL) return false;
+	if(input == NULL) return false;
+
+	len = (size_t) cstr_getlength(auth);
+
+	if(strncmp(auth, input, len)) return false;
+
+	if(pp_value != NULL) *pp_value = &input[len];
+	return true;
+}
+
+bool option_get_int(const char *option_name, const char *value_text, int min_value, int *p_value)
+{
+	int value = 0;
+
+	if(p_value == NULL) return false;
+
+	try
+	{
+		value = std::stoi(value_text);
+	}
+	catch(...)
+	{
+		value = min_value - 1;
+	}
+
+	if(value < min_value)
+	{
+		std::cout << "Error: invalid value for option \"" << option_name << "\"\n";
+		return false;
+	}
+
+	*p_value = value;
+	return true;
+}
+
 bool filein_ext_check(void)
 {
 	size_t len = 0u;
@@ -147,9 +472,13 @@ bool filein_ext_check(void)
 		if(cstr_compare(".wav", &textbuf[len - 4u])) 
 			return true;
 
+	if(len >= 6u)
+		if(cstr_compare(".rf64", &textbuf[len - 5u]) || cstr_compare(".bw64", &textbuf[len - 5u]))
+			return true;
+
 	while(true)
 	{
-		std::cout << "WARNING: chosen file does not have a \".wav\" extension.\nFile format might be incompatible with this application\nDo you wish to continue? (yes/no): ";
+		std::cout << "WARNING: chosen file does not have a \".wav\" (or \".rf64\", \".bw64\") extension.\nFile format might be incompatible with this application\nDo you wish to continue? (yes/no): ";
 		usrinput = "";
 		std::cin >> usrinput;
 		usrinput = str_tolower(usrinput);
@@ -165,13 +494,37 @@ bool filein_ext_check(void)
 
 bool filein_open(void)
 {
+	struct stat file_stat;
+
 	filein_close(); /*Clear previous file handle*/
 
 	if(pb_params.filein_dir == NULL) return false;
 
+	filein_stream = false;
+	filein_stream_pos = 0;
+
+	if(cstr_compare("-", pb_params.filein_dir))
+	{
+		h_filein = STDIN_FILENO;
+		filein_stream = true;
+		return true;
+	}
+
 	h_filein = open(pb_params.filein_dir, O_RDONLY);
 
-	return (h_filein >= 0);
+	if((h_filein < 0) && (errno == ENXIO)) h_filein = filein_socket_connect(); /*open() fails on sockets*/
+	if(h_filein < 0) return false;
+
+	if(fstat(h_filein, &file_stat) < 0)
+	{
+		filein_close();
+		return false;
+	}
+
+	/*No random access on FIFOs, sockets and character devices*/
+
+	filein_stream = (S_ISFIFO(file_stat.st_mode) || S_ISSOCK(file_stat.st_mode) || S_ISCHR(file_stat.st_mode));
+	return true;
 }
 
 void filein_close(void)
@@ -183,109 +536,403 @@ void filein_close(void)
 	return;
 }
 
-int filein_get_params(void)
+int filein_socket_connect(void)
 {
-	const size_t BUFFER_SIZE = 4096u;
-	size_t buffer_index = 0u;
+	struct sockaddr_un sock_addr;
+	int h_socket = -1;
 
-	uint8_t *p_headerinfo = NULL;
+	if(((size_t) cstr_getlength(pb_params.filein_dir)) >= sizeof(sock_addr.sun_path)) return -1;
 
-	uint32_t u32 = 0u;
-	uint16_t u16 = 0u;
+	memset(&sock_addr, 0, sizeof(struct sockaddr_un));
+	sock_addr.sun_family = AF_UNIX;
+	snprintf(sock_addr.sun_path, sizeof(sock_addr.sun_path), "%s", pb_params.filein_dir);
 
-	uint16_t bit_depth = 0u;
+	h_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(h_socket < 0) return -1;
 
-	p_headerinfo = (uint8_t*) malloc(BUFFER_SIZE);
-	if(p_headerinfo == NULL)
+	if(connect(h_socket, (const struct sockaddr*) &sock_addr, sizeof(struct sockaddr_un)) < 0)
 	{
-		std::cout << "filein_get_params: Error: memory allocate failed\n";
-		goto _l_filein_get_params_error;
+		close(h_socket);
+		return -1;
 	}
 
-	memset(p_headerinfo, 0, BUFFER_SIZE);
+	return h_socket;
+}
 
-	__LSEEK(h_filein, 0, SEEK_SET);
-	read(h_filein, p_headerinfo, BUFFER_SIZE);
-	filein_close();
+/*
+ * filein_get_params: walks the file chunk by chunk (chunk headers only, no fixed header window), so it doesn't matter how much metadata
+ * (bext, LIST, iXML, ...) comes before the audio data.
+ *
+ * Supported containers: RIFF/WAVE, RF64 and BW64 (64 bit sizes from the "ds64" chunk, for files bigger than 4 GiB).
+ * Supported encodings: PCM (16, 24 or 32 bit integer) and IEEE float (32 bit), either plain (format tag 1 or 3)
+ * or WAVE_FORMAT_EXTENSIBLE with a PCM or IEEE float subformat.
+ *
+ * Plain RIFF files can't describe a data chunk bigger than 4 GiB. Some writers leave the size at 0 or 0xffffffff (unknown), or let it wrap around.
+ * If the data chunk is the last one, these cases are detected and the audio data is taken up to the end of the file.
+ *
+ * Stream input: the header is read in order (filein_read_at() only reads forward, skipped chunks are read and dropped).
+ * An unknown data size (0 or 0xffffffff) means the audio data goes on until the stream is closed.
+ */
+
+bool filein_read_at(__offset pos, void *p_buf, size_t n_bytes)
+{
+	ssize_t n_ret = 0;
+	size_t n_done = 0u;
 
-	if(!compare_signature("RIFF", p_headerinfo))
+	if(filein_stream)
 	{
-		std::cout << "filein_get_params: Error: file format is not supported\n";
-		goto _l_filein_get_params_error;
+		/*Bytes already read come from the header cache*/
+
+		if(pos < filein_stream_pos)
+		{
+			n_done = (size_t) (filein_stream_pos - pos);
+			if(n_done > n_bytes) n_done = n_bytes;
+
+			if((pos + ((__offset) n_done)) > ((__offset) STREAM_HEADER_CACHE_SIZE)) return false; /*Not kept*/
+
+			memcpy(p_buf, &stream_header_cache[pos], n_done);
+			pos += (__offset) n_done;
+		}
+
+		if(n_done >= n_bytes) return true;
+
+		if(pos > filein_stream_pos)
+			if(!filein_stream_read(NULL, (size_t) (pos - filein_stream_pos))) return false;
+
+		return filein_stream_read((void*) (((size_t) p_buf) + n_done), n_bytes - n_done);
 	}
 
-	if(!compare_signature("WAVE", (const uint8_t*) (((size_t) p_headerinfo) + 8u)))
+	while(n_done < n_bytes)
 	{
-		std::cout << "filein_get_params: Error: file format is not supported\n";
-		goto _l_filein_get_params_error;
+		n_ret = (ssize_t) __PREAD(h_filein, (void*) (((size_t) p_buf) + n_done), n_bytes - n_done, pos + ((__offset) n_done));
+
+		if(n_ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return false;
+		}
+
+		if(!n_ret) return false; /*End of file*/
+
+		n_done += (size_t) n_ret;
 	}
 
-	buffer_index = 12u;
+	return true;
+}
 
-	while(true)
+bool filein_stream_read(void *p_buf, size_t n_bytes)
+{
+	/*Reads the next n_bytes of the stream into p_buf. If p_buf is NULL, they're dropped.*/
+
+	uint8_t skipbuf[4096];
+	uint8_t *p_dst = NULL;
+	size_t n_done = 0u;
+	size_t n_read = 0u;
+	size_t n_cache = 0u;
+	ssize_t n_ret = 0;
+
+	while(n_done < n_bytes)
 	{
-		if(buffer_index > (BUFFER_SIZE - 8u))
+		n_read = n_bytes - n_done;
+
+		if(p_buf != NULL) p_dst = (uint8_t*) (((size_t) p_buf) + n_done);
+		else
 		{
-			std::cout << "filein_get_params: Error: broken header (missing subchunk \"fmt \")\nFile is probably corrupted\n";
-			goto _l_filein_get_params_error;
+			p_dst = skipbuf;
+			if(n_read > sizeof(skipbuf)) n_read = sizeof(skipbuf);
+		}
+
+		n_ret = read(h_filein, p_dst, n_read);
+
+		if(n_ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return false;
+		}
+
+		if(!n_ret) return false; /*End of stream*/
+
+		if(filein_stream_pos < ((__offset) STREAM_HEADER_CACHE_SIZE))
+		{
+			n_cache = STREAM_HEADER_CACHE_SIZE - ((size_t) filein_stream_pos);
+			if(n_cache > ((size_t) n_ret)) n_cache = (size_t) n_ret;
+
+			memcpy(&stream_header_cache[filein_stream_pos], p_dst, n_cache);
 		}
 
-		if(compare_signature("fmt ", (const uint8_t*) (((size_t) p_headerinfo) + buffer_index))) break;
+		filein_stream_pos += (__offset) n_ret;
+		n_done += (size_t) n_ret;
+	}
+
+	return true;
+}
+
+int filein_get_params(void)
+{
+	const uint8_t WAVE_SUBFORMAT_GUID_TAIL[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}; /*{xxxxxxxx-0000-0010-8000-00aa00389b71}, bytes 2 to 15*/
+	const size_t FMT_SIZE_MAX = 40u; /*WAVE_FORMAT_EXTENSIBLE*/
+	const size_t DS64_SIZE_MIN = 28u;
+
+	uint8_t headerinfo[48];
+	uint8_t chunk_header[8];
+
+	__offset file_size = 0;
+	__offset chunk_pos = 0;
+	__offset chunk_size = 0;
+
+	__offset ds64_data_size = -1;
+	uint32_t ds64_table_length = 0u;
+	__offset ds64_table_pos = 0;
+	uint32_t n_entry = 0u;
+
+	bool container_64 = false;
+	bool fmt_found = false;
+
+	uint32_t u32 = 0u;
+	uint64_t u64 = 0u;
+
+	uint16_t format_tag = 0u;
+	uint16_t block_align = 0u;
+	uint16_t bit_depth = 0u;
+
+	if(filein_stream) file_size = FILEIN_STREAM_END; /*Unknown*/
+	else file_size = __LSEEK(h_filein, 0, SEEK_END);
 
-		u32 = *((uint32_t*) (((size_t) p_headerinfo) + buffer_index + 4u));
-		buffer_index += (size_t) (u32 + 8u);
+	if(file_size < 12)
+	{
+		std::cout << "filein_get_params: Error: file format is not supported\n";
+		goto _l_filein_get_params_error;
 	}
 
-	if(buffer_index > (BUFFER_SIZE - 24u))
+	/*RIFF HEADER*/
+
+	if(!filein_read_at(0, headerinfo, 12u))
 	{
-		std::cout << "filein_get_params: Error: broken header (error on subchunk \"fmt \")\nFile is probably corrupted\n";
+		std::cout << "filein_get_params: Error: could not read file\n";
 		goto _l_filein_get_params_error;
 	}
 
-	u16 = *((uint16_t*) (((size_t) p_headerinfo) + buffer_index + 8u));
+	if(compare_signature("RF64", headerinfo) || compare_signature("BW64", headerinfo)) container_64 = true;
+	else if(!compare_signature("RIFF", headerinfo))
+	{
+		std::cout << "filein_get_params: Error: file format is not supported\n";
+		goto _l_filein_get_params_error;
+	}
 
-	if(u16 != 1u)
+	if(!compare_signature("WAVE", &headerinfo[8]))
 	{
-		std::cout << "filein_get_params: Error: audio encoding format is not supported\n";
+		std::cout << "filein_get_params: Error: file format is not supported\n";
 		goto _l_filein_get_params_error;
 	}
 
-	pb_params.n_channels = *((uint16_t*) (((size_t) p_headerinfo) + buffer_index + 10u));
-	pb_params.sample_rate = *((uint32_t*) (((size_t) p_headerinfo) + buffer_index + 12u));
-	bit_depth = *((uint16_t*) (((size_t) p_headerinfo) + buffer_index + 22u));
+	/*CHUNKS*/
 
-	u32 = *((uint32_t*) (((size_t) p_headerinfo) + buffer_index + 4u));
-	buffer_index += (size_t) (u32 + 8u);
+	chunk_pos = 12;
 
 	while(true)
 	{
-		if(buffer_index > (BUFFER_SIZE - 8u))
+		if((chunk_pos + 8) > file_size)
+		{
+			if(fmt_found) std::cout << "filein_get_params: Error: broken header (missing subchunk \"data\")\nFile is probably corrupted\n";
+			else std::cout << "filein_get_params: Error: broken header (missing subchunk \"fmt \")\nFile is probably corrupted\n";
+			goto _l_filein_get_params_error;
+		}
+
+		if(!filein_read_at(chunk_pos, chunk_header, 8u))
 		{
-			std::cout << "filein_get_params: Error: broken header (missing subchunk \"data\")\nFile is probably corrupted\n";
+			std::cout << "filein_get_params: Error: could not read file\n";
 			goto _l_filein_get_params_error;
 		}
 
-		if(compare_signature("data", (const uint8_t*) (((size_t) p_headerinfo) + buffer_index))) break;
+		u32 = *((uint32_t*) &chunk_header[4]);
+		chunk_size = (__offset) u32;
+
+		/*RF64/BW64: 0xffffffff means the real size is in the ds64 chunk (data size, or the ds64 table for other chunks)*/
+
+		if(container_64 && (u32 == 0xffffffffu) && !compare_signature("data", chunk_header))
+		{
+			for(n_entry = 0u; n_entry < ds64_table_length; n_entry++)
+			{
+				if(!filein_read_at(ds64_table_pos + ((__offset) (12u*n_entry)), headerinfo, 12u)) break;
+				if(!compare_signature((const char*) chunk_header, headerinfo)) continue;
+
+				/*Sizes above the __offset range would turn negative (and move the chunk walk backwards)*/
+
+				u64 = *((uint64_t*) &headerinfo[4]);
+				if(u64 > ((uint64_t) FILEIN_STREAM_END))
+				{
+					std::cout << "filein_get_params: Error: broken header (error on subchunk \"ds64\")\nFile is probably corrupted\n";
+					goto _l_filein_get_params_error;
+				}
+
+				chunk_size = (__offset) u64;
+				break;
+			}
+		}
+
+		if(compare_signature("ds64", chunk_header))
+		{
+			if(!container_64 || (chunk_size < ((__offset) DS64_SIZE_MIN)) || !filein_read_at(chunk_pos + 8, headerinfo, DS64_SIZE_MIN))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"ds64\")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			/*riffSize (8), dataSize (8), sampleCount (8), tableLength (4), table: chunkId (4) + chunkSize (8) per entry*/
+
+			u64 = *((uint64_t*) &headerinfo[8]);
+			if(u64 > ((uint64_t) FILEIN_STREAM_END))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"ds64\")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			ds64_data_size = (__offset) u64;
+
+			ds64_table_length = *((uint32_t*) &headerinfo[24]);
+			ds64_table_pos = chunk_pos + 8 + ((__offset) DS64_SIZE_MIN);
+
+			if(((__offset) (DS64_SIZE_MIN + 12u*((size_t) ds64_table_length))) > chunk_size) ds64_table_length = 0u; /*Broken table: ignore it*/
+		}
+		else if(compare_signature("fmt ", chunk_header))
+		{
+			if((chunk_size < 16) || (chunk_size > 0xffff))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"fmt \")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			memset(headerinfo, 0, sizeof(headerinfo));
+
+			if(!filein_read_at(chunk_pos + 8, headerinfo, (chunk_size < ((__offset) FMT_SIZE_MAX)) ? ((size_t) chunk_size) : FMT_SIZE_MAX))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"fmt \")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			format_tag = *((uint16_t*) &headerinfo[0]);
+			pb_params.n_channels = *((uint16_t*) &headerinfo[2]);
+			pb_params.sample_rate = *((uint32_t*) &headerinfo[4]);
+			block_align = *((uint16_t*) &headerinfo[12]);
+			bit_depth = *((uint16_t*) &headerinfo[14]);
+
+			/*WAVE_FORMAT_EXTENSIBLE: the actual format tag is the first 2 bytes of the subformat GUID*/
+
+			if(format_tag == 0xfffeu)
+			{
+				if((chunk_size < ((__offset) FMT_SIZE_MAX)) || (*((uint16_t*) &headerinfo[16]) < 22u))
+				{
+					std::cout << "filein_get_params: Error: broken header (error on subchunk \"fmt \")\nFile is probably corrupted\n";
+					goto _l_filein_get_params_error;
+				}
+
+				if(memcmp(&headerinfo[26], WAVE_SUBFORMAT_GUID_TAIL, 14u))
+				{
+					std::cout << "filein_get_params: Error: audio encoding format is not supported\n";
+					goto _l_filein_get_params_error;
+				}
+
+				format_tag = *((uint16_t*) &headerinfo[24]);
+
+				/*Valid bits smaller than the container (e.g. 20 bits in 24): samples are still left justified, play the container size*/
+			}
+
+			/*1 = PCM (integer), 3 = IEEE float*/
+
+			if((format_tag != 1u) && (format_tag != 3u))
+			{
+				std::cout << "filein_get_params: Error: audio encoding format is not supported\n";
+				goto _l_filein_get_params_error;
+			}
+
+			if(!pb_params.n_channels || !block_align || (((uint32_t) block_align) != ((uint32_t) pb_params.n_channels)*((uint32_t) (bit_depth/8u))))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"fmt \")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			fmt_found = true;
+		}
+		else if(compare_signature("data", chunk_header))
+		{
+			if(!fmt_found)
+			{
+				std::cout << "filein_get_params: Error: broken header (missing subchunk \"fmt \")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			pb_params.audio_data_begin = chunk_pos + 8;
+
+			if(container_64 && (u32 == 0xffffffffu))
+			{
+				if(ds64_data_size < 0)
+				{
+					std::cout << "filein_get_params: Error: broken header (missing subchunk \"ds64\")\nFile is probably corrupted\n";
+					goto _l_filein_get_params_error;
+				}
+
+				chunk_size = ds64_data_size;
+			}
+			else if(filein_stream)
+			{
+				/*Size unknown (0 or 0xffffffff): the writer couldn't seek back to fill it in either. Read until the stream is closed.*/
+
+				if(!u32 || (u32 == 0xffffffffu)) chunk_size = FILEIN_STREAM_END - pb_params.audio_data_begin;
+			}
+			else if(!container_64 && (file_size > (pb_params.audio_data_begin + chunk_size)))
+			{
+				/*Size unknown (0 or 0xffffffff) or wrapped around 4 GiB: if the rest of the file is audio data, take all of it*/
+
+				u64 = (uint64_t) (file_size - pb_params.audio_data_begin);
+
+				if(!u32 || (u32 == 0xffffffffu) || ((u64 > 0xffffffffull) && ((u64 & 0xffffffffull) == ((uint64_t) u32))))
+					chunk_size = (__offset) u64;
+			}
+
+			if(chunk_size > (FILEIN_STREAM_END - pb_params.audio_data_begin))
+			{
+				std::cout << "filein_get_params: Error: broken header (error on subchunk \"data\")\nFile is probably corrupted\n";
+				goto _l_filein_get_params_error;
+			}
+
+			pb_params.audio_data_end = pb_params.audio_data_begin + chunk_size;
+			break;
+		}
+
+		/*
+		 * Chunks are padded to an even size.
+		 * chunk_size is never negative, and the next chunk header must still fit in the __offset range: chunk_pos always moves forward.
+		 */
 
-		u32 = *((uint32_t*) (((size_t) p_headerinfo) + buffer_index + 4u));
-		buffer_index += (size_t) (u32 + 8u);
+		if(chunk_size > (FILEIN_STREAM_END - chunk_pos - 17))
+		{
+			std::cout << "filein_get_params: Error: broken header (bad subchunk size)\nFile is probably corrupted\n";
+			goto _l_filein_get_params_error;
+		}
+
+		chunk_pos += 8 + chunk_size + (chunk_size & 1);
 	}
 
-	u32 = *((uint32_t*) (((size_t) p_headerinfo) + buffer_index + 4u));
+	if(!filein_stream) filein_close();
 
-	pb_params.audio_data_begin = (__offset) (buffer_index + 8u);
-	pb_params.audio_data_end = pb_params.audio_data_begin + ((__offset) u32);
+	/*Drop a trailing partial frame, if any*/
 
-	free(p_headerinfo);
-	p_headerinfo = NULL;
+	if(pb_params.audio_data_end != FILEIN_STREAM_END) pb_params.audio_data_end -= (pb_params.audio_data_end - pb_params.audio_data_begin)%((__offset) block_align);
 
-	switch(bit_depth)
+	if(format_tag == 3u)
+	{
+		if(bit_depth == 32u) return PB_F32;
+	}
+	else switch(bit_depth)
 	{
 		case 16u:
 			return PB_I16;
 
 		case 24u:
 			return PB_I24;
+
+		case 32u:
+			return PB_I32;
 	}
 
 	std::cout << "filein_get_params: Error: audio format is not supported\n";
@@ -293,11 +940,57 @@ int filein_get_params(void)
 _l_filein_get_params_error:
 
 	filein_close();
-	if(p_headerinfo != NULL) free(p_headerinfo);
 
 	return -1;
 }
 
+int filein_get_raw_params(void)
+{
+	/*Headerless PCM: the format is given on the command line, the audio data is the whole file (or stream)*/
+
+	__offset file_size = 0;
+	__offset frame_size = 0;
+
+	pb_params.sample_rate = (uint32_t) raw_sample_rate;
+	pb_params.n_channels = (uint16_t) raw_n_channels;
+	pb_params.audio_data_begin = 0;
+
+	if(filein_stream)
+	{
+		pb_params.audio_data_end = FILEIN_STREAM_END;
+		return raw_format;
+	}
+
+	switch(raw_format)
+	{
+		case PB_I16:
+			frame_size = 2;
+			break;
+
+		case PB_I24:
+			frame_size = 3;
+			break;
+
+		default:
+			frame_size = 4;
+			break;
+	}
+
+	frame_size *= (__offset) raw_n_channels;
+
+	file_size = __LSEEK(h_filein, 0, SEEK_END);
+	filein_close();
+
+	if(file_size < frame_size)
+	{
+		std::cout << "filein_get_raw_params: Error: file is empty (or could not be read)\n";
+		return -1;
+	}
+
+	pb_params.audio_data_end = file_size - file_size%frame_size;
+	return raw_format;
+}
+
 bool compare_signature(const char *auth, const uint8_t *buf)
 {
 	if(auth == NULL) return false;
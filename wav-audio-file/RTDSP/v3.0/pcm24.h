@@ -0,0 +1,281 @@
+/*
+ * 24bit PCM sample conversion routines.
+ * Shared by the real time (RTDSP) and offline (DSP) audio delay tools. Both projects have a copy of this file, keep them identical.
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+#ifndef PCM24_H
+#define PCM24_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM24_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Header only: the player (through AudioRTDSP.hpp) and the standalone pcm24_bench.cpp include it, with no extra object file to build.
+ * The offline tool (DSP/v1.0) keeps its own copy.
+ *
+ * unpack_s24_3le: 3 byte packed little endian samples (S24_3LE, .wav 24bit) to sign extended int32.
+ * pack_s24_3le: int32 (24bit range) to 3 byte packed little endian samples.
+ * to_s32: int32 (24bit range) to a left justified 32bit container (S32_LE): sample << 8.
+ *
+ * The SIMD versions place the 3 sample bytes in the upper 3 bytes of each 32bit lane with a byte shuffle (pshufb),
+ * then an arithmetic right shift by 8 does the sign extension (no per sample branch). Packing is the reverse shuffle.
+ * All levels give exactly the same output. pcm24_select() picks a level at runtime, based on what the CPU supports.
+ */
+
+enum Pcm24Level {
+	PCM24_AUTO = 0,
+	PCM24_SCALAR = 1,
+	PCM24_SSSE3 = 2,
+	PCM24_AVX2 = 3
+};
+
+struct _pcm24 {
+	int level;
+	const char *name;
+
+	void (*unpack_s24_3le)(int32_t *p_dst, const uint8_t *p_src, size_t n_samples);
+	void (*pack_s24_3le)(uint8_t *p_dst, const int32_t *p_src, size_t n_samples);
+	void (*to_s32)(int32_t *p_dst, const int32_t *p_src, size_t n_samples);
+};
+
+typedef struct _pcm24 pcm24_t;
+
+/*SCALAR*/
+
+static void pcm24_unpack_s24_3le_scalar(int32_t *p_dst, const uint8_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+
+	/*Bytes go to the top of the word, the arithmetic shift brings them back down with the sign*/
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+		p_dst[n_sample] = ((int32_t) ((((uint32_t) p_src[3u*n_sample + 2u]) << 24) | (((uint32_t) p_src[3u*n_sample + 1u]) << 16) | (((uint32_t) p_src[3u*n_sample]) << 8))) >> 8;
+
+	return;
+}
+
+static void pcm24_pack_s24_3le_scalar(uint8_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++)
+	{
+		p_dst[3u*n_sample] = (uint8_t) (p_src[n_sample] & 0xff);
+		p_dst[3u*n_sample + 1u] = (uint8_t) ((p_src[n_sample] >> 8) & 0xff);
+		p_dst[3u*n_sample + 2u] = (uint8_t) ((p_src[n_sample] >> 16) & 0xff);
+	}
+
+	return;
+}
+
+static void pcm24_to_s32_scalar(int32_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_dst[n_sample] = (int32_t) (((uint32_t) p_src[n_sample]) << 8);
+
+	return;
+}
+
+#ifdef PCM24_X86
+
+/*SSSE3*/
+
+__attribute__((target("ssse3"))) static void pcm24_unpack_s24_3le_ssse3(int32_t *p_dst, const uint8_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	__m128i v_shuffle;
+
+	v_shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+	/*4 samples (12 bytes) per iteration, from a 16 byte load: stop while there are still 4 bytes to spare*/
+
+	for(n_sample = 0u; (n_samples - n_sample) >= 6u; n_sample += 4u)
+		_mm_storeu_si128((__m128i*) &p_dst[n_sample], _mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) &p_src[3u*n_sample]), v_shuffle), 8));
+
+	pcm24_unpack_s24_3le_scalar(&p_dst[n_sample], &p_src[3u*n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("ssse3"))) static void pcm24_pack_s24_3le_ssse3(uint8_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	uint32_t tail = 0u;
+	__m128i v_shuffle, v_packed;
+
+	v_shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	/*4 samples per iteration, exactly 12 bytes stored (8 + 4)*/
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+	{
+		v_packed = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) &p_src[n_sample]), v_shuffle);
+
+		_mm_storel_epi64((__m128i*) &p_dst[3u*n_sample], v_packed);
+		tail = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(v_packed, 8));
+		memcpy(&p_dst[3u*n_sample + 8u], &tail, 4u);
+	}
+
+	pcm24_pack_s24_3le_scalar(&p_dst[3u*n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("ssse3"))) static void pcm24_to_s32_ssse3(int32_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+
+	n_vec = n_samples & ~((size_t) 3u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 4u)
+		_mm_storeu_si128((__m128i*) &p_dst[n_sample], _mm_slli_epi32(_mm_loadu_si128((const __m128i*) &p_src[n_sample]), 8));
+
+	pcm24_to_s32_scalar(&p_dst[n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+/*AVX2*/
+
+__attribute__((target("avx2"))) static void pcm24_unpack_s24_3le_avx2(int32_t *p_dst, const uint8_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	__m256i v_shuffle, v_src;
+
+	/*pshufb works within each 128bit lane: each lane gets its own 12 byte group (4 samples)*/
+
+	v_shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+	/*8 samples (24 bytes) per iteration. The upper lane load ends 4 bytes past them.*/
+
+	for(n_sample = 0u; (n_samples - n_sample) >= 10u; n_sample += 8u)
+	{
+		v_src = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) &p_src[3u*n_sample])), _mm_loadu_si128((const __m128i*) &p_src[3u*n_sample + 12u]), 1);
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], _mm256_srai_epi32(_mm256_shuffle_epi8(v_src, v_shuffle), 8));
+	}
+
+	pcm24_unpack_s24_3le_ssse3(&p_dst[n_sample], &p_src[3u*n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx2"))) static void pcm24_pack_s24_3le_avx2(uint8_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+	__m256i v_shuffle, v_permute, v_packed;
+
+	v_shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	v_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7); /*Join both lanes' 12 bytes into the low 24 bytes*/
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	/*8 samples per iteration, exactly 24 bytes stored (16 + 8)*/
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+	{
+		v_packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]), v_shuffle), v_permute);
+
+		_mm_storeu_si128((__m128i*) &p_dst[3u*n_sample], _mm256_castsi256_si128(v_packed));
+		_mm_storel_epi64((__m128i*) &p_dst[3u*n_sample + 16u], _mm256_extracti128_si256(v_packed, 1));
+	}
+
+	pcm24_pack_s24_3le_ssse3(&p_dst[3u*n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+__attribute__((target("avx2"))) static void pcm24_to_s32_avx2(int32_t *p_dst, const int32_t *p_src, size_t n_samples)
+{
+	size_t n_sample = 0u;
+	size_t n_vec = 0u;
+
+	n_vec = n_samples & ~((size_t) 7u);
+
+	for(n_sample = 0u; n_sample < n_vec; n_sample += 8u)
+		_mm256_storeu_si256((__m256i*) &p_dst[n_sample], _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*) &p_src[n_sample]), 8));
+
+	pcm24_to_s32_scalar(&p_dst[n_sample], &p_src[n_sample], n_samples - n_sample);
+	return;
+}
+
+#endif /*PCM24_X86*/
+
+static const pcm24_t pcm24_scalar = {
+	.level = PCM24_SCALAR,
+	.name = "scalar",
+	.unpack_s24_3le = pcm24_unpack_s24_3le_scalar,
+	.pack_s24_3le = pcm24_pack_s24_3le_scalar,
+	.to_s32 = pcm24_to_s32_scalar
+};
+
+#ifdef PCM24_X86
+
+static const pcm24_t pcm24_ssse3 = {
+	.level = PCM24_SSSE3,
+	.name = "SSSE3",
+	.unpack_s24_3le = pcm24_unpack_s24_3le_ssse3,
+	.pack_s24_3le = pcm24_pack_s24_3le_ssse3,
+	.to_s32 = pcm24_to_s32_ssse3
+};
+
+static const pcm24_t pcm24_avx2 = {
+	.level = PCM24_AVX2,
+	.name = "AVX2",
+	.unpack_s24_3le = pcm24_unpack_s24_3le_avx2,
+	.pack_s24_3le = pcm24_pack_s24_3le_avx2,
+	.to_s32 = pcm24_to_s32_avx2
+};
+
+#endif /*PCM24_X86*/
+
+/*
+ * pcm24_get_max_level: returns the best level supported by this CPU.
+ * pcm24_select: returns the routines for the requested level (PCM24_AUTO = best supported).
+ * If the requested level is not supported, the best supported level below it is returned.
+ */
+
+static inline int pcm24_get_max_level(void)
+{
+#ifdef PCM24_X86
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) return PCM24_AVX2;
+	if(__builtin_cpu_supports("ssse3")) return PCM24_SSSE3;
+#endif
+
+	return PCM24_SCALAR;
+}
+
+static inline const pcm24_t *pcm24_select(int level)
+{
+	int max_level = 0;
+
+	max_level = pcm24_get_max_level();
+
+	if((level <= PCM24_AUTO) || (level > max_level)) level = max_level;
+
+#ifdef PCM24_X86
+	switch(level)
+	{
+		case PCM24_AVX2:
+			return &pcm24_avx2;
+
+		case PCM24_SSSE3:
+			return &pcm24_ssse3;
+	}
+#endif
+
+	return &pcm24_scalar;
+}
+
+#endif /*PCM24_H*/
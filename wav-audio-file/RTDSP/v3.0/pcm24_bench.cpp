@@ -0,0 +1,264 @@
+/*
+ * Real Time Audio Delay for GNU-Linux systems.
+ * Version 3.0
+ *
+ * Author: Rafael Sabe
+ * Email: rafaelmsabe@gmail.com
+ */
+
+/*
+ * pcm24 conversion microbenchmark (see pcm24.h). Standalone, build with "make pcm24_bench.elf".
+ *
+ * Usage: pcm24_bench.elf [number of samples per run] (default = 1048576)
+ *
+ * First, each level supported by the CPU is checked against the scalar routines (all lengths up to 256 samples, random data).
+ * Then each routine is run repeatedly over the same buffers for about BENCH_TIME_NS, and the throughput is printed
+ * in millions of samples per second and in MB/s of packed (3 byte) audio data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <iostream>
+#include <string>
+
+#include "pcm24.h"
+
+#define CHECK_MAX_SAMPLES 256u
+#define BENCH_TIME_NS 500000000ll
+
+#define ROUTINE_UNPACK 0
+#define ROUTINE_PACK 1
+#define ROUTINE_TO_S32 2
+
+static long long time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((long long) ts.tv_sec)*1000000000ll + ((long long) ts.tv_nsec);
+}
+
+static void fill_random(uint8_t *p_bytes, size_t n_bytes)
+{
+	size_t n_byte = 0u;
+
+	for(n_byte = 0u; n_byte < n_bytes; n_byte++) p_bytes[n_byte] = (uint8_t) (rand() & 0xff);
+
+	return;
+}
+
+static void fill_random_s24(int32_t *p_samples, size_t n_samples)
+{
+	size_t n_sample = 0u;
+
+	for(n_sample = 0u; n_sample < n_samples; n_sample++) p_samples[n_sample] = ((int32_t) ((((uint32_t) rand()) & 0xffffffu) << 8)) >> 8;
+
+	return;
+}
+
+/*
+ * Compares p_pcm24 against the scalar routines. Destination buffers get a guard byte pattern, so writes past the end are caught too.
+ * Source data is read at every byte offset within a word (0 - 3), the routines must not depend on alignment.
+ */
+
+static bool check_level(const pcm24_t *p_pcm24)
+{
+	const pcm24_t *p_ref = NULL;
+
+	uint8_t src_bytes[3u*CHECK_MAX_SAMPLES + 4u];
+	int32_t src_samples[CHECK_MAX_SAMPLES + 1u];
+
+	uint8_t dst_bytes[2u][3u*CHECK_MAX_SAMPLES + 16u];
+	int32_t dst_samples[2u][CHECK_MAX_SAMPLES + 8u];
+
+	size_t n_samples = 0u;
+	size_t offset = 0u;
+	int n_dst = 0;
+
+	p_ref = pcm24_select(PCM24_SCALAR);
+
+	for(offset = 0u; offset < 4u; offset++)
+	{
+		for(n_samples = 0u; n_samples <= CHECK_MAX_SAMPLES; n_samples++)
+		{
+			fill_random(src_bytes, sizeof(src_bytes));
+			fill_random_s24(src_samples, CHECK_MAX_SAMPLES + 1u);
+
+			/*unpack_s24_3le*/
+
+			for(n_dst = 0; n_dst < 2; n_dst++) memset(dst_samples[n_dst], 0x5a, sizeof(dst_samples[n_dst]));
+
+			p_ref->unpack_s24_3le(dst_samples[0], &src_bytes[offset], n_samples);
+			p_pcm24->unpack_s24_3le(dst_samples[1], &src_bytes[offset], n_samples);
+
+			if(memcmp(dst_samples[0], dst_samples[1], sizeof(dst_samples[0])))
+			{
+				std::cout << p_pcm24->name << " unpack_s24_3le: mismatch (" << n_samples << " samples, offset " << offset << ")\n";
+				return false;
+			}
+
+			/*pack_s24_3le*/
+
+			for(n_dst = 0; n_dst < 2; n_dst++) memset(dst_bytes[n_dst], 0x5a, sizeof(dst_bytes[n_dst]));
+
+			p_ref->pack_s24_3le(&dst_bytes[0][offset], &src_samples[offset & 1u], n_samples);
+			p_pcm24->pack_s24_3le(&dst_bytes[1][offset], &src_samples[offset & 1u], n_samples);
+
+			if(memcmp(dst_bytes[0], dst_bytes[1], sizeof(dst_bytes[0])))
+			{
+				std::cout << p_pcm24->name << " pack_s24_3le: mismatch (" << n_samples << " samples, offset " << offset << ")\n";
+				return false;
+			}
+
+			/*to_s32*/
+
+			for(n_dst = 0; n_dst < 2; n_dst++) memset(dst_samples[n_dst], 0x5a, sizeof(dst_samples[n_dst]));
+
+			p_ref->to_s32(dst_samples[0], &src_samples[offset & 1u], n_samples);
+			p_pcm24->to_s32(dst_samples[1], &src_samples[offset & 1u], n_samples);
+
+			if(memcmp(dst_samples[0], dst_samples[1], sizeof(dst_samples[0])))
+			{
+				std::cout << p_pcm24->name << " to_s32: mismatch (" << n_samples << " samples, offset " << offset << ")\n";
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void bench_routine(const pcm24_t *p_pcm24, int routine, uint8_t *p_bytes, int32_t *p_samples, int32_t *p_samples2, size_t n_samples)
+{
+	const char *name = NULL;
+	long long time_begin = 0ll;
+	long long time_elapsed = 0ll;
+	size_t n_runs = 0u;
+	double sample_rate = 0.0;
+
+	time_begin = time_ns();
+
+	do
+	{
+		switch(routine)
+		{
+			case ROUTINE_UNPACK:
+				p_pcm24->unpack_s24_3le(p_samples, p_bytes, n_samples);
+				break;
+
+			case ROUTINE_PACK:
+				p_pcm24->pack_s24_3le(p_bytes, p_samples, n_samples);
+				break;
+
+			case ROUTINE_TO_S32:
+				p_pcm24->to_s32(p_samples2, p_samples, n_samples);
+				break;
+		}
+
+		n_runs++;
+		time_elapsed = time_ns() - time_begin;
+	} while(time_elapsed < BENCH_TIME_NS);
+
+	switch(routine)
+	{
+		case ROUTINE_UNPACK:
+			name = "unpack_s24_3le";
+			break;
+
+		case ROUTINE_PACK:
+			name = "pack_s24_3le";
+			break;
+
+		default:
+			name = "to_s32";
+			break;
+	}
+
+	sample_rate = ((double) n_runs)*((double) n_samples)/(((double) time_elapsed)/1.0e9);
+
+	printf("%-8s %-16s %10.1f Msamples/s %10.1f MB/s\n", p_pcm24->name, name, sample_rate/1.0e6, 3.0*sample_rate/1.0e6);
+	return;
+}
+
+int main(int argc, char **argv)
+{
+	const pcm24_t *p_pcm24 = NULL;
+
+	uint8_t *p_bytes = NULL;
+	int32_t *p_samples = NULL;
+	int32_t *p_samples2 = NULL;
+
+	size_t n_samples = 1048576u;
+	int max_level = 0;
+	int level = 0;
+	int routine = 0;
+
+	if(argc > 1)
+	{
+		try
+		{
+			n_samples = (size_t) std::stoul(argv[1]);
+		}
+		catch(...)
+		{
+			std::cout << "Error: invalid number of samples\n";
+			return 1;
+		}
+
+		if(!n_samples)
+		{
+			std::cout << "Error: invalid number of samples\n";
+			return 1;
+		}
+	}
+
+	max_level = pcm24_get_max_level();
+
+	srand(1u);
+
+	for(level = PCM24_SCALAR; level <= max_level; level++)
+	{
+		p_pcm24 = pcm24_select(level);
+
+		if(!check_level(p_pcm24))
+		{
+			std::cout << "Error: " << p_pcm24->name << " output does not match scalar output\n";
+			return 1;
+		}
+
+		std::cout << p_pcm24->name << ": output matches scalar\n";
+	}
+
+	p_bytes = (uint8_t*) malloc(3u*n_samples);
+	p_samples = (int32_t*) malloc(4u*n_samples);
+	p_samples2 = (int32_t*) malloc(4u*n_samples);
+
+	if((p_bytes == NULL) || (p_samples == NULL) || (p_samples2 == NULL))
+	{
+		std::cout << "Error: memory allocate failed\n";
+		free(p_bytes);
+		free(p_samples);
+		free(p_samples2);
+		return 1;
+	}
+
+	fill_random(p_bytes, 3u*n_samples);
+	fill_random_s24(p_samples, n_samples);
+	memset(p_samples2, 0, 4u*n_samples);
+
+	std::cout << "\n" << n_samples << " samples per run\n";
+
+	for(routine = ROUTINE_UNPACK; routine <= ROUTINE_TO_S32; routine++)
+	{
+		for(level = PCM24_SCALAR; level <= max_level; level++) bench_routine(pcm24_select(level), routine, p_bytes, p_samples, p_samples2, n_samples);
+	}
+
+	free(p_bytes);
+	free(p_samples);
+	free(p_samples2);
+
+	return 0;
+}